@@ -1,9 +1,12 @@
 #version 450
 
+#include "math.glsl"
+
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec3 tangent;
-layout(location = 3) in vec3 color;
+// From binding 1, see PackedAttributes
+layout(location = 1) in vec2 packed_normal;
+layout(location = 2) in vec2 packed_tangent;
+layout(location = 3) in vec4 color;
 layout(location = 4) in vec2 uv1;
 layout(location = 5) in vec2 uv2;
 
@@ -24,11 +27,14 @@ layout(push_constant) uniform Mesh{
 };
 
 void main() {
+    vec3 normal = oct_decode(packed_normal);
+    vec3 tangent = oct_decode(packed_tangent);
+
     vec4 WorldPos = modelMat * vec4(pos, 1.0);
     vec3 view = cameraPosition - WorldPos.xyz;
     gl_Position = projMat * viewMat * WorldPos;
 
-    vec3 bitangent = normalize(cross(normal, tangent));
+    vec3 bitangent = normalize(cross(normal, tangent)) * (color.a * 2.0 - 1.0);
     vec3 T = normalize(vec3(modelMat * vec4(tangent, 0.0)));
     vec3 B = normalize(vec3(modelMat * vec4(bitangent, 0.0)));
     vec3 N = normalize(vec3(modelMat * vec4(normal, 0.0)));
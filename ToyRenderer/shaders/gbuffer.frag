@@ -1,6 +1,8 @@
 #version 450
 #extension GL_EXT_nonuniform_qualifier: require
 
+#include "math.glsl"
+
 layout(location = 0) in mat3 TBN;
 layout(location = 3) in vec3 fragViewDir;
 layout(location = 4) in vec2 fragUV1;
@@ -16,7 +18,6 @@ layout(set = 1, binding = 0) uniform sampler common_sampler;
 layout(set = 1, binding = 1) uniform texture2D[] images;
 
 layout(push_constant) uniform indices{
-    layout(offset = 64)
     uint albedo_idx;
     uint normal_idx;
     uint roughness_metallic_idx;
@@ -25,7 +26,7 @@ layout(push_constant) uniform indices{
 void main() {
     vec4 albedo = texture(sampler2D(images[albedo_idx], common_sampler), fragUV1);
     vec4 roughness_metallic = texture(sampler2D(images[roughness_metallic_idx], common_sampler), fragUV1);
-    vec3 normal = normalize(TBN * (texture(sampler2D(images[normal_idx], common_sampler), fragUV1) * 2.0 - 1.0).rgb);
+    vec3 normal = normalize(TBN * unpack_normal(texture(sampler2D(images[normal_idx], common_sampler), fragUV1).rg));
 
     if (albedo.a < 0.9) {
             discard;
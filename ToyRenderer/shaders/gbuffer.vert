@@ -1,9 +1,12 @@
 #version 450
 
+#include "math.glsl"
+
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec3 tangent;
-layout(location = 3) in vec3 color;
+// From binding 1, see PackedAttributes
+layout(location = 1) in vec2 packed_normal;
+layout(location = 2) in vec2 packed_tangent;
+layout(location = 3) in vec4 color;
 layout(location = 4) in vec2 uv1;
 layout(location = 5) in vec2 uv2;
 
@@ -19,16 +22,21 @@ layout(set = 0, binding = 0) uniform Global{
     vec3 cameraPosition;
 };
 
-layout(push_constant) uniform Mesh{
-    mat4 modelMat;
+// World matrix of every instance drawn by the pass
+layout(std430, set = 0, binding = 1) readonly buffer Instances{
+    mat4 instances[];
 };
 
 void main() {
+    mat4 modelMat = instances[gl_InstanceIndex];
+    vec3 normal = oct_decode(packed_normal);
+    vec3 tangent = oct_decode(packed_tangent);
+
     vec4 WorldPos = modelMat * vec4(pos, 1.0);
     vec3 view = cameraPosition - WorldPos.xyz;
     gl_Position = projMat * viewMat * WorldPos;
 
-    vec3 bitangent = normalize(cross(normal, tangent));
+    vec3 bitangent = normalize(cross(normal, tangent)) * (color.a * 2.0 - 1.0);
     vec3 T = normalize(vec3(modelMat * vec4(tangent, 0.0)));
     vec3 B = normalize(vec3(modelMat * vec4(bitangent, 0.0)));
     vec3 N = normalize(vec3(modelMat * vec4(normal, 0.0)));
@@ -9,4 +9,18 @@ float saturate(float v) {
     return clamp(v, 0.0, 1.0);
 }
 
+// Normal maps only store xy (BC5 has 2 channels), z is positive in tangent space
+vec3 unpack_normal(vec2 rg) {
+    vec2 xy = rg * 2.0 - 1.0;
+    return vec3(xy, sqrt(saturate(1.0 - dot(xy, xy))));
+}
+
+// Inverse of the octahedral encoding of PackedAttributes normals and tangents
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 #endif // MATH_GLSL
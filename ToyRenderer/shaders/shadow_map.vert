@@ -1,11 +1,7 @@
 #version 450
 
+// Only the position stream is bound, see VertexPosition
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec3 tangent;
-layout(location = 3) in vec3 color;
-layout(location = 4) in vec2 uv1;
-layout(location = 5) in vec2 uv2;
 
 layout(set = 0, binding = 0) uniform Global{
     mat4 projMat;
@@ -13,10 +9,11 @@ layout(set = 0, binding = 0) uniform Global{
     vec3 cameraPosition;
 };
 
-layout(push_constant) uniform Mesh{
-    mat4 modelMat;
+// World matrix of every instance drawn by the pass
+layout(std430, set = 0, binding = 1) readonly buffer Instances{
+    mat4 instances[];
 };
 
 void main() {
-    gl_Position = projMat * viewMat * modelMat * vec4(pos, 1.0);;
+    gl_Position = projMat * viewMat * instances[gl_InstanceIndex] * vec4(pos, 1.0);
 }
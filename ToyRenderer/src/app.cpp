@@ -10,7 +10,6 @@
 #include <vector>
 
 #include "camera.h"
-#include "gltf.h"
 #include "options.h"
 #include "renderer/debug.h"
 #include "renderer/render_graph.h"
@@ -28,9 +27,19 @@ struct Transferer;
 void tr::App::update() {
   const auto dt = state.frame_timer.elapsed();  // millis
   state.camera_controller.update(subsystems.input.consume_camera_input(), dt / 1000);
+
+  scene.stream(subsystems.engine, state.camera_controller.camera,
+               static_cast<float>(subsystems.engine.ctx.swapchain.extent.height));
+  if (scene.nodes.update(thread_pool)) {
+    for (std::size_t i = 0; i < scene.meshes.size(); i++) {
+      for (std::size_t j = 0; j < scene.mesh_nodes[i].size(); j++) {
+        scene.meshes[i].instances[j] = scene.nodes.world(scene.mesh_nodes[i][j]);
+      }
+    }
+  }
 }
 
-tr::App::App(tr::Options options_) : options(options_) {
+tr::App::App(tr::Options options_) : options(options_), thread_pool(options_.config.loader_threads) {
   auto win_size = subsystems.platform.init(this);
   state.camera_controller.camera.aspectRatio = win_size.aspect_ratio();
 
@@ -46,30 +55,13 @@ tr::App::App(tr::Options options_) : options(options_) {
   }
 
   rendergraph = std::make_unique<renderer::RenderGraph>();
-  subsystems.engine.transfer([&](renderer::Transferer &t) {
-    rendergraph->init(subsystems.engine, t);
-
-    TIMED_INLINE_LAMBDA("Load scene") {
-      std::string scene_name;
-      if (options.scene.empty()) {
-        scene_name = "assets/scenes/sponza/Sponza.gltf";
-      } else {
-        scene_name = options.scene;
-      }
-      auto bb = subsystems.engine.buffer_builder();
-      auto ib = subsystems.engine.image_builder();
-      const auto [_, scene] =
-          Gltf::load_from_file(subsystems.engine.lifetime.global, ib, bb, t, subsystems.engine.rm, scene_name);
-      meshes.insert(meshes.end(), scene.begin(), scene.end());
-
-      std::size_t surface_count = 0;
-      for (const auto &mesh : meshes) {
-        surface_count += mesh.surfaces.size();
-      }
-      spdlog::info("There are {} meshes and {} surfaces ", meshes.size(), surface_count);
-    };
-  });
-  subsystems.engine.sync();
+  subsystems.engine.transfer([&](renderer::Transferer &t) { rendergraph->init(subsystems.engine, t); });
+
+  // Frames start right away, the scene shows up as it is uploaded
+  const std::string scene_name{options.scene.empty() ? "assets/scenes/sponza/Sponza.gltf" : options.scene};
+  scene.start(thread_pool, scene_name, options.config.bake,
+              subsystems.engine.ctx.physical_device.texture_compression_bc, options.config.texture_memory << 20,
+              options.config.geometry_memory << 20, std::string{options.load_report});
 }
 
 void tr::App::on_input(tr::system::InputEvent event) { subsystems.input.on_input(event); }
@@ -88,11 +80,12 @@ void tr::App::run() {
     update();
 
     subsystems.engine.frame([&](renderer::Frame &frame) {
-      rendergraph->draw(frame, meshes, state.camera_controller.camera);
+      rendergraph->draw(frame, scene.geometry, scene.meshes, state.camera_controller.camera);
 
       if (subsystems.imgui.start_frame(frame)) {
         subsystems.engine.imgui();
         rendergraph->imgui(subsystems.engine);
+        scene.imgui();
         subsystems.imgui.draw(frame);
       }
     });
@@ -107,4 +100,7 @@ void tr::App::run() {
 
   subsystems.engine.sync();
 }
-tr::App::~App() = default;
+tr::App::~App() {
+  // The engine waits for the GPU before cleaning it up
+  scene.release(subsystems.engine.lifetime.global);
+}
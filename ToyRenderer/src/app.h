@@ -1,14 +1,17 @@
 #pragma once
 
+#include <utils/thread_pool.h>
 #include <utils/timer.h>
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "camera.h"
 #include "options.h"
 #include "renderer/mesh.h"
 #include "renderer/vulkan_engine.h"
+#include "scene_streamer.h"
 #include "system/imgui.h"
 #include "system/input.h"
 #include "system/platform.h"
@@ -40,6 +43,7 @@ class App {
   void update();
 
   Options options;
+  utils::ThreadPool thread_pool;
 
   struct Subsystems {
     system::Platform platform;
@@ -54,7 +58,8 @@ class App {
     CameraController camera_controller;
   } state;
 
-  std::vector<renderer::Mesh> meshes;
+  // Grows while the scene streams in
+  SceneStreamer scene;
   std::vector<renderer::DirectionalLight> point_lights;
 
   std::unique_ptr<renderer::RenderGraph> rendergraph;
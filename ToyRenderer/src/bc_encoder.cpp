@@ -0,0 +1,293 @@
+#include "bc_encoder.h"
+
+#include <algorithm>          // for min, clamp, minmax_element
+#include <array>              // for array
+#include <cmath>              // for round
+#include <cstddef>            // for byte, size_t
+#include <cstdint>            // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <glm/common.hpp>     // for clamp, floor
+#include <glm/geometric.hpp>  // for dot, length
+#include <glm/mat4x4.hpp>     // for mat4
+#include <glm/matrix.hpp>     // for outerProduct
+#include <glm/vec4.hpp>       // for vec4
+#include <limits>             // for numeric_limits
+#include <span>               // for span
+#include <utility>            // for pair, swap
+#include <vector>             // for vector
+
+namespace {
+
+using Block = std::array<glm::vec4, 16>;
+
+template <std::size_t BlockSize, class Fn>
+auto encode_blocks(uint32_t width, uint32_t height, std::span<const std::byte> rgba, Fn&& encode_block)
+    -> std::vector<std::byte> {
+  const uint32_t blocks_x = (width + 3) / 4;
+  const uint32_t blocks_y = (height + 3) / 4;
+  std::vector<std::byte> out(std::size_t{blocks_x} * blocks_y * BlockSize);
+
+  for (uint32_t by = 0; by < blocks_y; by++) {
+    for (uint32_t bx = 0; bx < blocks_x; bx++) {
+      Block block;
+      for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+        const uint32_t y = std::min(by * 4 + i / 4, height - 1);
+        const auto* texel = &rgba[(std::size_t{y} * width + x) * 4];
+        block[i] = {
+            static_cast<float>(std::to_integer<uint8_t>(texel[0])),
+            static_cast<float>(std::to_integer<uint8_t>(texel[1])),
+            static_cast<float>(std::to_integer<uint8_t>(texel[2])),
+            static_cast<float>(std::to_integer<uint8_t>(texel[3])),
+        };
+      }
+
+      const std::size_t block_index = std::size_t{by} * blocks_x + bx;
+      encode_block(block, std::span<std::byte, BlockSize>{&out[block_index * BlockSize], BlockSize});
+    }
+  }
+  return out;
+}
+
+// The two extremities of the segment along which the texels of the block spread the most
+// The direction is the principal axis of the covariance, found by power iteration
+auto principal_endpoints(const Block& block) -> std::pair<glm::vec4, glm::vec4> {
+  glm::vec4 mean{0.F};
+  for (const auto& texel : block) {
+    mean += texel;
+  }
+  mean /= 16.F;
+
+  glm::mat4 covariance{0.F};
+  for (const auto& texel : block) {
+    covariance += glm::outerProduct(texel - mean, texel - mean);
+  }
+
+  glm::vec4 axis{1.F};
+  for (int i = 0; i < 8; i++) {
+    axis = covariance * axis;
+    const float norm = glm::length(axis);
+    if (norm < 1e-6F) {
+      // Every texel is the same
+      return {mean, mean};
+    }
+    axis /= norm;
+  }
+
+  float t_min = std::numeric_limits<float>::infinity();
+  float t_max = -std::numeric_limits<float>::infinity();
+  for (const auto& texel : block) {
+    const float t = glm::dot(texel - mean, axis);
+    t_min = std::min(t_min, t);
+    t_max = std::max(t_max, t);
+  }
+
+  const auto clamp = [](glm::vec4 v) { return glm::clamp(v, glm::vec4{0.F}, glm::vec4{255.F}); };
+  return {clamp(mean + t_min * axis), clamp(mean + t_max * axis)};
+}
+
+auto distance2(glm::vec4 a, glm::vec4 b) -> float { return glm::dot(a - b, a - b); }
+
+template <std::size_t N>
+auto closest(const std::array<glm::vec4, N>& palette, glm::vec4 texel) -> uint32_t {
+  uint32_t best = 0;
+  float best_distance = std::numeric_limits<float>::infinity();
+  for (uint32_t i = 0; i < N; i++) {
+    const float d = distance2(palette[i], texel);
+    if (d < best_distance) {
+      best_distance = d;
+      best = i;
+    }
+  }
+  return best;
+}
+
+auto quantize(float value, float levels) -> uint32_t {
+  return static_cast<uint32_t>(std::round(std::clamp(value, 0.F, 255.F) * levels / 255.F));
+}
+
+template <std::size_t N>
+void write_le(std::span<std::byte> out, uint64_t value) {
+  for (std::size_t i = 0; i < N; i++) {
+    out[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+auto to_565(glm::vec4 color) -> uint16_t {
+  return static_cast<uint16_t>(quantize(color.r, 31) << 11 | quantize(color.g, 63) << 5 | quantize(color.b, 31));
+}
+
+auto from_565(uint16_t color) -> glm::vec4 {
+  const uint32_t r = (color >> 11) & 31;
+  const uint32_t g = (color >> 5) & 63;
+  const uint32_t b = color & 31;
+  // Same bit replication as the hardware
+  return {
+      static_cast<float>(r << 3 | r >> 2),
+      static_cast<float>(g << 2 | g >> 4),
+      static_cast<float>(b << 3 | b >> 2),
+      0.F,
+  };
+}
+
+void encode_bc1_block(Block block, std::span<std::byte, 8> out) {
+  for (auto& texel : block) {
+    texel.a = 0.F;
+  }
+
+  const auto [low, high] = principal_endpoints(block);
+  uint16_t c0 = to_565(high);
+  uint16_t c1 = to_565(low);
+  // c0 > c1 selects the 4 colors mode, the other one reserves an index for transparent black
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    const auto e0 = from_565(c0);
+    const auto e1 = from_565(c1);
+    const std::array palette{e0, e1, (2.F * e0 + e1) / 3.F, (e0 + 2.F * e1) / 3.F};
+    for (uint32_t i = 0; i < 16; i++) {
+      indices |= closest(palette, block[i]) << (2 * i);
+    }
+  }
+
+  write_le<2>(out.subspan<0, 2>(), c0);
+  write_le<2>(out.subspan<2, 2>(), c1);
+  write_le<4>(out.subspan<4, 4>(), indices);
+}
+
+void encode_bc4_block(const Block& block, std::size_t channel, std::span<std::byte, 8> out) {
+  const auto [min_it, max_it] = std::minmax_element(block.begin(), block.end(), [&](const auto& a, const auto& b) {
+    return a[static_cast<glm::length_t>(channel)] < b[static_cast<glm::length_t>(channel)];
+  });
+  const auto a0 = quantize((*max_it)[static_cast<glm::length_t>(channel)], 255);
+  const auto a1 = quantize((*min_it)[static_cast<glm::length_t>(channel)], 255);
+
+  // a0 > a1 selects the 8 values mode: a0, a1 and 6 values in between from a0 to a1
+  uint64_t indices = 0;
+  if (a0 > a1) {
+    for (uint32_t i = 0; i < 16; i++) {
+      const float value = block[i][static_cast<glm::length_t>(channel)];
+      const auto step = static_cast<uint64_t>(
+          std::round((value - static_cast<float>(a1)) * 7.F / static_cast<float>(a0 - a1)));
+      const uint64_t index = step == 0 ? 1 : step == 7 ? 0 : 8 - step;
+      indices |= index << (3 * i);
+    }
+  }
+
+  out[0] = static_cast<std::byte>(a0);
+  out[1] = static_cast<std::byte>(a1);
+  write_le<6>(out.subspan<2, 6>(), indices);
+}
+
+void encode_bc5_block(const Block& block, std::span<std::byte, 16> out) {
+  encode_bc4_block(block, 0, out.subspan<0, 8>());
+  encode_bc4_block(block, 1, out.subspan<8, 8>());
+}
+
+class BitWriter {
+ public:
+  explicit BitWriter(std::span<std::byte, 16> out_) : out(out_) {}
+
+  void write(uint32_t value, uint32_t bits) {
+    for (uint32_t i = 0; i < bits; i++, position++) {
+      if (((value >> i) & 1) != 0) {
+        out[position / 8] |= static_cast<std::byte>(1 << (position % 8));
+      }
+    }
+  }
+
+ private:
+  std::span<std::byte, 16> out;
+  uint32_t position = 0;
+};
+
+struct Bc7Endpoint {
+  std::array<uint32_t, 4> color;
+  uint32_t p_bit;
+
+  [[nodiscard]] auto value() const -> glm::vec4 {
+    return {
+        static_cast<float>(color[0] << 1 | p_bit),
+        static_cast<float>(color[1] << 1 | p_bit),
+        static_cast<float>(color[2] << 1 | p_bit),
+        static_cast<float>(color[3] << 1 | p_bit),
+    };
+  }
+};
+
+// The p-bit is the shared lowest bit of the 4 channels, both choices are tried
+auto quantize_bc7_endpoint(glm::vec4 color) -> Bc7Endpoint {
+  Bc7Endpoint best{};
+  float best_distance = std::numeric_limits<float>::infinity();
+  for (uint32_t p_bit = 0; p_bit < 2; p_bit++) {
+    Bc7Endpoint endpoint{.color = {}, .p_bit = p_bit};
+    for (glm::length_t c = 0; c < 4; c++) {
+      const float v = std::round((color[c] - static_cast<float>(p_bit)) / 2.F);
+      endpoint.color[static_cast<std::size_t>(c)] = static_cast<uint32_t>(std::clamp(v, 0.F, 127.F));
+    }
+
+    const float d = distance2(endpoint.value(), color);
+    if (d < best_distance) {
+      best_distance = d;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+void encode_bc7_block(const Block& block, std::span<std::byte, 16> out) {
+  static constexpr std::array<uint32_t, 16> weights{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+  const auto [low, high] = principal_endpoints(block);
+  auto e0 = quantize_bc7_endpoint(low);
+  auto e1 = quantize_bc7_endpoint(high);
+
+  std::array<glm::vec4, 16> palette{};
+  for (std::size_t i = 0; i < 16; i++) {
+    const auto w = static_cast<float>(weights[i]);
+    palette[i] = glm::floor(((64.F - w) * e0.value() + w * e1.value() + 32.F) / 64.F);
+  }
+
+  std::array<uint32_t, 16> indices{};
+  for (std::size_t i = 0; i < 16; i++) {
+    indices[i] = closest(palette, block[i]);
+  }
+
+  // The highest bit of the first index is implicitly 0
+  if (indices[0] >= 8) {
+    std::swap(e0, e1);
+    for (auto& index : indices) {
+      index = 15 - index;
+    }
+  }
+
+  std::ranges::fill(out, std::byte{0});
+  BitWriter writer{out};
+  writer.write(1 << 6, 7);
+  for (std::size_t c = 0; c < 4; c++) {
+    writer.write(e0.color[c], 7);
+    writer.write(e1.color[c], 7);
+  }
+  writer.write(e0.p_bit, 1);
+  writer.write(e1.p_bit, 1);
+  writer.write(indices[0], 3);
+  for (std::size_t i = 1; i < 16; i++) {
+    writer.write(indices[i], 4);
+  }
+}
+
+}  // namespace
+
+auto tr::bc::encode_bc1(uint32_t width, uint32_t height, std::span<const std::byte> rgba) -> std::vector<std::byte> {
+  return encode_blocks<8>(width, height, rgba, encode_bc1_block);
+}
+
+auto tr::bc::encode_bc5(uint32_t width, uint32_t height, std::span<const std::byte> rgba) -> std::vector<std::byte> {
+  return encode_blocks<16>(width, height, rgba, encode_bc5_block);
+}
+
+auto tr::bc::encode_bc7(uint32_t width, uint32_t height, std::span<const std::byte> rgba) -> std::vector<std::byte> {
+  return encode_blocks<16>(width, height, rgba, encode_bc7_block);
+}
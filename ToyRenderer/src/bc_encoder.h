@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// CPU block compression, meant to be used offline when baking scenes
+// Inputs are tightly packed R8G8B8A8 images, outputs are tightly packed rows of 4x4 blocks
+// The last row / column of texels is repeated to fill the blocks on the edges
+namespace tr::bc {
+
+// RGB at 4 bits per texel, alpha is dropped
+auto encode_bc1(uint32_t width, uint32_t height, std::span<const std::byte> rgba) -> std::vector<std::byte>;
+
+// R and G as two independent channels at 8 bits per texel, B and A are dropped
+auto encode_bc5(uint32_t width, uint32_t height, std::span<const std::byte> rgba) -> std::vector<std::byte>;
+
+// RGBA at 8 bits per texel, every block is encoded with mode 6 (one subset, 7.7.7.7 endpoints + p-bit)
+auto encode_bc7(uint32_t width, uint32_t height, std::span<const std::byte> rgba) -> std::vector<std::byte>;
+
+}  // namespace tr::bc
@@ -0,0 +1,155 @@
+#include "cell_streamer.h"
+
+#include <spdlog/spdlog.h>  // for warn
+#include <utils/assert.h>   // for TR_ASSERT
+#include <utils/cast.h>     // for narrow_cast
+
+#include <algorithm>          // for sort, unique, max
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint32_t
+#include <glm/common.hpp>     // for clamp
+#include <glm/geometric.hpp>  // for length
+#include <numeric>            // for iota
+#include <span>               // for span
+#include <vector>             // for vector
+
+#include "camera.h"                            // for Camera
+#include "renderer/passes/frustrum_culling.h"  // for Frustum, FrustrumCulling
+
+void tr::CellStreamer::init(std::span<const SceneData::Cell> cells_, std::span<const std::size_t> mesh_bytes_,
+                            std::size_t memory_limit) {
+  mesh_bytes = mesh_bytes_;
+  limit_ = memory_limit;
+  mesh_users.assign(mesh_bytes.size(), 0);
+  mesh_planned.assign(mesh_bytes.size(), 0);
+
+  cells.reserve(cells_.size());
+  for (const auto& cell : cells_) {
+    const auto first = cell_meshes.size();
+    for (const auto& instance : cell.instances) {
+      cell_meshes.push_back(instance.mesh);
+    }
+    std::sort(cell_meshes.begin() + utils::narrow_cast<std::ptrdiff_t>(first), cell_meshes.end());
+    cell_meshes.erase(std::unique(cell_meshes.begin() + utils::narrow_cast<std::ptrdiff_t>(first), cell_meshes.end()),
+                      cell_meshes.end());
+    cells.push_back({
+        .bounds = cell.bounds,
+        .first_mesh = first,
+        .mesh_count = cell_meshes.size() - first,
+        .resident = false,
+        .waiting = false,
+        .latency = {},
+        .priority = 0.F,
+    });
+  }
+  order.resize(cells.size());
+  std::iota(order.begin(), order.end(), 0U);
+}
+
+void tr::CellStreamer::plan(const Camera& camera) {
+  const auto frustum = renderer::Frustum::from_camera(camera).transform(camera.cameraInfo().viewMatrix);
+  for (auto& cell : cells) {
+    // 0 from inside it
+    cell.priority = glm::length(glm::clamp(camera.position, cell.bounds.min, cell.bounds.max) - camera.position);
+    if (!renderer::FrustrumCulling::filter_one(frustum, cell.bounds)) {
+      cell.priority *= out_of_view_penalty;
+    }
+    if (cell.resident) {
+      cell.priority /= hysteresis;
+    }
+  }
+  std::ranges::sort(order, [&](uint32_t a, uint32_t b) { return cells[a].priority < cells[b].priority; });
+
+  // The nearest cells whose meshes fit, meshes already counted for a nearer cell are free. The nearest one comes
+  // whatever its size, something has to show up
+  plan_count++;
+  std::size_t bytes = 0;
+  std::size_t wanted = 0;
+  for (; wanted < order.size(); wanted++) {
+    std::size_t cell_bytes = 0;
+    for (const auto mesh : meshes(order[wanted])) {
+      if (mesh_planned[mesh] != plan_count) {
+        cell_bytes += mesh_bytes[mesh];
+      }
+    }
+    if (limit_ != 0 && bytes + cell_bytes > limit_) {
+      if (wanted != 0) {
+        break;
+      }
+      if (!over_limit_warned) {
+        spdlog::warn("The nearest cell takes {:.1f} MiB, over the geometry memory limit of {:.1f} MiB",
+                     static_cast<double>(cell_bytes) / (1 << 20), static_cast<double>(limit_) / (1 << 20));
+        over_limit_warned = true;
+      }
+    }
+    bytes += cell_bytes;
+    for (const auto mesh : meshes(order[wanted])) {
+      mesh_planned[mesh] = plan_count;
+    }
+  }
+
+  to_unload.clear();
+  to_load.clear();
+  for (std::size_t i = 0; i < order.size(); i++) {
+    auto& cell = cells[order[i]];
+    if (i < wanted && !cell.resident) {
+      if (!cell.waiting) {
+        cell.waiting = true;
+        cell.latency.start();
+      }
+      to_load.push_back(order[i]);
+    } else if (i >= wanted && cell.resident) {
+      to_unload.push_back(order[i]);
+    } else if (i >= wanted) {
+      cell.waiting = false;
+    }
+  }
+}
+
+void tr::CellStreamer::missing_meshes(uint32_t cell, std::vector<uint32_t>& missing) const {
+  for (const auto mesh : meshes(cell)) {
+    if (mesh_users[mesh] == 0) {
+      missing.push_back(mesh);
+    }
+  }
+}
+
+void tr::CellStreamer::load(uint32_t cell) {
+  TR_ASSERT(!cells[cell].resident, "cell {} is already resident", cell);
+  cells[cell].resident = true;
+  for (const auto mesh : meshes(cell)) {
+    if (mesh_users[mesh]++ == 0) {
+      stats_.resident_bytes += mesh_bytes[mesh];
+    }
+  }
+  stats_.resident_cells++;
+  stats_.loads++;
+}
+
+void tr::CellStreamer::unload(uint32_t cell, std::vector<uint32_t>& released) {
+  TR_ASSERT(cells[cell].resident, "cell {} is not resident", cell);
+  cells[cell].resident = false;
+  // Its upload may still be on its way, it won't count
+  cells[cell].waiting = false;
+  for (const auto mesh : meshes(cell)) {
+    if (--mesh_users[mesh] == 0) {
+      stats_.resident_bytes -= mesh_bytes[mesh];
+      released.push_back(mesh);
+    }
+  }
+  stats_.resident_cells--;
+  stats_.unloads++;
+}
+
+void tr::CellStreamer::arrived(uint32_t cell) {
+  auto& c = cells[cell];
+  if (!c.waiting || !c.resident) {
+    return;
+  }
+  c.waiting = false;
+  c.latency.stop();
+  stats_.last_latency_ms = c.latency.elapsed;
+  stats_.max_latency_ms = std::max(stats_.max_latency_ms, c.latency.elapsed);
+  stats_.total_latency_ms += c.latency.elapsed;
+  stats_.arrivals++;
+}
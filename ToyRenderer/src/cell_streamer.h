@@ -0,0 +1,93 @@
+#pragma once
+
+#include <utils/timer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "scene_data.h"
+
+namespace tr {
+struct Camera;
+
+// Picks the cells of the scene whose meshes stay on the GPU, nearest first under a memory limit
+// A cell out of view counts as further away than it is, a resident one as closer so that cells don't come and go
+// while the camera moves along their border. Meshes are shared between cells: they count once against the limit and
+// stay while any resident cell uses them
+class CellStreamer {
+ public:
+  static constexpr float hysteresis = 1.25F;
+  static constexpr float out_of_view_penalty = 2.F;
+
+  // mesh_bytes[m] is what scene mesh m takes on the GPU, memory_limit is in bytes, 0 for no limit
+  void init(std::span<const SceneData::Cell> cells, std::span<const std::size_t> mesh_bytes,
+            std::size_t memory_limit);
+
+  // Picks what should be resident as seen from camera, the nearest cell always is even over the memory limit
+  void plan(const Camera& camera);
+  // From the last plan: resident cells not wanted anymore, and wanted cells that are not resident by priority
+  [[nodiscard]] auto unloads() const -> std::span<const uint32_t> { return to_unload; }
+  [[nodiscard]] auto loads() const -> std::span<const uint32_t> { return to_load; }
+
+  // Meshes of cell no resident cell uses, they have to be uploaded before load()
+  void missing_meshes(uint32_t cell, std::vector<uint32_t>& missing) const;
+  void load(uint32_t cell);
+  // Appends the meshes no resident cell uses anymore to released
+  void unload(uint32_t cell, std::vector<uint32_t>& released);
+  // The upload of cell is done on the GPU, it ends its latency
+  void arrived(uint32_t cell);
+
+  [[nodiscard]] auto size() const -> std::size_t { return cells.size(); }
+  [[nodiscard]] auto resident(uint32_t cell) const -> bool { return cells[cell].resident; }
+  // Distinct meshes of the instances of cell
+  [[nodiscard]] auto meshes(uint32_t cell) const -> std::span<const uint32_t> {
+    return std::span(cell_meshes).subspan(cells[cell].first_mesh, cells[cell].mesh_count);
+  }
+
+  struct Stats {
+    std::size_t resident_cells = 0;
+    std::size_t resident_bytes = 0;
+    std::size_t loads = 0;
+    std::size_t unloads = 0;
+    // From the plan that first wanted a cell until its upload is done on the GPU
+    float last_latency_ms = 0.F;
+    float max_latency_ms = 0.F;
+    float total_latency_ms = 0.F;
+    std::size_t arrivals = 0;
+  };
+  [[nodiscard]] auto stats() const -> const Stats& { return stats_; }
+  [[nodiscard]] auto limit() const -> std::size_t { return limit_; }
+
+ private:
+  struct Cell {
+    renderer::AABB bounds;
+    // Into cell_meshes
+    std::size_t first_mesh;
+    std::size_t mesh_count;
+    bool resident;
+    // Wanted and not there yet
+    bool waiting;
+    utils::Timer latency;
+    float priority;
+  };
+
+  std::vector<Cell> cells;
+  std::vector<uint32_t> cell_meshes;
+  std::span<const std::size_t> mesh_bytes;
+  // Resident cells using each mesh
+  std::vector<uint32_t> mesh_users;
+  // Last plan that counted each mesh, to count shared ones once
+  std::vector<uint32_t> mesh_planned;
+  uint32_t plan_count = 0;
+  std::size_t limit_ = 0;
+  bool over_limit_warned = false;
+
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> to_unload;
+  std::vector<uint32_t> to_load;
+  Stats stats_;
+};
+
+}  // namespace tr
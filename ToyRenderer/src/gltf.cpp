@@ -1,51 +1,64 @@
 #include "gltf.h"
 
-#include <spdlog/spdlog.h>       // for debug, warn
+#include <spdlog/spdlog.h>       // for debug, info, warn
 #include <stb_image.h>           // for stbi_load_from_memory, stbi_uc
 #include <utils/assert.h>        // for TR_ASSERT
 #include <utils/cast.h>          // for narrow_cast
-#include <utils/misc.h>          // for INLINE_LAMBDA, overloaded
-#include <vulkan/vulkan_core.h>  // for VkBufferUsageFlagBits, VkFormat
+#include <utils/misc.h>          // for INLINE_LAMBDA, overloaded, align
+#include <utils/thread_pool.h>   // for ThreadPool
+#include <vulkan/vulkan_core.h>  // for VkFormat, VkExtent2D
 
-#include <algorithm>  // for max, min
+#include <algorithm>  // for max, min, none_of, find, find_if
 #include <array>      // for array
+#include <cmath>      // for abs, sqrt
 #include <cstddef>    // for size_t, byte
-#include <cstdint>    // for uint32_t
+#include <cstdint>    // for uint32_t, uint16_t
+#include <cstring>    // for memcpy
+#include <deque>      // for deque
 #include <fastgltf/parser.hpp>
 #include <fastgltf/tools.hpp>            // for DefaultBufferDataAdapter
 #include <fastgltf/types.hpp>            // for Asset, OptionalWithFlagValue
+#include <filesystem>                    // for path
 #include <format>                        // for _Sink_iter, format, format_to
-#include <functional>                    // for invoke
-#include <glm/geometric.hpp>             // for dot, normalize
+#include <future>                        // for future
+#include <glm/geometric.hpp>             // for cross, length
 #include <glm/gtc/matrix_transform.hpp>  // for identity, scale, translate
 #include <glm/gtc/quaternion.hpp>        // for mat4_cast
 #include <glm/gtc/type_ptr.hpp>          // for make_vec3, make_mat4, make_quat
-#include <glm/mat2x2.hpp>                // for operator*, mat2, mat
-#include <glm/mat2x3.hpp>                // for mat2x3
+#include <glm/gtx/matrix_decompose.hpp>  // for decompose
 #include <glm/mat4x4.hpp>                // for operator*, mat, mat4
-#include <glm/matrix.hpp>                // for inverse
 #include <glm/vec2.hpp>                  // for operator-, vec2, vec
 #include <glm/vec3.hpp>                  // for operator-, vec3, operator*, vec
 #include <glm/vec4.hpp>                  // for vec4, vec
 #include <glm/vector_relational.hpp>     // for all, lessThanEqual
 #include <limits>                        // for numeric_limits
+#include <memory>                        // for unique_ptr
 #include <mutex>                         // for once_flag, call_once
 #include <optional>                      // for optional
 #include <span>                          // for span, as_bytes
 #include <string>                        // for hash, operator==, basic_string
 #include <string_view>                   // for basic_string_view, string_view
+#include <system_error>                  // for error_code
+#include <type_traits>                   // for is_integral_v
 #include <unordered_map>                 // for unordered_map, operator==
-#include <utility>                       // for pair, move, forward
+#include <utility>                       // for pair, move
 #include <variant>                       // for visit
 #include <vector>                        // for vector
 
-#include "renderer/buffer.h"             // for OneTimeCommandBuffer
-#include "renderer/mesh.h"               // for Vertex, Material, Mesh, GeoS...
-#include "renderer/ressource_manager.h"  // for RessourceManager
-#include "renderer/ressources.h"         // for ImageRessource, BufferRessource
-#include "renderer/synchronisation.h"    // for ImageMemoryBarrier, SyncFrag...
-#include "renderer/uploader.h"           // for Transferer
-#include "renderer/vkformat.h"           // IWYU pragma: keep
+#include "bc_encoder.h"           // for encode_bc1, encode_bc5, encode_bc7
+#include "ktx2.h"                 // for Ktx2
+#include "load_report.h"          // for LoadReport
+#include "mesh_optimizer.h"       // for optimize, build_meshlets, Report
+#include "mesh_simplifier.h"      // for build_lods, LodChain
+#include "meshopt_decoder.h"      // for decode_vertex_buffer, decode_index_buffer...
+#include "node_hierarchy.h"       // for NodeHierarchy
+#include "renderer/mesh.h"        // for Vertex, Material, Mesh, GeoS...
+#include "renderer/ressources.h"  // for FormatBlock, mip_extent
+#include "renderer/vkformat.h"    // IWYU pragma: keep
+#include "scene_cells.h"          // for SceneCells
+#include "scene_data.h"           // for SceneData
+#include "tangents.h"             // for generate
+#include "trscene.h"              // for TrScene
 
 namespace fastgltf {
 template <>
@@ -58,146 +71,577 @@ template <>
 struct ElementTraits<glm::vec4> : ElementTraitsBase<glm::vec4, AccessorType::Vec4, float> {};
 }  // namespace fastgltf
 
-namespace tr::renderer {
-struct Lifetime;
-}  // namespace tr::renderer
-
 template <class T>
 concept has_bytes = requires(T a) { std::span(a.bytes); };
 
-auto load_texture(tr::renderer::Lifetime& lifetime, tr::renderer::ImageBuilder& ib, tr::renderer::Transferer& t,
-                  tr::renderer::RessourceManager& rm, const fastgltf::Image& image, std::string_view debug_name)
-    -> std::pair<tr::renderer::ImageRessource, tr::renderer::image_ressource_handle> {
+struct StbiImageDeleter {
+  void operator()(stbi_uc* data) const { stbi_image_free(data); }
+};
+
+struct DecodedImage {
   uint32_t width = 0;
   uint32_t height = 0;
-  std::span<const std::byte> image_data;
+  VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+  uint32_t mip_levels = 1;
+  // Set for R8G8B8A8 images until their mip chain is built, it only has their base level
+  std::unique_ptr<stbi_uc, StbiImageDeleter> pixels;
+  // Set for images loaded from a KTX2 file or compressed when baking, levels are stored one after the other
+  std::vector<std::byte> blocks;
+
+  [[nodiscard]] auto size_bytes() const -> std::size_t {
+    return tr::renderer::FormatBlock::of(format).size_bytes({width, height}, mip_levels);
+  }
+  [[nodiscard]] auto bytes() const -> std::span<const std::byte> {
+    if (pixels) {
+      return std::as_bytes(std::span{pixels.get(), size_bytes()});
+    }
+    return blocks;
+  }
+};
+
+auto is_bc(VkFormat format) -> bool {
+  return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// Pure CPU work, safe to run on any thread
+auto decode_image(const fastgltf::Image& image) -> DecodedImage {
+  DecodedImage decoded;
 
   std::visit(utils::overloaded{
                  [&](const has_bytes auto& c) {
                    const auto bytes = std::as_bytes(std::span(c.bytes));
 
+                   // KTX2 files are already in a GPU format, their levels are taken as is
+                   if (tr::Ktx2::is_ktx2(bytes)) {
+                     const auto ktx2 = tr::Ktx2::parse(bytes);
+                     TR_ASSERT(ktx2, "Could not load KTX2 image");
+
+                     decoded.width = ktx2->width;
+                     decoded.height = ktx2->height;
+                     decoded.format = ktx2->format;
+                     decoded.mip_levels = utils::narrow_cast<uint32_t>(ktx2->levels.size());
+                     const auto block = tr::renderer::FormatBlock::of(decoded.format);
+                     for (uint32_t level = 0; level < decoded.mip_levels; level++) {
+                       const auto level_bytes = ktx2->levels[level].first(
+                           block.size_bytes(tr::renderer::mip_extent({decoded.width, decoded.height}, level)));
+                       decoded.blocks.insert(decoded.blocks.end(), level_bytes.begin(), level_bytes.end());
+                     }
+                     return;
+                   }
+
                    int x = 0;
                    int y = 0;
                    int channels = 0;
-                   const auto* im =
-                       stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(bytes.data()),
-                                             utils::narrow_cast<int>(bytes.size_bytes()), &x, &y, &channels, 4);
+                   auto* im = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(bytes.data()),
+                                                    utils::narrow_cast<int>(bytes.size_bytes()), &x, &y, &channels, 4);
                    TR_ASSERT(im != nullptr, "Could not load image");
 
-                   width = utils::narrow_cast<uint32_t>(x);
-                   height = utils::narrow_cast<uint32_t>(y);
-                   image_data = std::as_bytes(std::span{im, static_cast<size_t>(x * y * 4)});
+                   decoded.width = utils::narrow_cast<uint32_t>(x);
+                   decoded.height = utils::narrow_cast<uint32_t>(y);
+                   decoded.pixels.reset(im);
                  },
                  [](const auto&) { TR_ASSERT(false, "MEH"); },
              },
              image.data);
 
-  auto image_ressource = ib.build_image(tr::renderer::ImageDefinition{
-      .flags = 0,
-      .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-      .size = {tr::renderer::StaticExtent{width, height}},
-      // TODO: How to deal with RBG (non alpha images?)
-      // and more generally with unsupported formats
-      .format = {tr::renderer::StaticFormat{VK_FORMAT_R8G8B8A8_UNORM}},
-      .debug_name = debug_name,
-  });
-  image_ressource.tie(lifetime);
-
-  tr::renderer::ImageMemoryBarrier::submit<1>(
-      t.cmd.vk_cmd, {{image_ressource.invalidate().prepare_barrier(tr::renderer::SyncImageTransfer)}});
-  t.upload_image(image_ressource, {{0, 0}, {width, height}}, image_data, 4);
-  tr::renderer::ImageMemoryBarrier::submit<1>(
-      t.graphics_cmd.vk_cmd, {{image_ressource.prepare_barrier(tr::renderer::SyncFragmentShaderReadOnly)}});
-  return {image_ressource, rm.register_storage_image(image_ressource)};
+  return decoded;
 }
 
-auto load_materials(tr::renderer::Lifetime& lifetime, tr::renderer::ImageBuilder& ib, tr::renderer::Transferer& t,
-                    tr::renderer::RessourceManager& rm, const fastgltf::Asset& asset)
-    -> std::vector<tr::renderer::Material> {
-  std::vector<tr::renderer::Material> materials;
+// What an image is sampled as, it decides which block format fits it
+enum class ImageUsage {
+  Albedo,
+  MetallicRoughness,
+  Normal,
+};
 
-  for (const auto& material : asset.materials) {
-    tr::renderer::Material mat{};
+// Box filter, the last row / column of odd sized images is folded into the previous one
+auto downsample(VkExtent2D extent, std::span<const std::byte> rgba) -> std::vector<std::byte> {
+  const auto half = tr::renderer::mip_extent(extent, 1);
+  std::vector<std::byte> out(std::size_t{half.width} * half.height * 4);
+  for (uint32_t y = 0; y < half.height; y++) {
+    for (uint32_t x = 0; x < half.width; x++) {
+      const std::array xs{std::min(2 * x, extent.width - 1), std::min(2 * x + 1, extent.width - 1)};
+      const std::array ys{std::min(2 * y, extent.height - 1), std::min(2 * y + 1, extent.height - 1)};
+      for (std::size_t c = 0; c < 4; c++) {
+        uint32_t sum = 2;  // rounds to nearest
+        for (const auto sy : ys) {
+          for (const auto sx : xs) {
+            sum += std::to_integer<uint32_t>(rgba[(std::size_t{sy} * extent.width + sx) * 4 + c]);
+          }
+        }
+        out[(std::size_t{y} * half.width + x) * 4 + c] = static_cast<std::byte>(sum / 4);
+      }
+    }
+  }
+  return out;
+}
+
+// Block compresses the whole mip chain, blocks can't be blitted at load time
+void compress_image(DecodedImage& image, ImageUsage usage) {
+  if (!image.pixels) {
+    return;
+  }
+
+  const VkExtent2D extent{image.width, image.height};
+  const auto base = image.bytes();
+  switch (usage) {
+    case ImageUsage::Albedo: {
+      bool opaque = true;
+      for (std::size_t i = 3; i < base.size() && opaque; i += 4) {
+        opaque = base[i] == std::byte{0xFF};
+      }
+      // BC1 is half the size but has no usable alpha
+      image.format = opaque ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+      break;
+    }
+    case ImageUsage::MetallicRoughness:
+      // Roughness and metalness are in G and B, BC7 keeps them from bleeding into each other
+      image.format = VK_FORMAT_BC7_UNORM_BLOCK;
+      break;
+    case ImageUsage::Normal:
+      image.format = VK_FORMAT_BC5_UNORM_BLOCK;
+      break;
+  }
+
+  const auto encode = [&](VkExtent2D level_extent, std::span<const std::byte> rgba) {
+    switch (image.format) {
+      case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        return tr::bc::encode_bc1(level_extent.width, level_extent.height, rgba);
+      case VK_FORMAT_BC5_UNORM_BLOCK:
+        return tr::bc::encode_bc5(level_extent.width, level_extent.height, rgba);
+      default:
+        return tr::bc::encode_bc7(level_extent.width, level_extent.height, rgba);
+    }
+  };
+
+  image.mip_levels = tr::renderer::mip_level_count(extent);
+  image.blocks = encode(extent, base);
+  std::vector<std::byte> level_texels{base.begin(), base.end()};
+  for (uint32_t level = 1; level < image.mip_levels; level++) {
+    level_texels = downsample(tr::renderer::mip_extent(extent, level - 1), level_texels);
+    const auto blocks = encode(tr::renderer::mip_extent(extent, level), level_texels);
+    image.blocks.insert(image.blocks.end(), blocks.begin(), blocks.end());
+  }
+  image.pixels.reset();
+}
 
+// Texture streaming uploads levels one by one, the whole chain has to be there from the start
+void build_mip_chain(DecodedImage& image) {
+  if (!image.pixels) {
+    return;
+  }
+
+  const VkExtent2D extent{image.width, image.height};
+  const auto base = image.bytes();
+  image.mip_levels = tr::renderer::mip_level_count(extent);
+  image.blocks.reserve(image.size_bytes());
+  image.blocks.assign(base.begin(), base.end());
+  std::vector<std::byte> level_texels{base.begin(), base.end()};
+  for (uint32_t level = 1; level < image.mip_levels; level++) {
+    level_texels = downsample(tr::renderer::mip_extent(extent, level - 1), level_texels);
+    image.blocks.insert(image.blocks.end(), level_texels.begin(), level_texels.end());
+  }
+  image.pixels.reset();
+}
+
+// Owns everything the spans of a SceneData parsed from glTF point into
+// deques so that growing them never moves what has already been handed out
+struct GltfStorage {
+  std::deque<DecodedImage> images;
+  std::deque<std::string> names;
+  std::deque<std::vector<uint32_t>> instances;
+  std::deque<std::vector<tr::renderer::VertexPosition>> positions;
+  std::deque<std::vector<tr::renderer::PackedAttributes>> attributes;
+  std::deque<std::vector<uint32_t>> indices;
+  std::deque<std::vector<tr::SceneData::Surface>> surfaces;
+  std::deque<std::vector<tr::renderer::Meshlet>> meshlets;
+  std::deque<std::vector<tr::renderer::SurfaceLod>> lods;
+  tr::SceneCells cells;
+};
+
+// Images being decoded on the pool, see finish_images
+struct PendingImages {
+  std::vector<std::size_t> reference_counts;
+  std::vector<std::future<void>> decodes;
+};
+
+// Fills scene.materials and queues the decoding of their images into storage, each image is decoded once however many
+// materials reference it. Meshes are loaded in the meantime
+// When compress is set, images are block compressed according to how the first material using them samples them
+auto load_materials(utils::ThreadPool& pool, const fastgltf::Asset& asset, GltfStorage& storage, tr::SceneData& scene,
+                    bool compress, tr::LoadReport& load_report) -> PendingImages {
+  // glTF image index -> index in scene.images, images no material uses are never decoded
+  std::vector<std::optional<uint32_t>> image_slots(asset.images.size());
+  std::vector<std::size_t> used_images;
+  std::vector<std::size_t> reference_counts;
+  std::vector<ImageUsage> usages;
+
+  const auto image_slot = [&](std::size_t texture_index, ImageUsage usage) -> uint32_t {
+    const auto& texture = asset.textures[texture_index];
+    TR_ASSERT(texture.imageIndex, "no image index, not supported");
+
+    auto& slot = image_slots[*texture.imageIndex];
+    if (!slot) {
+      slot = utils::narrow_cast<uint32_t>(used_images.size());
+      used_images.push_back(*texture.imageIndex);
+      reference_counts.push_back(0);
+      usages.push_back(usage);
+    }
+    reference_counts[*slot]++;
+    return *slot;
+  };
+
+  scene.materials.reserve(asset.materials.size());
+  for (const auto& material : asset.materials) {
     TR_ASSERT(material.pbrData.baseColorTexture, "no base color texture, not supported");
-    const auto& color_texture = asset.textures[material.pbrData.baseColorTexture->textureIndex];
-    TR_ASSERT(color_texture.imageIndex, "no image index, not supported");
-    auto [albedo_texture, albedo_handle] =
-        load_texture(lifetime, ib, t, rm, asset.images[*color_texture.imageIndex], "base color");
-    mat.albedo_texture = albedo_texture;
-    mat.handles.albedo_handle = albedo_handle;
+    tr::SceneData::Material mat{
+        .albedo = image_slot(material.pbrData.baseColorTexture->textureIndex, ImageUsage::Albedo),
+        .metallic_roughness = std::nullopt,
+        .normal = std::nullopt,
+    };
 
     if (material.pbrData.metallicRoughnessTexture) {
-      const auto& metallic_roughness_texture = asset.textures[material.pbrData.metallicRoughnessTexture->textureIndex];
-      TR_ASSERT(metallic_roughness_texture.imageIndex, "no image index, not supported");
-      auto [metallic_roughness_tex, metallic_roughness_handle] =
-          load_texture(lifetime, ib, t, rm, asset.images[*metallic_roughness_texture.imageIndex], "metal roughness");
-      mat.metallic_roughness_texture = metallic_roughness_tex;
-      mat.handles.metallic_roughness_handle = metallic_roughness_handle;
+      mat.metallic_roughness =
+          image_slot(material.pbrData.metallicRoughnessTexture->textureIndex, ImageUsage::MetallicRoughness);
     }
-
     if (material.normalTexture) {
-      const auto& normal_texture = asset.textures[material.normalTexture->textureIndex];
-      TR_ASSERT(normal_texture.imageIndex, "no image index, not supported");
-      auto [normal_tex, normal_handle] =
-          load_texture(lifetime, ib, t, rm, asset.images[*normal_texture.imageIndex], "normal map");
-      mat.normal_texture = normal_tex;
-      mat.handles.normal_handle = normal_handle;
+      mat.normal = image_slot(material.normalTexture->textureIndex, ImageUsage::Normal);
     }
+    scene.materials.push_back(mat);
+  }
+
+  spdlog::debug("Decoding {} images on {} threads", used_images.size(), pool.size());
+  storage.images.resize(used_images.size());
+  PendingImages pending{.reference_counts = std::move(reference_counts), .decodes = {}};
+  pending.decodes.reserve(used_images.size());
+  for (std::size_t i = 0; i < used_images.size(); i++) {
+    auto decode = [&asset, &storage, &load_report, compress, i, index = used_images[i], usage = usages[i]] {
+      const auto& gltf_image = asset.images[index];
+      const auto name = gltf_image.name.empty() ? std::format("image {}", index) : std::string{gltf_image.name};
+      auto& image = storage.images[i];
+      {
+        // The chain is built from the decoded pixels when there is no compression to do it
+        tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::DecodeImage, name};
+        image = decode_image(gltf_image);
+        if (!compress) {
+          build_mip_chain(image);
+        }
+        scope.bytes = image.size_bytes();
+      }
+      if (compress) {
+        tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::CompressImage, name};
+        compress_image(image, usage);
+        scope.bytes = image.size_bytes();
+      }
+    };
+    pending.decodes.push_back(pool.submit(std::move(decode)));
+  }
+  return pending;
+}
 
-    materials.push_back(mat);
+// Waits for the images of load_materials and fills scene.images
+void finish_images(PendingImages& pending, const GltfStorage& storage, tr::SceneData& scene) {
+  const auto& reference_counts = pending.reference_counts;
+  std::size_t texture_references = 0;
+  std::size_t deduplicated_bytes = 0;
+  std::size_t raw_bytes = 0;
+  std::size_t bytes = 0;
+  scene.images.reserve(pending.decodes.size());
+  for (std::size_t i = 0; i < pending.decodes.size(); i++) {
+    pending.decodes[i].get();
+    const auto& decoded = storage.images[i];
+    scene.images.push_back({
+        .width = decoded.width,
+        .height = decoded.height,
+        .format = decoded.format,
+        .mip_levels = decoded.mip_levels,
+        .texels = decoded.bytes(),
+    });
+
+    texture_references += reference_counts[i];
+    deduplicated_bytes += (reference_counts[i] - 1) * decoded.size_bytes();
+    raw_bytes += tr::renderer::FormatBlock::of(VK_FORMAT_R8G8B8A8_UNORM)
+                     .size_bytes({decoded.width, decoded.height}, decoded.mip_levels);
+    bytes += decoded.size_bytes();
   }
-  return materials;
+  spdlog::info("Decoded {} images for {} texture references ({:.1f} MiB deduplicated)", pending.decodes.size(),
+               texture_references, static_cast<double>(deduplicated_bytes) / (1 << 20));
+  spdlog::info("Images take {:.1f} MiB, {:.1f} MiB as R8G8B8A8", static_cast<double>(bytes) / (1 << 20),
+               static_cast<double>(raw_bytes) / (1 << 20));
 }
 
-template <class T, class Fn>
-void load_attribute_into(const fastgltf::Asset& asset, const fastgltf::Accessor& accessor,
-                         std::span<tr::renderer::Vertex> vertices, Fn&& proj) {
-  auto f = std::forward<Fn>(proj);
-  fastgltf::iterateAccessorWithIndex<T>(asset, accessor,
-                                        [&](T t, size_t v_idx) { std::invoke(f, vertices[v_idx], t); });
+// Empty when the buffer is not loaded
+auto buffer_bytes(const fastgltf::Asset& asset, std::size_t buffer) -> std::span<const std::byte> {
+  return std::visit(utils::overloaded{
+                        [](const has_bytes auto& c) { return std::as_bytes(std::span(c.bytes)); },
+                        [](const auto&) { return std::span<const std::byte>{}; },
+                    },
+                    asset.buffers[buffer].data);
 }
 
-template <class T, T tr::renderer::Vertex::*proj>
-auto make_vertex_attribute_setter() -> void (*)(tr::renderer::Vertex&, T) {
-  return [](tr::renderer::Vertex& vertex, T t) { std::invoke(proj, vertex) = t; };
+// Accessors can't read meshopt compressed buffer views as they are, those are decoded up front. Indexed by buffer
+// view, empty for the views that are not compressed
+using DecodedViews = std::vector<std::vector<std::byte>>;
+
+auto decode_meshopt_views(utils::ThreadPool& pool, const fastgltf::Asset& asset, tr::LoadReport& load_report)
+    -> DecodedViews {
+  DecodedViews decoded(asset.bufferViews.size());
+  std::vector<std::size_t> compressed;
+  for (std::size_t v = 0; v < asset.bufferViews.size(); v++) {
+    if (asset.bufferViews[v].meshoptCompression) {
+      compressed.push_back(v);
+    }
+  }
+  if (compressed.empty()) {
+    return decoded;
+  }
+
+  spdlog::debug("Decoding {} meshopt compressed buffer views on {} threads", compressed.size(), pool.size());
+  pool.parallel_for(compressed.size(), [&](std::size_t i) {
+    const auto v = compressed[i];
+    const auto& view = *asset.bufferViews[v].meshoptCompression;
+    const auto buffer = buffer_bytes(asset, view.bufferIndex);
+    TR_ASSERT(view.byteOffset + view.byteLength <= buffer.size(), "meshopt buffer view {} is not loaded", v);
+    const auto in = buffer.subspan(view.byteOffset, view.byteLength);
+    auto& out = decoded[v];
+    out.resize(view.count * view.byteStride);
+    const tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::DecodeMeshopt,
+                                      std::format("buffer view {}", v), out.size()};
+
+    bool ok = false;
+    switch (view.mode) {
+      case fastgltf::MeshoptCompressionMode::Attributes:
+        ok = tr::meshopt::decode_vertex_buffer(out, view.count, view.byteStride, in);
+        break;
+      case fastgltf::MeshoptCompressionMode::Triangles:
+        ok = tr::meshopt::decode_index_buffer(out, view.count, view.byteStride, in);
+        break;
+      case fastgltf::MeshoptCompressionMode::Indices:
+        ok = tr::meshopt::decode_index_sequence(out, view.count, view.byteStride, in);
+        break;
+      default:
+        break;
+    }
+    TR_ASSERT(ok, "malformed meshopt buffer view {}", v);
+
+    switch (view.filter) {
+      case fastgltf::MeshoptCompressionFilter::Octahedral:
+        tr::meshopt::filter_octahedral(out, view.count, view.byteStride);
+        break;
+      case fastgltf::MeshoptCompressionFilter::Quaternion:
+        tr::meshopt::filter_quaternion(out, view.count);
+        break;
+      case fastgltf::MeshoptCompressionFilter::Exponential:
+        tr::meshopt::filter_exponential(out, view.count, view.byteStride);
+        break;
+      default:
+        break;
+    }
+  });
+  return decoded;
 }
 
-template <class T>
-using vertex_attribute_setter = void (*)(tr::renderer::Vertex&, T);
+// Empty when the buffer is not loaded
+auto view_bytes(const fastgltf::Asset& asset, const DecodedViews& decoded, std::size_t v)
+    -> std::span<const std::byte> {
+  const auto& view = asset.bufferViews[v];
+  if (view.meshoptCompression) {
+    return decoded[v];
+  }
+  const auto buffer = buffer_bytes(asset, view.bufferIndex);
+  if (buffer.empty()) {
+    return {};
+  }
+  TR_ASSERT(view.byteOffset + view.byteLength <= buffer.size(), "buffer view {} goes past the end of its buffer", v);
+  return buffer.subspan(view.byteOffset, view.byteLength);
+}
 
-const std::unordered_map<std::string, vertex_attribute_setter<glm::vec2>> vertex_projs_vec2{
-    {"TEXCOORD_0", make_vertex_attribute_setter<glm::vec2, &tr::renderer::Vertex::uv1>()},
-    {"TEXCOORD_1", make_vertex_attribute_setter<glm::vec2, &tr::renderer::Vertex::uv2>()},
-};
-const std::unordered_map<std::string, vertex_attribute_setter<glm::vec3>> vertex_projs_vec3{
-    {"POSITION", make_vertex_attribute_setter<glm::vec3, &tr::renderer::Vertex::pos>()},
-    {"NORMAL", make_vertex_attribute_setter<glm::vec3, &tr::renderer::Vertex::normal>()},
-    {"COLOR_0", make_vertex_attribute_setter<glm::vec3, &tr::renderer::Vertex::color>()},
+auto is_compressed(const fastgltf::Asset& asset, const fastgltf::Accessor& accessor) -> bool {
+  return accessor.bufferViewIndex && asset.bufferViews[*accessor.bufferViewIndex].meshoptCompression;
+}
+
+// Where a glTF attribute goes in a Vertex, always floats
+struct AttributeSlot {
+  std::string_view name;
+  std::size_t offset;
+  std::size_t components;
 };
-const std::unordered_map<std::string, vertex_attribute_setter<glm::vec4>> vertex_projs_vec4{
-    {"TANGENT", [](tr::renderer::Vertex& vertex, glm::vec4 tangent) { vertex.tangent = tangent; }},
+constexpr std::array attribute_slots{
+    AttributeSlot{"POSITION", offsetof(tr::renderer::Vertex, pos), 3},
+    AttributeSlot{"NORMAL", offsetof(tr::renderer::Vertex, normal), 3},
+    AttributeSlot{"TANGENT", offsetof(tr::renderer::Vertex, tangent), 4},
+    AttributeSlot{"COLOR_0", offsetof(tr::renderer::Vertex, color), 3},
+    AttributeSlot{"TEXCOORD_0", offsetof(tr::renderer::Vertex, uv1), 2},
+    AttributeSlot{"TEXCOORD_1", offsetof(tr::renderer::Vertex, uv2), 2},
 };
 
-void load_attribute(const fastgltf::Asset& asset, const fastgltf::Accessor& accessor,
-                    std::span<tr::renderer::Vertex> vertices, const std::string& attribute) {
-  if (const auto proj_it = vertex_projs_vec2.find(attribute); proj_it != vertex_projs_vec2.end()) {
-    return load_attribute_into<glm::vec2>(asset, accessor, vertices, proj_it->second);
+// Converts N components of type T per element from a strided buffer into N floats per element of another one
+// Sizes are known at compile time so that the loop is plain loads, converts and stores
+template <class T, std::size_t N>
+void decode_strided(const std::byte* src, std::size_t stride, bool normalized, std::byte* dst, std::size_t dst_stride,
+                    std::size_t count) {
+  float scale = 1.F;
+  float lowest = -std::numeric_limits<float>::infinity();
+  if constexpr (std::is_integral_v<T>) {
+    if (normalized) {
+      scale = 1.F / static_cast<float>(std::numeric_limits<T>::max());
+      // The most negative value is -1 as well
+      lowest = -1.F;
+    }
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    std::array<T, N> in{};
+    std::memcpy(in.data(), src + i * stride, sizeof(in));
+    std::array<float, N> out{};
+    for (std::size_t c = 0; c < N; c++) {
+      out[c] = std::max(static_cast<float>(in[c]) * scale, lowest);
+    }
+    std::memcpy(dst + i * dst_stride, out.data(), sizeof(out));
+  }
+}
+
+template <std::size_t N>
+auto decode_components(const fastgltf::Accessor& accessor, const std::byte* src, std::size_t stride, std::byte* dst,
+                       std::size_t dst_stride) -> bool {
+  switch (accessor.componentType) {
+    case fastgltf::ComponentType::Float:
+      decode_strided<float, N>(src, stride, accessor.normalized, dst, dst_stride, accessor.count);
+      return true;
+    case fastgltf::ComponentType::UnsignedByte:
+      decode_strided<uint8_t, N>(src, stride, accessor.normalized, dst, dst_stride, accessor.count);
+      return true;
+    case fastgltf::ComponentType::Byte:
+      decode_strided<int8_t, N>(src, stride, accessor.normalized, dst, dst_stride, accessor.count);
+      return true;
+    case fastgltf::ComponentType::UnsignedShort:
+      decode_strided<uint16_t, N>(src, stride, accessor.normalized, dst, dst_stride, accessor.count);
+      return true;
+    case fastgltf::ComponentType::Short:
+      decode_strided<int16_t, N>(src, stride, accessor.normalized, dst, dst_stride, accessor.count);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Straight from the buffer view bytes into components floats every dst_stride bytes of dst, which has room for
+// accessor.count elements. Returns false when the accessor needs the generic path (sparse, no buffer view, buffer not
+// loaded, fewer components than asked for)
+auto decode_accessor(const fastgltf::Asset& asset, const DecodedViews& decoded, const fastgltf::Accessor& accessor,
+                     std::byte* dst, std::size_t dst_stride, std::size_t components) -> bool {
+  // Extra components are dropped, like COLOR_0 alpha
+  if (accessor.sparse || !accessor.bufferViewIndex || fastgltf::getNumComponents(accessor.type) < components) {
+    return false;
   }
-  if (const auto proj_it = vertex_projs_vec3.find(attribute); proj_it != vertex_projs_vec3.end()) {
-    return load_attribute_into<glm::vec3>(asset, accessor, vertices, proj_it->second);
+  const auto bytes = view_bytes(asset, decoded, *accessor.bufferViewIndex);
+  if (bytes.empty()) {
+    return false;
+  }
+
+  const auto element_size = fastgltf::getElementByteSize(accessor.type, accessor.componentType);
+  const auto stride = asset.bufferViews[*accessor.bufferViewIndex].byteStride.value_or(element_size);
+  TR_ASSERT(accessor.count == 0 || accessor.byteOffset + (accessor.count - 1) * stride + element_size <= bytes.size(),
+            "accessor goes past the end of its buffer view");
+
+  const auto* src = bytes.data() + accessor.byteOffset;
+  switch (components) {
+    case 2:
+      return decode_components<2>(accessor, src, stride, dst, dst_stride);
+    case 3:
+      return decode_components<3>(accessor, src, stride, dst, dst_stride);
+    case 4:
+      return decode_components<4>(accessor, src, stride, dst, dst_stride);
+    default:
+      return false;
+  }
+}
+
+template <class T>
+void iterate_accessor(const fastgltf::Asset& asset, const fastgltf::Accessor& accessor, std::byte* dst,
+                      std::size_t dst_stride) {
+  fastgltf::iterateAccessorWithIndex<T>(
+      asset, accessor, [&](T t, std::size_t idx) { std::memcpy(dst + idx * dst_stride, &t, sizeof(T)); });
+}
+
+// Either path, dst is as for decode_accessor
+void read_accessor(const fastgltf::Asset& asset, const DecodedViews& decoded, const fastgltf::Accessor& accessor,
+                   std::byte* dst, std::size_t dst_stride, std::size_t components) {
+  if (decode_accessor(asset, decoded, accessor, dst, dst_stride, components)) {
+    return;
+  }
+  TR_ASSERT(!is_compressed(asset, accessor), "accessor can't be read from a meshopt compressed buffer view");
+
+  switch (components) {
+    case 2:
+      return iterate_accessor<glm::vec2>(asset, accessor, dst, dst_stride);
+    case 3:
+      return iterate_accessor<glm::vec3>(asset, accessor, dst, dst_stride);
+    case 4:
+      return iterate_accessor<glm::vec4>(asset, accessor, dst, dst_stride);
+    default:
+      TR_ASSERT(false, "no accessor is read as {} components", components);
+  }
+}
+
+void load_attribute(const fastgltf::Asset& asset, const DecodedViews& decoded, const fastgltf::Accessor& accessor,
+                    std::span<tr::renderer::Vertex> vertices, std::string_view attribute) {
+  const auto slot = std::ranges::find(attribute_slots, attribute, &AttributeSlot::name);
+  if (slot == attribute_slots.end()) {
+    static std::unordered_map<std::string, std::once_flag> warn_once_flags;
+    std::call_once(warn_once_flags[std::string{attribute}], [&] { spdlog::warn("Unknown attribute {}", attribute); });
+    return;
+  }
+  TR_ASSERT(accessor.count <= vertices.size(), "attribute {} has more elements than there are vertices", attribute);
+  read_accessor(asset, decoded, accessor, reinterpret_cast<std::byte*>(vertices.data()) + slot->offset,
+                sizeof(tr::renderer::Vertex), slot->components);
+}
+
+template <class T>
+void copy_indices(const std::byte* src, std::span<uint32_t> indices, uint32_t first_vertex) {
+  for (std::size_t i = 0; i < indices.size(); i++) {
+    T index{};
+    std::memcpy(&index, src + i * sizeof(T), sizeof(T));
+    indices[i] = first_vertex + index;
   }
-  if (const auto proj_it = vertex_projs_vec4.find(attribute); proj_it != vertex_projs_vec4.end()) {
-    return load_attribute_into<glm::vec4>(asset, accessor, vertices, proj_it->second);
+}
+
+// Indices are tightly packed, straight from the buffer view bytes as well when possible
+void load_indices(const fastgltf::Asset& asset, const DecodedViews& decoded, const fastgltf::Accessor& accessor,
+                  std::span<uint32_t> indices, uint32_t first_vertex) {
+  const auto bytes = accessor.sparse || !accessor.bufferViewIndex
+                         ? std::span<const std::byte>{}
+                         : view_bytes(asset, decoded, *accessor.bufferViewIndex);
+  if (!bytes.empty()) {
+    const auto element_size = fastgltf::getElementByteSize(accessor.type, accessor.componentType);
+    TR_ASSERT(accessor.byteOffset + accessor.count * element_size <= bytes.size(),
+              "accessor goes past the end of its buffer view");
+    const auto* src = bytes.data() + accessor.byteOffset;
+    switch (accessor.componentType) {
+      case fastgltf::ComponentType::UnsignedByte:
+        return copy_indices<uint8_t>(src, indices, first_vertex);
+      case fastgltf::ComponentType::UnsignedShort:
+        return copy_indices<uint16_t>(src, indices, first_vertex);
+      case fastgltf::ComponentType::UnsignedInt:
+        return copy_indices<uint32_t>(src, indices, first_vertex);
+      default:
+        break;
+    }
   }
 
-  static std::unordered_map<std::string, std::once_flag> warn_once_flags;
-  std::call_once(warn_once_flags[attribute], [&] { spdlog::warn("Unknown attribute {}", attribute); });
+  TR_ASSERT(!is_compressed(asset, accessor), "indices can't be read from a meshopt compressed buffer view");
+  fastgltf::iterateAccessorWithIndex<uint32_t>(
+      asset, accessor, [&](uint32_t idx, std::size_t i_idx) { indices[i_idx] = first_vertex + idx; });
 }
 
-auto load_primitive(const fastgltf::Primitive& primitive, const fastgltf::Asset& asset, std::vector<uint32_t>& indices,
-                    std::vector<tr::renderer::Vertex>& vertices, tr::renderer::MaterialHandles material)
-    -> tr::renderer::GeoSurface {
+// How primitives show up in the load report
+auto primitive_name(std::string_view mesh, std::size_t primitive) -> std::string {
+  return std::format("{} #{}", mesh.empty() ? "mesh" : mesh, primitive);
+}
+
+auto load_primitive(const fastgltf::Primitive& primitive, const fastgltf::Asset& asset, const DecodedViews& decoded,
+                    std::vector<uint32_t>& indices, std::vector<tr::renderer::Vertex>& vertices, uint32_t material,
+                    tr::LoadReport& load_report, std::string name) -> tr::SceneData::Surface {
   const auto vertex_idx_offset = utils::narrow_cast<uint32_t>(vertices.size());
   const auto index_idx_offset = utils::narrow_cast<uint32_t>(indices.size());
 
@@ -207,60 +651,22 @@ auto load_primitive(const fastgltf::Primitive& primitive, const fastgltf::Asset&
 
     indices.resize(index_idx_offset + accessor.count);
     auto primitive_indices_ = std::span(indices).subspan(index_idx_offset);
-
-    fastgltf::iterateAccessorWithIndex<uint32_t>(
-        asset, accessor, [&](uint32_t idx, std::size_t i_idx) { primitive_indices_[i_idx] = vertex_idx_offset + idx; });
+    load_indices(asset, decoded, accessor, primitive_indices_, vertex_idx_offset);
     return primitive_indices_;
   };
   const auto count = primitive_indices.size();
 
-  bool has_tangent_attribute = false;
   for (const auto& [attribute, accessor_index] : primitive.attributes) {
     const auto& accessor = asset.accessors[accessor_index];
     vertices.resize(std::max(vertices.size(), vertex_idx_offset + accessor.count));
-    load_attribute(asset, accessor, std::span(vertices).subspan(vertex_idx_offset), std::string{attribute});
-
-    if (attribute == "TANGENT") {
-      has_tangent_attribute = true;
-    }
+    load_attribute(asset, decoded, accessor, std::span(vertices).subspan(vertex_idx_offset),
+                   std::string_view{attribute});
   }
   auto primitive_vertices = std::span(vertices).subspan(vertex_idx_offset);
+  TR_ASSERT(primitive_indices.size() % 3 == 0, "HUHU,  number of indices is not divisible by 3");
 
-  if (!has_tangent_attribute) {
-    spdlog::debug("model does not contain tangents, computing them! (at least trying)");
-    TR_ASSERT(primitive_indices.size() % 3 == 0, "HUHU,  number of indices is not divisible by 3");
-
-    auto it = primitive_indices.begin();
-    auto end = primitive_indices.end();
-    while (it != end) {
-      const auto i0 = *(it++);
-      const auto i1 = *(it++);
-      const auto i2 = *(it++);
-
-      auto& v0 = vertices[i0];
-      auto& v1 = vertices[i1];
-      auto& v2 = vertices[i2];
-
-      // p182
-      // https://canvas.projekti.info/ebooks/Mathematics%20for%203D%20Game%20Programming%20and%20Computer%20Graphics,%20Third%20Edition.pdf
-      // Notes: what is a vertex is reused? The tangent is dependant on the order of iteration, this is bad?
-      const auto Q1 = v1.pos - v0.pos;
-      const auto S1 = v1.uv1 - v0.uv1;
-
-      const auto Q2 = v2.pos - v0.pos;
-      const auto S2 = v2.uv1 - v0.uv1;
-
-      const auto Q = glm::mat2{Q1, Q2};
-      const auto S_inv = glm::inverse(glm::mat2{S1, S2});
-      const glm::mat2x3 TB = S_inv * Q;
-
-      // gram-schmidt
-      v0.tangent = glm::normalize(TB[0] - glm::dot(TB[0], v0.normal) * v0.normal);
-      v1.tangent = glm::normalize(TB[0] - glm::dot(TB[0], v1.normal) * v1.normal);
-      v2.tangent = glm::normalize(TB[0] - glm::dot(TB[0], v2.normal) * v2.normal);
-    }
-  }
-
+  const tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::Bounds, std::move(name),
+                                    primitive_vertices.size_bytes() + primitive_indices.size_bytes()};
   const auto bounding_box = INLINE_LAMBDA->tr::renderer::AABB {
     auto mmin = glm::vec3(std::numeric_limits<float>::infinity());
     auto mmax = glm::vec3(-std::numeric_limits<float>::infinity());
@@ -279,114 +685,363 @@ auto load_primitive(const fastgltf::Primitive& primitive, const fastgltf::Asset&
     return {mmin, mmax};
   };
 
+  // Ratio of the uv area to the area of the triangles, texture streaming picks mips from it
+  const auto uv_density = INLINE_LAMBDA {
+    double area = 0.;
+    double uv_area = 0.;
+    for (std::size_t i = 0; i + 2 < count; i += 3) {
+      const auto& v0 = vertices[primitive_indices[i]];
+      const auto& v1 = vertices[primitive_indices[i + 1]];
+      const auto& v2 = vertices[primitive_indices[i + 2]];
+      area += glm::length(glm::cross(v1.pos - v0.pos, v2.pos - v0.pos));
+      const auto e1 = v1.uv1 - v0.uv1;
+      const auto e2 = v2.uv1 - v0.uv1;
+      uv_area += std::abs(e1.x * e2.y - e2.x * e1.y);
+    }
+    return area > 0. ? static_cast<float>(std::sqrt(uv_area / area)) : 0.F;
+  };
+
   return {
       .start = utils::narrow_cast<uint32_t>(index_idx_offset),
       .count = utils::narrow_cast<uint32_t>(count),
       .material = material,
       .bounding_box = bounding_box,
+      .uv_density = uv_density,
+      // Filled in once the primitive is optimized
+      .first_meshlet = 0,
+      .meshlet_count = 0,
+      .first_lod = 0,
+      .lod_count = 0,
   };
 }
 
-auto load_meshes(tr::renderer::Lifetime& lifetime, tr::renderer::BufferBuilder& bb, tr::renderer::Transferer& t,
-                 const fastgltf::Asset& asset, std::span<const tr::renderer::Material> materials)
-    -> std::vector<tr::renderer::Mesh> {
-  std::vector<tr::renderer::Mesh> meshes;
-  for (const auto& scene : asset.scenes) {
-    for (auto node_idx : scene.nodeIndices) {
-      const auto& node = asset.nodes[node_idx];
-
-      tr::renderer::Mesh asset_mesh;
-      std::visit(
-          utils::overloaded{
-              [&](const fastgltf::Node::TRS& trs) {
-                const auto rot = glm::mat4_cast(glm::make_quat(trs.rotation.data()));
-                const auto scale = glm::scale(glm::identity<glm::mat4>(), glm::make_vec3(trs.scale.data()));
-                const auto translate =
-                    glm::translate(glm::identity<glm::mat4>(), glm::make_vec3(trs.translation.data()));
-
-                asset_mesh.transform = translate * rot * scale;
-              },
-              [&](const fastgltf::Node::TransformMatrix& trs) { asset_mesh.transform = glm::make_mat4(trs.data()); },
-          },
-          node.transform);
-
-      TR_ASSERT(node.meshIndex, "Child not supported");
-      const auto& mesh = asset.meshes[*node.meshIndex];
-
-      std::vector<uint32_t> indices;
-      std::vector<tr::renderer::Vertex> vertices;
-      for (const auto& primitive : mesh.primitives) {
-        TR_ASSERT(primitive.materialIndex, "material needed");
-
-        asset_mesh.surfaces.push_back(
-            load_primitive(primitive, asset, indices, vertices, materials[*primitive.materialIndex].handles));
-      }
+// Local transforms of the instances of an EXT_mesh_gpu_instancing node, relative to the node. Parents are left unset
+auto load_instances(const fastgltf::Asset& asset, const DecodedViews& decoded, const fastgltf::Node& node)
+    -> std::vector<tr::SceneData::Node> {
+  std::vector<tr::SceneData::Node> instances;
+  for (const auto& [attribute, accessor_index] : node.instancingAttributes) {
+    const auto& accessor = asset.accessors[accessor_index];
+    if (instances.empty()) {
+      instances.resize(accessor.count, tr::SceneData::Node{
+                                           .parent = tr::NodeHierarchy::no_parent,
+                                           .translation = glm::vec3{0.F},
+                                           .rotation = glm::identity<glm::quat>(),
+                                           .scale = glm::vec3{1.F},
+                                       });
+    }
+    TR_ASSERT(accessor.count == instances.size(), "instancing attributes have different counts");
+
+    // glm stores quaternions as xyzw, like glTF
+    auto* dst = reinterpret_cast<std::byte*>(instances.data());
+    if (attribute == "TRANSLATION") {
+      read_accessor(asset, decoded, accessor, dst + offsetof(tr::SceneData::Node, translation),
+                    sizeof(tr::SceneData::Node), 3);
+    } else if (attribute == "ROTATION") {
+      read_accessor(asset, decoded, accessor, dst + offsetof(tr::SceneData::Node, rotation),
+                    sizeof(tr::SceneData::Node), 4);
+    } else if (attribute == "SCALE") {
+      read_accessor(asset, decoded, accessor, dst + offsetof(tr::SceneData::Node, scale), sizeof(tr::SceneData::Node),
+                    3);
+    }
+  }
+  return instances;
+}
 
-      auto vertices_bytes = std::as_bytes(std::span(vertices));
-      asset_mesh.buffers.vertices = bb.build_buffer({
-          .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-          .size = utils::narrow_cast<uint32_t>(vertices_bytes.size_bytes()),
-          .flags = 0,
-          .debug_name = std::format("vertex buffer for {}", mesh.name),
-      });
-      asset_mesh.buffers.vertices.tie(lifetime);
-      t.upload_buffer(asset_mesh.buffers.vertices.buffer, 0, vertices_bytes);
+// KHR_mesh_quantization positions, they are expanded to the 3 floats of VertexPosition like any other
+struct QuantizedPositions {
+  std::size_t vertices = 0;
+  // Over what they would take as a vertex format of their own, padded to 4 bytes
+  std::size_t expanded_bytes = 0;
+};
 
-      auto indices_bytes = std::as_bytes(std::span(indices));
-      asset_mesh.buffers.indices = bb.build_buffer({
-          .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-          .size = utils::narrow_cast<uint32_t>(indices_bytes.size_bytes()),
-          .flags = 0,
-          .debug_name = std::format("index buffer for {}", mesh.name),
-      });
-      asset_mesh.buffers.indices->tie(lifetime);
-      t.upload_buffer(asset_mesh.buffers.indices->buffer, 0, indices_bytes);
+void count_quantized_positions(const fastgltf::Asset& asset, const fastgltf::Primitive& primitive,
+                               QuantizedPositions& quantized) {
+  const auto position = std::ranges::find_if(primitive.attributes, [](const auto& a) { return a.first == "POSITION"; });
+  if (position == primitive.attributes.end()) {
+    return;
+  }
+  const auto& accessor = asset.accessors[position->second];
+  if (accessor.componentType == fastgltf::ComponentType::Float) {
+    return;
+  }
+  const auto size = utils::align(fastgltf::getElementByteSize(accessor.type, accessor.componentType), std::size_t{4});
+  quantized.vertices += accessor.count;
+  quantized.expanded_bytes += accessor.count * (sizeof(tr::renderer::VertexPosition) - size);
+}
 
-      meshes.push_back(asset_mesh);
+void load_meshes(utils::ThreadPool& pool, const fastgltf::Asset& asset, const DecodedViews& decoded,
+                 GltfStorage& storage, tr::SceneData& scene, tr::LoadReport& load_report) {
+  // Full precision meshes, kept until they are optimized
+  struct LoadedMesh {
+    std::string_view name;
+    // Into SceneData::nodes
+    std::vector<uint32_t> instances;
+    std::vector<tr::renderer::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<tr::SceneData::Surface> surfaces;
+    // Start of the vertices of each surface, they own [first_vertices[i], first_vertices[i + 1])
+    std::vector<uint32_t> first_vertices;
+    std::vector<tr::renderer::Meshlet> meshlets;
+    std::vector<tr::renderer::SurfaceLod> lods;
+    // Per surface, tangents are generated once the indices are local to the surface
+    std::vector<uint8_t> missing_tangents;
+  };
+  std::vector<LoadedMesh> loaded;
+  QuantizedPositions quantized_positions;
+  // glTF mesh index -> index in loaded, every node using a mesh shares its geometry
+  std::vector<std::optional<std::size_t>> mesh_slots(asset.meshes.size());
+
+  // Instances of EXT_mesh_gpu_instancing become child nodes of the node that holds them
+  std::vector<tr::SceneData::Node> instance_nodes;
+  struct Pending {
+    std::size_t node;
+    uint32_t parent;
+    // Into instance_nodes, the entry is then an instance of the mesh of node
+    std::optional<std::size_t> instance;
+  };
+
+  // Breadth first so that nodes come depth by depth, a node reachable from several places is duplicated
+  std::vector<Pending> pending;
+  for (const auto& gltf_scene : asset.scenes) {
+    for (auto node_idx : gltf_scene.nodeIndices) {
+      pending.push_back({node_idx, tr::NodeHierarchy::no_parent, std::nullopt});
     }
   }
+  for (std::size_t i = 0; i < pending.size(); i++) {
+    const auto [node_idx, parent, instance] = pending[i];
+    const auto& node = asset.nodes[node_idx];
 
-  return meshes;
-}
-auto load(tr::renderer::Lifetime& lifetime, tr::renderer::ImageBuilder& ib, tr::renderer::BufferBuilder& bb,
-          tr::renderer::Transferer& t, tr::renderer::RessourceManager& rm, const fastgltf::Asset& asset)
-    -> std::pair<std::vector<tr::renderer::Material>, std::vector<tr::renderer::Mesh>> {
-  {
-    const auto err = fastgltf::validate(asset);
-    TR_ASSERT(err == fastgltf::Error::None, "Invalid GLTF: {} {}", fastgltf::getErrorName(err),
-              fastgltf::getErrorMessage(err));
+    if (instance) {
+      auto& instance_node = scene.nodes.emplace_back(instance_nodes[*instance]);
+      instance_node.parent = parent;
+      loaded[*mesh_slots[*node.meshIndex]].instances.push_back(utils::narrow_cast<uint32_t>(scene.nodes.size() - 1));
+      continue;
+    }
+
+    auto& scene_node = scene.nodes.emplace_back(tr::SceneData::Node{
+        .parent = parent,
+        .translation = glm::vec3{0.F},
+        .rotation = glm::identity<glm::quat>(),
+        .scale = glm::vec3{1.F},
+    });
+    std::visit(
+        utils::overloaded{
+            [&](const fastgltf::Node::TRS& trs) {
+              scene_node.translation = glm::make_vec3(trs.translation.data());
+              scene_node.rotation = glm::make_quat(trs.rotation.data());
+              scene_node.scale = glm::make_vec3(trs.scale.data());
+            },
+            [&](const fastgltf::Node::TransformMatrix& trs) {
+              glm::vec3 skew;
+              glm::vec4 perspective;
+              const bool decomposed = glm::decompose(glm::make_mat4(trs.data()), scene_node.scale, scene_node.rotation,
+                                                     scene_node.translation, skew, perspective);
+              if (!decomposed) {
+                // Exporters hide nodes with a zero scale, the node keeps its translation and stays hidden
+                spdlog::warn("node {} has a degenerate matrix, it is scaled to zero", node_idx);
+                scene_node.translation = glm::make_vec3(trs.data() + 12);
+                scene_node.rotation = glm::identity<glm::quat>();
+                scene_node.scale = glm::vec3{0.F};
+              }
+            },
+        },
+        node.transform);
+
+    const auto index = utils::narrow_cast<uint32_t>(scene.nodes.size() - 1);
+    for (const auto child : node.children) {
+      pending.push_back({child, index, std::nullopt});
+    }
+    if (!node.meshIndex) {
+      continue;
+    }
+
+    auto& slot = mesh_slots[*node.meshIndex];
+    const auto instances = load_instances(asset, decoded, node);
+    for (const auto& instance_node : instances) {
+      pending.push_back({node_idx, index, instance_nodes.size()});
+      instance_nodes.push_back(instance_node);
+    }
+    if (slot) {
+      if (instances.empty()) {
+        loaded[*slot].instances.push_back(index);
+      }
+      continue;
+    }
+
+    slot = loaded.size();
+    const auto& mesh = asset.meshes[*node.meshIndex];
+    auto& loaded_mesh = loaded.emplace_back(LoadedMesh{
+        .name = std::string_view{mesh.name},
+        .instances = {},
+        .vertices = {},
+        .indices = {},
+        .surfaces = {},
+        .first_vertices = {},
+        .meshlets = {},
+        .lods = {},
+        .missing_tangents = {},
+    });
+    for (const auto& primitive : mesh.primitives) {
+      TR_ASSERT(primitive.materialIndex, "material needed");
+      count_quantized_positions(asset, primitive, quantized_positions);
+
+      const auto material = utils::narrow_cast<uint32_t>(*primitive.materialIndex);
+      loaded_mesh.first_vertices.push_back(utils::narrow_cast<uint32_t>(loaded_mesh.vertices.size()));
+      auto name = primitive_name(mesh.name, loaded_mesh.surfaces.size());
+      loaded_mesh.surfaces.push_back(load_primitive(primitive, asset, decoded, loaded_mesh.indices,
+                                                    loaded_mesh.vertices, material, load_report, std::move(name)));
+      loaded_mesh.missing_tangents.push_back(
+          std::ranges::none_of(primitive.attributes, [](const auto& a) { return a.first == "TANGENT"; }) ? 1 : 0);
+    }
+    loaded_mesh.first_vertices.push_back(utils::narrow_cast<uint32_t>(loaded_mesh.vertices.size()));
+    if (instances.empty()) {
+      loaded_mesh.instances.push_back(index);
+    }
   }
 
-  // TODO: use an id rather than a pointer -> Allows to sort and more
-  std::vector<tr::renderer::Material> materials = load_materials(lifetime, ib, t, rm, asset);
-  return {
-      materials,
-      load_meshes(lifetime, bb, t, asset, materials),
+  std::size_t instance_count = 0;
+  for (const auto& mesh : loaded) {
+    instance_count += mesh.instances.size();
+  }
+  spdlog::info("Loaded {} meshes for {} instances", loaded.size(), instance_count);
+  if (quantized_positions.vertices != 0) {
+    spdlog::info("{} vertices have quantized positions, expanded to floats they take {:.1f} MiB more",
+                 quantized_positions.vertices, static_cast<double>(quantized_positions.expanded_bytes) / (1 << 20));
+  }
+
+  // Primitives own disjoint ranges of vertices and indices, they are optimized independently
+  std::vector<std::pair<std::size_t, std::size_t>> primitives;
+  for (std::size_t m = 0; m < loaded.size(); m++) {
+    for (std::size_t p = 0; p < loaded[m].surfaces.size(); p++) {
+      primitives.emplace_back(m, p);
+    }
+  }
+  std::vector<tr::mesh_opt::Report> reports(primitives.size());
+  std::vector<std::vector<tr::renderer::Meshlet>> primitive_meshlets(primitives.size());
+  std::vector<tr::mesh_opt::LodChain> lod_chains(primitives.size());
+  TIMED_INLINE_LAMBDA("Optimize meshes") {
+    pool.parallel_for(primitives.size(), [&](std::size_t i) {
+      auto& mesh = loaded[primitives[i].first];
+      const auto p = primitives[i].second;
+      const auto first_vertex = mesh.first_vertices[p];
+      const auto& surface = mesh.surfaces[p];
+
+      auto indices = std::span(mesh.indices).subspan(surface.start, surface.count);
+      for (auto& index : indices) {
+        index -= first_vertex;
+      }
+      const auto vertices =
+          std::span(mesh.vertices).subspan(first_vertex, mesh.first_vertices[p + 1] - first_vertex);
+      const auto name = primitive_name(mesh.name, p);
+      const auto bytes = vertices.size_bytes() + indices.size_bytes();
+      if (mesh.missing_tangents[p] != 0) {
+        const tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::Tangents, name, bytes};
+        tr::tangents::generate(indices, vertices);
+      }
+      {
+        const tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::Optimize, name, bytes};
+        reports[i] = tr::mesh_opt::optimize(indices, vertices);
+        primitive_meshlets[i] = tr::mesh_opt::build_meshlets(indices, vertices);
+        lod_chains[i] = tr::mesh_opt::build_lods(indices, vertices);
+      }
+      for (auto& index : indices) {
+        index += first_vertex;
+      }
+      for (auto& meshlet : primitive_meshlets[i]) {
+        meshlet.start += surface.start;
+      }
+    });
   };
+
+  // Summed in order so that the log does not depend on scheduling either
+  tr::mesh_opt::Report total;
+  for (const auto& report : reports) {
+    total.before += report.before;
+    total.after += report.after;
+  }
+  spdlog::info("Optimized {} primitives: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", primitives.size(),
+               total.before.acmr(), total.after.acmr(), total.before.atvr(), total.after.atvr());
+
+  std::size_t meshlet_count = 0;
+  std::size_t lod_count = 0;
+  for (std::size_t i = 0; i < primitives.size(); i++) {
+    const auto [m, p] = primitives[i];
+    auto& mesh = loaded[m];
+    auto& surface = mesh.surfaces[p];
+    surface.first_meshlet = utils::narrow_cast<uint32_t>(mesh.meshlets.size());
+    surface.meshlet_count = utils::narrow_cast<uint32_t>(primitive_meshlets[i].size());
+    mesh.meshlets.insert(mesh.meshlets.end(), primitive_meshlets[i].begin(), primitive_meshlets[i].end());
+    meshlet_count += primitive_meshlets[i].size();
+
+    // Levels go after the indices of every surface
+    const auto& chain = lod_chains[i];
+    const auto lod_start = utils::narrow_cast<uint32_t>(mesh.indices.size());
+    const auto first_vertex = mesh.first_vertices[p];
+    for (const auto index : chain.indices) {
+      mesh.indices.push_back(first_vertex + index);
+    }
+    surface.first_lod = utils::narrow_cast<uint32_t>(mesh.lods.size());
+    surface.lod_count = utils::narrow_cast<uint32_t>(chain.levels.size());
+    for (auto level : chain.levels) {
+      level.start += lod_start;
+      mesh.lods.push_back(level);
+    }
+    lod_count += chain.levels.size();
+  }
+  spdlog::info("Split them into {} meshlets, built {} levels of detail", meshlet_count, lod_count);
+
+  for (auto& mesh : loaded) {
+    // Everything that needs full precision (tangents, bounding boxes) is done by now
+    auto& positions = storage.positions.emplace_back();
+    auto& attributes = storage.attributes.emplace_back();
+    positions.reserve(mesh.vertices.size());
+    attributes.reserve(mesh.vertices.size());
+    for (const auto& vertex : mesh.vertices) {
+      positions.push_back({vertex.pos});
+      attributes.push_back(tr::renderer::PackedAttributes::pack(vertex));
+    }
+
+    scene.meshes.push_back({
+        .name = storage.names.emplace_back(mesh.name),
+        .instances = storage.instances.emplace_back(std::move(mesh.instances)),
+        .positions = positions,
+        .attributes = attributes,
+        .indices = storage.indices.emplace_back(std::move(mesh.indices)),
+        .surfaces = storage.surfaces.emplace_back(std::move(mesh.surfaces)),
+        .meshlets = storage.meshlets.emplace_back(std::move(mesh.meshlets)),
+        .lods = storage.lods.emplace_back(std::move(mesh.lods)),
+    });
+  }
+}
+
+// Only for the report, 0 when it can't be read
+auto file_size(const std::filesystem::path& path) -> std::size_t {
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(path, ec);
+  return ec ? 0 : size;
 }
 
-auto tr::Gltf::load_from_file(tr::renderer::Lifetime& lifetime, tr::renderer::ImageBuilder& ib,
-                              tr::renderer::BufferBuilder& bb, tr::renderer::Transferer& t,
-                              tr::renderer::RessourceManager& rm, std::string_view path)
-    -> std::pair<std::vector<tr::renderer::Material>, std::vector<tr::renderer::Mesh>> {
-  fastgltf::Parser parser;
+auto parse(utils::ThreadPool& pool, const std::filesystem::path& path, bool compress, tr::LoadReport& load_report)
+    -> tr::SceneData {
+  // Quantized attributes go through the same decoding as the float ones
+  fastgltf::Parser parser{fastgltf::Extensions::EXT_meshopt_compression | fastgltf::Extensions::KHR_mesh_quantization |
+                          fastgltf::Extensions::EXT_mesh_gpu_instancing};
   fastgltf::GltfDataBuffer data;
   fastgltf::Asset asset;
 
-  std::filesystem::path path_ = path;
-
-  TR_ASSERT(data.loadFromFile(path), "can't load file {}", path);
-
   {
+    const tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::Parse, path.filename().string(),
+                                      file_size(path)};
+    TR_ASSERT(data.loadFromFile(path), "can't load file {}", path.string());
     auto loaded = [&] {
       const auto options = fastgltf::Options::LoadGLBBuffers | fastgltf::Options::LoadExternalBuffers |
                            fastgltf::Options::LoadExternalImages;
 
       switch (fastgltf::determineGltfFileType(&data)) {
         case fastgltf::GltfType::glTF:
-          return parser.loadGLTF(&data, path_.parent_path(), options);
+          return parser.loadGLTF(&data, path.parent_path(), options);
         case fastgltf::GltfType::GLB:
-          return parser.loadBinaryGLTF(&data, path_.parent_path(), options);
+          return parser.loadBinaryGLTF(&data, path.parent_path(), options);
         case fastgltf::GltfType::Invalid:
           break;
       }
@@ -402,7 +1057,71 @@ auto tr::Gltf::load_from_file(tr::renderer::Lifetime& lifetime, tr::renderer::Im
                 fastgltf::getErrorMessage(err));
     }
   }
-  return load(lifetime, ib, bb, t, rm, asset);
+
+  {
+    const tr::LoadReport::Scope scope{load_report, tr::LoadReport::Phase::Validate, path.filename().string()};
+    const auto err = fastgltf::validate(asset);
+    TR_ASSERT(err == fastgltf::Error::None, "Invalid GLTF: {} {}", fastgltf::getErrorName(err),
+              fastgltf::getErrorMessage(err));
+  }
+
+  auto storage = std::make_shared<GltfStorage>();
+  tr::SceneData scene;
+  auto images = load_materials(pool, asset, *storage, scene, compress, load_report);
+  load_meshes(pool, asset, decode_meshopt_views(pool, asset, load_report), *storage, scene, load_report);
+  storage->cells = tr::SceneCells::build(pool, scene);
+  finish_images(images, *storage, scene);
+  scene.cells = storage->cells.cells;
+  scene.storage = std::move(storage);
+  return scene;
+}
+
+auto tr::Gltf::load_from_file(utils::ThreadPool& pool, std::string_view path, bool bake, bool block_compression,
+                              LoadReport& report) -> tr::SceneData {
+  const std::filesystem::path path_ = path;
+  const auto load_baked = [&](const std::filesystem::path& baked_path) {
+    const LoadReport::Scope scope{report, LoadReport::Phase::Parse, baked_path.filename().string(),
+                                  file_size(baked_path)};
+    return TrScene::load(baked_path);
+  };
+  const auto usable = [&](const SceneData& scene) {
+    return block_compression ||
+           std::ranges::none_of(scene.images, [](const SceneData::Image& image) { return is_bc(image.format); });
+  };
+
+  if (path_.extension() == TrScene::extension) {
+    auto baked = load_baked(path_);
+    TR_ASSERT(baked, "can't load baked scene {}", path);
+    TR_ASSERT(usable(*baked), "{} has BC textures, the device does not support them", path);
+    return std::move(*baked);
+  }
+
+  // A baked scene sitting next to the glTF is used instead of it, as long as it is not stale
+  auto baked_path = path_;
+  baked_path.replace_extension(TrScene::extension);
+  if (!bake && TrScene::is_up_to_date(baked_path, path_)) {
+    auto baked = load_baked(baked_path);
+    if (baked && usable(*baked)) {
+      spdlog::info("Loading baked scene {}", baked_path.string());
+      return std::move(*baked);
+    }
+    if (baked) {
+      spdlog::info("{} has BC textures, the device does not support them, loading from glTF", baked_path.string());
+    }
+  }
+  if (bake && !block_compression) {
+    spdlog::warn("The device does not support BC textures, the scene is not baked");
+    bake = false;
+  }
+
+  // Block compression is too slow to run on every load, it only happens when baking
+  auto parsed = TIMED_INLINE_LAMBDA("Parse glTF") { return parse(pool, path_, bake, report); };
+  // Only KTX2 images can be compressed then
+  TR_ASSERT(usable(parsed), "{} has BC textures, the device does not support them", path);
+  if (bake) {
+    TrScene::bake(baked_path, parsed);
+  }
+  return parsed;
 }
 
 template <>
@@ -1,24 +1,24 @@
 #pragma once
 
 #include <string_view>
-#include <utility>
-#include <vector>
+
+#include "scene_data.h"
+
+namespace utils {
+class ThreadPool;
+}  // namespace utils
 
 namespace tr {
-namespace renderer {
-class BufferBuilder;
-class ImageBuilder;
-class RessourceManager;
-struct Lifetime;
-struct Material;
-struct Mesh;
-struct Transferer;
-}  // namespace renderer
+class LoadReport;
 
 struct Gltf {
-  static auto load_from_file(renderer::Lifetime& lifetime, tr::renderer::ImageBuilder&, tr::renderer::BufferBuilder&,
-                             tr::renderer::Transferer&, tr::renderer::RessourceManager& rm, std::string_view path)
-      -> std::pair<std::vector<tr::renderer::Material>, std::vector<tr::renderer::Mesh>>;
+  // path is either a glTF or a .trscene, a fresh .trscene next to a glTF is picked instead of it
+  // bake (re)writes that .trscene from the glTF
+  // Without block_compression, when the device can't sample BC textures, the glTF is loaded rather than a .trscene
+  // next to it and nothing is baked
+  // CPU work only, it can run on any thread. Where the time goes is recorded in report
+  static auto load_from_file(utils::ThreadPool& pool, std::string_view path, bool bake, bool block_compression,
+                             LoadReport& report) -> SceneData;
 };
 
 }  // namespace tr
@@ -0,0 +1,105 @@
+#include "ktx2.h"
+
+#include <spdlog/spdlog.h>  // for warn
+
+#include <algorithm>  // for equal, max
+#include <array>      // for array
+#include <cstddef>    // for byte, size_t
+#include <cstdint>    // for uint32_t, uint64_t
+#include <cstring>    // for memcpy
+#include <optional>   // for optional, nullopt
+#include <span>       // for span
+
+#include "renderer/ressources.h"  // for FormatBlock
+#include "renderer/vkformat.h"    // IWYU pragma: keep
+
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+namespace {
+constexpr std::array<uint8_t, 12> identifier{0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct Header {
+  std::array<uint8_t, 12> identifier;
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+}  // namespace
+
+auto tr::Ktx2::is_ktx2(std::span<const std::byte> bytes) -> bool {
+  return bytes.size() >= identifier.size() &&
+         std::equal(identifier.begin(), identifier.end(), bytes.begin(),
+                    [](uint8_t a, std::byte b) { return a == std::to_integer<uint8_t>(b); });
+}
+
+auto tr::Ktx2::parse(std::span<const std::byte> bytes) -> std::optional<Ktx2> {
+  Header header{};
+  if (!is_ktx2(bytes) || bytes.size() < sizeof(Header)) {
+    spdlog::warn("not a KTX2 file");
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(Header));
+
+  const auto format = static_cast<VkFormat>(header.vk_format);
+  const auto block = renderer::FormatBlock::find(format);
+  if (!block) {
+    // VK_FORMAT_UNDEFINED is what Basis Universal textures use
+    spdlog::warn("KTX2 textures in {} are not supported", format);
+    return std::nullopt;
+  }
+  if (header.supercompression_scheme != 0) {
+    spdlog::warn("supercompressed KTX2 textures are not supported");
+    return std::nullopt;
+  }
+  if (header.pixel_height == 0 || header.pixel_depth != 0 || header.layer_count > 1 || header.face_count != 1) {
+    spdlog::warn("only 2D KTX2 textures are supported");
+    return std::nullopt;
+  }
+
+  // A level count of 0 asks for the mip chain to be generated at load time
+  const uint32_t level_count = std::max(header.level_count, 1U);
+  if (bytes.size() < sizeof(Header) + level_count * sizeof(LevelIndex)) {
+    spdlog::warn("truncated KTX2 file");
+    return std::nullopt;
+  }
+
+  Ktx2 ktx2{
+      .format = format,
+      .width = header.pixel_width,
+      .height = header.pixel_height,
+      .levels = {},
+  };
+  ktx2.levels.reserve(level_count);
+  for (uint32_t level = 0; level < level_count; level++) {
+    LevelIndex index{};
+    std::memcpy(&index, bytes.data() + sizeof(Header) + level * sizeof(LevelIndex), sizeof(LevelIndex));
+
+    const VkExtent2D extent{std::max(ktx2.width >> level, 1U), std::max(ktx2.height >> level, 1U)};
+    if (index.byte_offset + index.byte_length > bytes.size() || index.byte_length < block->size_bytes(extent)) {
+      spdlog::warn("level {} of the KTX2 file is out of bounds", level);
+      return std::nullopt;
+    }
+    ktx2.levels.push_back(bytes.subspan(index.byte_offset, index.byte_length));
+  }
+
+  return ktx2;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace tr {
+
+// View over a KTX2 container holding GPU ready texels
+// Only 2D textures without array layers, faces or supercompression are handled: nothing has to be transcoded
+struct Ktx2 {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  // levels[0] is the full resolution image, the spans point into the parsed bytes
+  std::vector<std::span<const std::byte>> levels;
+
+  static auto is_ktx2(std::span<const std::byte> bytes) -> bool;
+  // nullopt when the file is malformed or uses a feature that is not handled
+  static auto parse(std::span<const std::byte> bytes) -> std::optional<Ktx2>;
+};
+
+}  // namespace tr
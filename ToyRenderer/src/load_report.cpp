@@ -0,0 +1,165 @@
+#include "load_report.h"
+
+#include <json/value.h>     // for Value
+#include <json/writer.h>    // for StreamWriterBuilder, writeString
+#include <spdlog/spdlog.h>  // for info, error
+
+#include <algorithm>    // for sort, min
+#include <array>        // for array
+#include <cstddef>      // for size_t
+#include <filesystem>   // for path
+#include <fstream>      // for ofstream
+#include <map>          // for map
+#include <mutex>        // for lock_guard
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <utility>      // for move, pair
+#include <vector>       // for vector
+
+namespace {
+constexpr double mib = 1 << 20;
+// Assets listed in the log, the report has all of them
+constexpr std::size_t logged_assets = 10;
+
+struct PhaseTotal {
+  std::size_t count = 0;
+  float ms = 0.F;
+  std::size_t bytes = 0;
+  const tr::LoadReport::Entry* slowest = nullptr;
+
+  [[nodiscard]] auto mib_per_s() const -> double {
+    return ms > 0.F ? static_cast<double>(bytes) / mib / ms * 1000. : 0.;
+  }
+};
+
+auto phase_name(tr::LoadReport::Phase phase) -> std::string_view {
+  return tr::LoadReport::phase_names[static_cast<std::size_t>(phase)];
+}
+
+auto phase_totals(const std::vector<tr::LoadReport::Entry>& entries)
+    -> std::array<PhaseTotal, tr::LoadReport::phase_names.size()> {
+  std::array<PhaseTotal, tr::LoadReport::phase_names.size()> totals{};
+  for (const auto& entry : entries) {
+    auto& total = totals[static_cast<std::size_t>(entry.phase)];
+    total.count++;
+    total.ms += entry.ms;
+    total.bytes += entry.bytes;
+    if (total.slowest == nullptr || total.slowest->ms < entry.ms) {
+      total.slowest = &entry;
+    }
+  }
+  return totals;
+}
+
+// Every phase of an asset summed, slowest first. Transfers are per batch, they are left out
+auto asset_totals(const std::vector<tr::LoadReport::Entry>& entries) -> std::vector<std::pair<std::string, float>> {
+  std::map<std::string, float> per_asset;
+  for (const auto& entry : entries) {
+    if (entry.phase != tr::LoadReport::Phase::Transfer) {
+      per_asset[entry.asset] += entry.ms;
+    }
+  }
+  std::vector<std::pair<std::string, float>> sorted{per_asset.begin(), per_asset.end()};
+  std::ranges::sort(sorted, [](const auto& a, const auto& b) { return a.second > b.second; });
+  return sorted;
+}
+}  // namespace
+
+tr::LoadReport::Scope::Scope(LoadReport& report_, Phase phase_, std::string asset_, std::size_t bytes_)
+    : bytes(bytes_), report(&report_), phase(phase_), asset(std::move(asset_)) {
+  timer.start();
+}
+
+tr::LoadReport::Scope::~Scope() {
+  timer.stop();
+  report->record(phase, std::move(asset), timer.elapsed, bytes);
+}
+
+void tr::LoadReport::record(Phase phase, std::string asset, float ms, std::size_t bytes) {
+  const std::lock_guard lock{mutex};
+  entries.push_back({
+      .phase = phase,
+      .asset = std::move(asset),
+      .ms = ms,
+      .bytes = bytes,
+  });
+}
+
+void tr::LoadReport::record_copies(std::size_t requested, std::size_t commands, std::size_t regions) {
+  const std::lock_guard lock{mutex};
+  copies = {.requested = requested, .commands = commands, .regions = regions};
+}
+
+void tr::LoadReport::log_summary(float total_ms) const {
+  const std::lock_guard lock{mutex};
+  spdlog::info("Load report, {:.0f}ms in total, CPU time per phase:", total_ms);
+  spdlog::info("  {:<15} {:>6} {:>10} {:>9} {:>9}  {}", "phase", "count", "time (ms)", "MiB", "MiB/s", "slowest");
+  const auto totals = phase_totals(entries);
+  for (std::size_t i = 0; i < totals.size(); i++) {
+    const auto& total = totals[i];
+    if (total.count == 0) {
+      continue;
+    }
+    spdlog::info("  {:<15} {:>6} {:>10.1f} {:>9.1f} {:>9.1f}  {} ({:.1f}ms)", phase_names[i], total.count, total.ms,
+                 static_cast<double>(total.bytes) / mib, total.mib_per_s(), total.slowest->asset, total.slowest->ms);
+  }
+
+  spdlog::info("Copies: {} asked, recorded as {} commands of {} regions", copies.requested, copies.commands,
+               copies.regions);
+
+  const auto assets = asset_totals(entries);
+  spdlog::info("Slowest assets:");
+  for (std::size_t i = 0; i < std::min(assets.size(), logged_assets); i++) {
+    spdlog::info("  {:>10.1f}ms {}", assets[i].second, assets[i].first);
+  }
+}
+
+void tr::LoadReport::write_json(const std::filesystem::path& path, std::string_view scene, float total_ms) const {
+  const std::lock_guard lock{mutex};
+  Json::Value root;
+  root["scene"] = std::string{scene};
+  root["total_ms"] = total_ms;
+
+  auto& phases = root["phases"];
+  phases = Json::arrayValue;
+  const auto totals = phase_totals(entries);
+  for (std::size_t i = 0; i < totals.size(); i++) {
+    const auto& total = totals[i];
+    if (total.count == 0) {
+      continue;
+    }
+    Json::Value phase;
+    phase["phase"] = std::string{phase_names[i]};
+    phase["count"] = static_cast<Json::UInt64>(total.count);
+    phase["ms"] = total.ms;
+    phase["bytes"] = static_cast<Json::UInt64>(total.bytes);
+    phase["mib_per_s"] = total.mib_per_s();
+    phases.append(std::move(phase));
+  }
+
+  auto& copy_counts = root["copies"];
+  copy_counts["requested"] = static_cast<Json::UInt64>(copies.requested);
+  copy_counts["commands"] = static_cast<Json::UInt64>(copies.commands);
+  copy_counts["regions"] = static_cast<Json::UInt64>(copies.regions);
+
+  auto& assets = root["entries"];
+  assets = Json::arrayValue;
+  for (const auto& entry : entries) {
+    Json::Value asset;
+    asset["phase"] = std::string{phase_name(entry.phase)};
+    asset["asset"] = entry.asset;
+    asset["ms"] = entry.ms;
+    asset["bytes"] = static_cast<Json::UInt64>(entry.bytes);
+    assets.append(std::move(asset));
+  }
+
+  std::ofstream o(path);
+  if (!o.is_open()) {
+    spdlog::error("Can't open {} to write the load report", path.string());
+    return;
+  }
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["indentation"] = "  ";
+  o << Json::writeString(wbuilder, root);
+  spdlog::info("Load report written to {}", path.string());
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <utils/timer.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tr {
+
+// Where loading a scene spends its time, phase by phase and asset by asset
+// Entries can be recorded from any thread. Times are CPU times, a phase that runs on the pool adds up to more than it
+// lasts
+class LoadReport {
+ public:
+  enum class Phase : uint8_t {
+    Parse,
+    Validate,
+    DecodeMeshopt,
+    DecodeImage,
+    CompressImage,
+    Bounds,
+    Tangents,
+    Optimize,
+    Staging,
+    // From the submit until the frame that waits on it is done, per batch of assets
+    Transfer,
+  };
+  static constexpr std::array<std::string_view, 10> phase_names{
+      "parse",    "validate", "decode meshopt", "decode image", "compress image",
+      "bounds",   "tangents", "optimize",       "staging",      "transfer",
+  };
+  static_assert(phase_names.size() == static_cast<std::size_t>(Phase::Transfer) + 1);
+
+  struct Entry {
+    Phase phase;
+    std::string asset;
+    float ms;
+    std::size_t bytes;
+  };
+
+  // Records the time until it goes out of scope
+  class Scope {
+   public:
+    Scope(LoadReport& report, Phase phase, std::string asset, std::size_t bytes = 0);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope(Scope&&) = delete;
+    auto operator=(const Scope&) -> Scope& = delete;
+    auto operator=(Scope&&) -> Scope& = delete;
+
+    // For when they are only known at the end
+    std::size_t bytes;
+
+   private:
+    LoadReport* report;
+    Phase phase;
+    std::string asset;
+    utils::Timer timer;
+  };
+
+  void record(Phase phase, std::string asset, float ms, std::size_t bytes);
+  // Copies the uploads asked for, and the copy commands and regions they were merged into
+  void record_copies(std::size_t requested, std::size_t commands, std::size_t regions);
+
+  // total_ms is how long the whole load took, from the start to everything being on the GPU
+  void log_summary(float total_ms) const;
+  void write_json(const std::filesystem::path& path, std::string_view scene, float total_ms) const;
+
+ private:
+  mutable std::mutex mutex;
+  std::vector<Entry> entries;
+  struct Copies {
+    std::size_t requested = 0;
+    std::size_t commands = 0;
+    std::size_t regions = 0;
+  } copies;
+};
+
+}  // namespace tr
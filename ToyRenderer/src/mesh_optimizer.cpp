@@ -0,0 +1,371 @@
+#include "mesh_optimizer.h"
+
+#include <utils/assert.h>  // for TR_ASSERT
+
+#include <algorithm>          // for copy, stable_sort, max, min
+#include <cmath>              // for sqrt
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint32_t, int64_t
+#include <glm/common.hpp>     // for min, max
+#include <glm/geometric.hpp>  // for cross, dot, length, normalize
+#include <glm/vec3.hpp>       // for vec3
+#include <limits>             // for numeric_limits
+#include <optional>           // for optional, nullopt
+#include <span>               // for span
+#include <vector>             // for vector
+
+#include "renderer/mesh.h"  // for Vertex, Meshlet
+
+namespace {
+// FIFO cache simulated with timestamps: a vertex is still cached as long as less than cache_size vertices entered
+// the cache after it
+struct FifoCache {
+  std::vector<uint32_t> entered;
+  uint32_t cache_size;
+  uint32_t time;
+
+  FifoCache(std::size_t vertex_count, uint32_t cache_size_)
+      : entered(vertex_count, 0), cache_size(cache_size_), time(cache_size_ + 1) {}
+
+  [[nodiscard]] auto age(uint32_t v) const -> uint32_t { return time - entered[v]; }
+  [[nodiscard]] auto contains(uint32_t v) const -> bool { return age(v) <= cache_size; }
+
+  // true on a miss
+  auto touch(uint32_t v) -> bool {
+    if (contains(v)) {
+      return false;
+    }
+    entered[v] = time++;
+    return true;
+  }
+
+  void flush() { time += cache_size + 1; }
+};
+
+auto triangle_count(std::span<const uint32_t> indices) -> uint32_t {
+  return static_cast<uint32_t>(indices.size() / 3);
+}
+
+auto meshlet_bounds(std::span<const uint32_t> indices, std::span<const tr::renderer::Vertex> vertices, uint32_t start)
+    -> tr::renderer::Meshlet {
+  auto mmin = glm::vec3(std::numeric_limits<float>::infinity());
+  auto mmax = glm::vec3(-std::numeric_limits<float>::infinity());
+  for (const auto index : indices) {
+    mmin = glm::min(mmin, vertices[index].pos);
+    mmax = glm::max(mmax, vertices[index].pos);
+  }
+  const auto center = (mmin + mmax) / 2.F;
+  float radius = 0.F;
+  for (const auto index : indices) {
+    radius = std::max(radius, glm::length(vertices[index].pos - center));
+  }
+
+  // The axis is the average normal, the cone has to hold the normal furthest from it
+  std::vector<glm::vec3> normals;
+  normals.reserve(indices.size() / 3);
+  glm::vec3 axis{0.F};
+  for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const auto& p0 = vertices[indices[t]].pos;
+    const auto n = glm::cross(vertices[indices[t + 1]].pos - p0, vertices[indices[t + 2]].pos - p0);
+    if (glm::length(n) > 0.F) {
+      normals.push_back(glm::normalize(n));
+      axis += normals.back();
+    }
+  }
+
+  float cutoff = 1.F;
+  if (!normals.empty() && glm::length(axis) > 0.F) {
+    axis = glm::normalize(axis);
+    float min_dot = 1.F;
+    for (const auto& n : normals) {
+      min_dot = std::min(min_dot, glm::dot(n, axis));
+    }
+    // Past 90 degrees some triangle always faces the eye
+    if (min_dot > 0.F) {
+      cutoff = std::sqrt(1.F - min_dot * min_dot);
+    }
+  }
+
+  return {
+      .start = start,
+      .count = static_cast<uint32_t>(indices.size()),
+      .center = center,
+      .radius = radius,
+      .cone_axis = axis,
+      .cone_cutoff = cutoff,
+  };
+}
+}  // namespace
+
+auto tr::mesh_opt::analyze_cache(std::span<const uint32_t> indices, std::size_t vertex_count, uint32_t cache_size)
+    -> CacheStats {
+  CacheStats stats{.triangles = triangle_count(indices), .transformed = 0, .vertices = 0};
+  FifoCache cache{vertex_count, cache_size};
+  std::vector<bool> seen(vertex_count, false);
+  for (const auto index : indices) {
+    stats.transformed += cache.touch(index) ? 1 : 0;
+    if (!seen[index]) {
+      seen[index] = true;
+      stats.vertices++;
+    }
+  }
+  return stats;
+}
+
+auto tr::mesh_opt::optimize_vertex_cache(std::span<uint32_t> indices, std::size_t vertex_count, uint32_t cache_size)
+    -> std::vector<uint32_t> {
+  // Triangles using each vertex, live counts the ones not emitted yet
+  std::vector<uint32_t> live(vertex_count, 0);
+  for (const auto index : indices) {
+    live[index]++;
+  }
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (std::size_t v = 0; v < vertex_count; v++) {
+    offsets[v + 1] = offsets[v] + live[v];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); i++) {
+      adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  FifoCache cache{vertex_count, cache_size};
+  std::vector<bool> emitted(triangle_count(indices), false);
+  std::vector<uint32_t> dead_ends;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  std::vector<uint32_t> clusters;
+
+  std::size_t scan = 0;
+  const auto skip_dead_end = [&]() -> std::optional<uint32_t> {
+    while (!dead_ends.empty()) {
+      const auto d = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[d] > 0) {
+        return d;
+      }
+    }
+    for (; scan < vertex_count; scan++) {
+      if (live[scan] > 0) {
+        return static_cast<uint32_t>(scan);
+      }
+    }
+    return std::nullopt;
+  };
+
+  std::optional<uint32_t> fanning = skip_dead_end();
+  bool jumped = true;
+  while (fanning) {
+    if (jumped) {
+      clusters.push_back(triangle_count(output));
+    }
+
+    candidates.clear();
+    for (auto k = offsets[*fanning]; k < offsets[*fanning + 1]; k++) {
+      const auto t = adjacency[k];
+      if (emitted[t]) {
+        continue;
+      }
+      emitted[t] = true;
+      for (std::size_t c = 0; c < 3; c++) {
+        const auto v = indices[3 * t + c];
+        output.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        cache.touch(v);
+      }
+    }
+
+    // The oldest candidate that is still going to be in the cache once its own fan is emitted
+    fanning = std::nullopt;
+    int64_t best = -1;
+    for (const auto v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+      int64_t priority = 0;
+      if (int64_t{cache.age(v)} + 2 * int64_t{live[v]} <= cache_size) {
+        priority = cache.age(v);
+      }
+      if (priority > best) {
+        best = priority;
+        fanning = v;
+      }
+    }
+
+    jumped = !fanning;
+    if (jumped) {
+      fanning = skip_dead_end();
+    }
+  }
+
+  TR_ASSERT(output.size() == indices.size(), "tipsify lost triangles: {} indices out of {}", output.size(),
+            indices.size());
+  std::ranges::copy(output, indices.begin());
+  return clusters;
+}
+
+void tr::mesh_opt::optimize_overdraw(std::span<uint32_t> indices, std::span<const renderer::Vertex> vertices,
+                                     std::span<const uint32_t> clusters, uint32_t cache_size) {
+  const auto triangles = triangle_count(indices);
+  const auto cluster_end = [&](std::size_t i) { return i + 1 < clusters.size() ? clusters[i + 1] : triangles; };
+
+  // A cluster is cut as soon as it is as cache friendly as the whole primitive, the cache is flushed at each cut to
+  // account for the reordering that may follow
+  const double threshold = analyze_cache(indices, vertices.size(), cache_size).acmr();
+  std::vector<uint32_t> splits;
+  FifoCache cache{vertices.size(), cache_size};
+  for (std::size_t i = 0; i < clusters.size(); i++) {
+    splits.push_back(clusters[i]);
+    cache.flush();
+
+    std::size_t misses = 0;
+    std::size_t cluster_triangles = 0;
+    for (uint32_t t = clusters[i]; t < cluster_end(i); t++) {
+      for (std::size_t c = 0; c < 3; c++) {
+        misses += cache.touch(indices[3 * t + c]) ? 1 : 0;
+      }
+      cluster_triangles++;
+
+      if (t + 1 < cluster_end(i) && static_cast<double>(misses) <= threshold * static_cast<double>(cluster_triangles)) {
+        splits.push_back(t + 1);
+        cache.flush();
+        misses = 0;
+        cluster_triangles = 0;
+      }
+    }
+  }
+
+  struct Cluster {
+    uint32_t begin;
+    uint32_t end;
+    glm::vec3 center;
+    glm::vec3 normal;
+    float area;
+    float sort_key;
+  };
+  std::vector<Cluster> sorted;
+  sorted.reserve(splits.size());
+  glm::vec3 mesh_center{0.F};
+  float mesh_area = 0.F;
+  for (std::size_t i = 0; i < splits.size(); i++) {
+    Cluster cluster{
+        .begin = splits[i],
+        .end = i + 1 < splits.size() ? splits[i + 1] : triangles,
+        .center = glm::vec3{0.F},
+        .normal = glm::vec3{0.F},
+        .area = 0.F,
+        .sort_key = 0.F,
+    };
+    // Area weighted, the cross product is twice the area of the triangle
+    for (uint32_t t = cluster.begin; t < cluster.end; t++) {
+      const auto& p0 = vertices[indices[3 * t]].pos;
+      const auto& p1 = vertices[indices[3 * t + 1]].pos;
+      const auto& p2 = vertices[indices[3 * t + 2]].pos;
+      const auto n = glm::cross(p1 - p0, p2 - p0);
+      const auto area = glm::length(n);
+
+      cluster.center += area * (p0 + p1 + p2) / 3.F;
+      cluster.normal += n;
+      cluster.area += area;
+    }
+    mesh_center += cluster.center;
+    mesh_area += cluster.area;
+    sorted.push_back(cluster);
+  }
+  if (mesh_area > 0.F) {
+    mesh_center /= mesh_area;
+  }
+
+  for (auto& cluster : sorted) {
+    if (cluster.area > 0.F && glm::length(cluster.normal) > 0.F) {
+      cluster.sort_key = glm::dot(cluster.center / cluster.area - mesh_center, glm::normalize(cluster.normal));
+    }
+  }
+  // stable, so ties keep the cache order
+  std::ranges::stable_sort(sorted, [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const auto& cluster : sorted) {
+    output.insert(output.end(), indices.begin() + 3 * cluster.begin, indices.begin() + 3 * cluster.end);
+  }
+  std::ranges::copy(output, indices.begin());
+}
+
+void tr::mesh_opt::optimize_vertex_fetch(std::span<uint32_t> indices, std::span<renderer::Vertex> vertices) {
+  constexpr auto unused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertices.size(), unused);
+
+  uint32_t next = 0;
+  for (auto& index : indices) {
+    if (remap[index] == unused) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+  for (auto& r : remap) {
+    if (r == unused) {
+      r = next++;
+    }
+  }
+
+  std::vector<renderer::Vertex> reordered(vertices.size());
+  for (std::size_t v = 0; v < vertices.size(); v++) {
+    reordered[remap[v]] = vertices[v];
+  }
+  std::ranges::copy(reordered, vertices.begin());
+}
+
+auto tr::mesh_opt::build_meshlets(std::span<const uint32_t> indices, std::span<const renderer::Vertex> vertices)
+    -> std::vector<renderer::Meshlet> {
+  std::vector<renderer::Meshlet> meshlets;
+  // Id of the last meshlet each vertex went in, ids start at 1
+  std::vector<uint32_t> owner(vertices.size(), 0);
+  uint32_t id = 1;
+  std::size_t begin = 0;
+  std::size_t vertex_count = 0;
+
+  for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const auto new_vertices = [&] {
+      std::size_t count = 0;
+      for (std::size_t c = 0; c < 3; c++) {
+        // The same vertex may appear twice in degenerate triangles
+        const bool seen_before = (c > 0 && indices[t + c] == indices[t]) || (c > 1 && indices[t + c] == indices[t + 1]);
+        count += owner[indices[t + c]] != id && !seen_before ? 1 : 0;
+      }
+      return count;
+    };
+
+    if (vertex_count + new_vertices() > meshlet_max_vertices || (t - begin) / 3 == meshlet_max_triangles) {
+      meshlets.push_back(meshlet_bounds(indices.subspan(begin, t - begin), vertices, static_cast<uint32_t>(begin)));
+      begin = t;
+      vertex_count = 0;
+      id++;
+    }
+
+    vertex_count += new_vertices();
+    for (std::size_t c = 0; c < 3; c++) {
+      owner[indices[t + c]] = id;
+    }
+  }
+  if (begin < indices.size()) {
+    meshlets.push_back(meshlet_bounds(indices.subspan(begin), vertices, static_cast<uint32_t>(begin)));
+  }
+  return meshlets;
+}
+
+auto tr::mesh_opt::optimize(std::span<uint32_t> indices, std::span<renderer::Vertex> vertices) -> Report {
+  TR_ASSERT(indices.size() % 3 == 0, "only triangle lists can be optimized");
+
+  Report report{.before = analyze_cache(indices, vertices.size()), .after = {}};
+  const auto clusters = optimize_vertex_cache(indices, vertices.size());
+  optimize_overdraw(indices, vertices, clusters);
+  optimize_vertex_fetch(indices, vertices);
+  report.after = analyze_cache(indices, vertices.size());
+  return report;
+}
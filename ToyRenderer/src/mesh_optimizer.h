@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "renderer/mesh.h"
+
+// Triangle list reordering, run once at import time
+// Everything here is deterministic: the same input always gives the same output
+namespace tr::mesh_opt {
+
+// Typical size of a post-transform vertex cache, in vertices
+constexpr uint32_t default_cache_size = 16;
+
+// How well an index buffer uses a FIFO post-transform cache
+struct CacheStats {
+  std::size_t triangles = 0;
+  // Vertex shader invocations
+  std::size_t transformed = 0;
+  // Vertices referenced by at least one triangle
+  std::size_t vertices = 0;
+
+  // Average cache miss ratio: transformed vertices per triangle, 0.5 is the best a regular grid gets, 3 the worst
+  [[nodiscard]] auto acmr() const -> double {
+    return triangles == 0 ? 0. : static_cast<double>(transformed) / static_cast<double>(triangles);
+  }
+  // Average transform to vertex ratio: 1 means every vertex is transformed once
+  [[nodiscard]] auto atvr() const -> double {
+    return vertices == 0 ? 0. : static_cast<double>(transformed) / static_cast<double>(vertices);
+  }
+
+  auto operator+=(const CacheStats& other) -> CacheStats& {
+    triangles += other.triangles;
+    transformed += other.transformed;
+    vertices += other.vertices;
+    return *this;
+  }
+};
+
+auto analyze_cache(std::span<const uint32_t> indices, std::size_t vertex_count,
+                   uint32_t cache_size = default_cache_size) -> CacheStats;
+
+// Tipsify (Sander et al. 2007), reorders triangles in place
+// Returns the index of the first triangle of each cluster, clusters are cut wherever the walk has to jump
+auto optimize_vertex_cache(std::span<uint32_t> indices, std::size_t vertex_count,
+                           uint32_t cache_size = default_cache_size) -> std::vector<uint32_t>;
+
+// Splits the clusters further then draws the ones facing away from the center of the mesh first, they are the most
+// likely to occlude the others. Triangles are only moved cluster by cluster so the cache order mostly survives
+void optimize_overdraw(std::span<uint32_t> indices, std::span<const renderer::Vertex> vertices,
+                       std::span<const uint32_t> clusters, uint32_t cache_size = default_cache_size);
+
+// Orders vertices by first use so fetches walk memory linearly, unused vertices end up last
+void optimize_vertex_fetch(std::span<uint32_t> indices, std::span<renderer::Vertex> vertices);
+
+constexpr std::size_t meshlet_max_vertices = 64;
+constexpr std::size_t meshlet_max_triangles = 124;
+
+// Cuts the triangles into meshlets in their current order, which the passes above make spatially coherent
+// Indices are relative to vertices, so are the starts of the meshlets
+auto build_meshlets(std::span<const uint32_t> indices, std::span<const renderer::Vertex> vertices)
+    -> std::vector<renderer::Meshlet>;
+
+struct Report {
+  CacheStats before;
+  CacheStats after;
+};
+
+// All of the above, indices are relative to vertices
+auto optimize(std::span<uint32_t> indices, std::span<renderer::Vertex> vertices) -> Report;
+
+}  // namespace tr::mesh_opt
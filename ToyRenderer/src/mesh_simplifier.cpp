@@ -0,0 +1,301 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>          // for sort, unique, find, equal_range, fill, max
+#include <array>              // for array
+#include <cmath>              // for sqrt
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint32_t
+#include <glm/geometric.hpp>  // for cross, dot, length
+#include <glm/vec3.hpp>       // for vec3
+#include <numeric>            // for iota
+#include <span>               // for span
+#include <tuple>              // for tie
+#include <utility>            // for pair, move
+#include <vector>             // for vector
+
+#include "mesh_optimizer.h"  // for optimize_vertex_cache
+#include "renderer/mesh.h"   // for Vertex, SurfaceLod
+
+namespace {
+using tr::renderer::Vertex;
+
+// Levels smaller than that are not worth a draw of their own
+constexpr std::size_t min_lod_triangles = 32;
+
+// Sum of the squared distances to a set of planes, weighted by the area of the triangles they come from
+struct Quadric {
+  // Upper half of the symmetric 4x4 matrix: aa ab ac ad bb bc bd cc cd dd
+  std::array<double, 10> m{};
+  double weight = 0.;
+
+  static auto from_triangle(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2) -> Quadric {
+    const auto n = glm::cross(p1 - p0, p2 - p0);
+    const double length = glm::length(n);
+    if (length == 0.) {
+      return {};
+    }
+    const double a = n.x / length;
+    const double b = n.y / length;
+    const double c = n.z / length;
+    const double d = -(a * p0.x + b * p0.y + c * p0.z);
+    const double w = length / 2.;
+    return {
+        .m = {w * a * a, w * a * b, w * a * c, w * a * d, w * b * b, w * b * c, w * b * d, w * c * c, w * c * d,
+              w * d * d},
+        .weight = w,
+    };
+  }
+
+  auto operator+=(const Quadric& other) -> Quadric& {
+    for (std::size_t i = 0; i < m.size(); i++) {
+      m[i] += other.m[i];
+    }
+    weight += other.weight;
+    return *this;
+  }
+
+  // Mean squared distance of p to the planes
+  [[nodiscard]] auto error(glm::vec3 p) const -> double {
+    if (weight == 0.) {
+      return 0.;
+    }
+    const double x = p.x;
+    const double y = p.y;
+    const double z = p.z;
+    const double e = m[0] * x * x + 2. * m[1] * x * y + 2. * m[2] * x * z + 2. * m[3] * x + m[4] * y * y +
+                     2. * m[5] * y * z + 2. * m[6] * y + m[7] * z * z + 2. * m[8] * z + m[9];
+    // Rounding can make it slightly negative
+    return std::max(e, 0.) / weight;
+  }
+};
+
+// Vertices sharing their position with another one are on a seam, the ones on an edge that does not have exactly one
+// triangle on each side are on a border
+auto locked_vertices(std::span<const uint32_t> indices, std::span<const Vertex> vertices) -> std::vector<bool> {
+  std::vector<uint32_t> order(vertices.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order, [&](uint32_t a, uint32_t b) {
+    const auto& pa = vertices[a].pos;
+    const auto& pb = vertices[b].pos;
+    return std::tie(pa.x, pa.y, pa.z, a) < std::tie(pb.x, pb.y, pb.z, b);
+  });
+
+  // Every vertex is identified by the first vertex at its position
+  std::vector<uint32_t> position(vertices.size());
+  std::vector<bool> locked(vertices.size(), false);
+  for (std::size_t i = 0; i < order.size(); i++) {
+    if (i > 0 && vertices[order[i]].pos == vertices[order[i - 1]].pos) {
+      position[order[i]] = position[order[i - 1]];
+      locked[order[i]] = true;
+      locked[order[i - 1]] = true;
+    } else {
+      position[order[i]] = order[i];
+    }
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  edges.reserve(indices.size());
+  for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+    for (std::size_t c = 0; c < 3; c++) {
+      const auto a = position[indices[t + c]];
+      const auto b = position[indices[t + (c + 1) % 3]];
+      if (a != b) {
+        edges.emplace_back(a, b);
+      }
+    }
+  }
+  std::ranges::sort(edges);
+
+  std::vector<bool> locked_position(vertices.size(), false);
+  for (auto it = edges.begin(); it != edges.end();) {
+    const auto [a, b] = *it;
+    const auto same = std::ranges::equal_range(it, edges.end(), *it);
+    const auto opposite = std::ranges::equal_range(edges, std::pair{b, a});
+    if (same.size() != 1 || opposite.size() != 1) {
+      locked_position[a] = true;
+      locked_position[b] = true;
+    }
+    it = same.end();
+  }
+
+  for (std::size_t v = 0; v < vertices.size(); v++) {
+    locked[v] = locked[v] || locked_position[position[v]];
+  }
+  return locked;
+}
+
+// Whether moving from onto to turns one of the triangles around from over
+auto flips(std::span<const uint32_t> indices, std::span<const uint32_t> around, std::span<const Vertex> vertices,
+           uint32_t from, uint32_t to) -> bool {
+  for (const auto triangle : around) {
+    const auto corners = indices.subspan(std::size_t{triangle} * 3, 3);
+    if (std::ranges::find(corners, to) != corners.end()) {
+      // Goes away with the collapse
+      continue;
+    }
+
+    std::array<glm::vec3, 3> before{};
+    std::array<glm::vec3, 3> after{};
+    for (std::size_t c = 0; c < 3; c++) {
+      before[c] = vertices[corners[c]].pos;
+      after[c] = corners[c] == from ? vertices[to].pos : before[c];
+    }
+    const auto n_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+    const auto n_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+    if (glm::dot(n_before, n_after) < 0.25F * glm::length(n_before) * glm::length(n_after)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+auto tr::mesh_opt::simplify(std::span<const uint32_t> indices, std::span<const renderer::Vertex> vertices,
+                            std::size_t target_index_count) -> Simplified {
+  const auto locked = locked_vertices(indices, vertices);
+
+  std::vector<Quadric> quadrics(vertices.size());
+  for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const auto q =
+        Quadric::from_triangle(vertices[indices[t]].pos, vertices[indices[t + 1]].pos, vertices[indices[t + 2]].pos);
+    for (std::size_t c = 0; c < 3; c++) {
+      quadrics[indices[t + c]] += q;
+    }
+  }
+
+  struct Candidate {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+  };
+  std::vector<Candidate> candidates;
+  std::vector<uint32_t> first_triangle(vertices.size() + 1);
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> collapse(vertices.size());
+  std::vector<bool> touched(vertices.size());
+
+  std::vector<uint32_t> current(indices.begin(), indices.end());
+  double max_error = 0.;
+  // Each pass collapses a set of edges far enough from each other for their costs to stay exact
+  while (current.size() > target_index_count) {
+    // Triangles around each vertex
+    std::ranges::fill(first_triangle, 0);
+    for (const auto index : current) {
+      first_triangle[index + 1]++;
+    }
+    for (std::size_t v = 0; v < vertices.size(); v++) {
+      first_triangle[v + 1] += first_triangle[v];
+    }
+    triangles.resize(current.size());
+    auto cursor = first_triangle;
+    for (std::size_t i = 0; i < current.size(); i++) {
+      triangles[cursor[current[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+    const auto around = [&](uint32_t v) {
+      return std::span(triangles).subspan(first_triangle[v], first_triangle[v + 1] - first_triangle[v]);
+    };
+
+    candidates.clear();
+    for (std::size_t t = 0; t < current.size(); t += 3) {
+      for (std::size_t c = 0; c < 3; c++) {
+        const auto a = current[t + c];
+        const auto b = current[t + (c + 1) % 3];
+        if (!locked[a]) {
+          candidates.push_back({0., a, b});
+        }
+        if (!locked[b]) {
+          candidates.push_back({0., b, a});
+        }
+      }
+    }
+    const auto by_edge = [](const Candidate& c) { return std::pair{c.from, c.to}; };
+    std::ranges::sort(candidates, {}, by_edge);
+    const auto duplicates = std::ranges::unique(candidates, {}, by_edge);
+    candidates.erase(duplicates.begin(), duplicates.end());
+
+    for (auto& candidate : candidates) {
+      auto q = quadrics[candidate.from];
+      q += quadrics[candidate.to];
+      candidate.cost = q.error(vertices[candidate.to].pos);
+    }
+    std::ranges::sort(candidates, [](const Candidate& a, const Candidate& b) {
+      return std::tie(a.cost, a.from, a.to) < std::tie(b.cost, b.from, b.to);
+    });
+
+    std::iota(collapse.begin(), collapse.end(), 0);
+    touched.assign(vertices.size(), false);
+    const auto wanted = (current.size() - target_index_count + 2) / 3;
+    std::size_t removed = 0;
+    for (const auto& [cost, from, to] : candidates) {
+      if (removed >= wanted) {
+        break;
+      }
+      if (touched[from] || touched[to] || flips(current, around(from), vertices, from, to)) {
+        continue;
+      }
+
+      collapse[from] = to;
+      quadrics[to] += quadrics[from];
+      max_error = std::max(max_error, cost);
+      for (const auto triangle : around(from)) {
+        const auto corners = std::span(current).subspan(std::size_t{triangle} * 3, 3);
+        removed += std::ranges::find(corners, to) != corners.end() ? 1 : 0;
+        for (const auto corner : corners) {
+          touched[corner] = true;
+        }
+      }
+    }
+    if (removed == 0) {
+      break;
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t t = 0; t < current.size(); t += 3) {
+      const auto a = collapse[current[t]];
+      const auto b = collapse[current[t + 1]];
+      const auto c = collapse[current[t + 2]];
+      if (a != b && b != c && a != c) {
+        current[kept++] = a;
+        current[kept++] = b;
+        current[kept++] = c;
+      }
+    }
+    current.resize(kept);
+  }
+
+  return {
+      .indices = std::move(current),
+      .error = static_cast<float>(std::sqrt(max_error)),
+  };
+}
+
+auto tr::mesh_opt::build_lods(std::span<const uint32_t> indices, std::span<const renderer::Vertex> vertices)
+    -> LodChain {
+  LodChain chain;
+  std::size_t previous = indices.size();
+  float error = 0.F;
+  for (std::size_t level = 1; level <= max_lod_levels; level++) {
+    const auto target = (indices.size() >> level) / 3 * 3;
+    if (target < min_lod_triangles * 3) {
+      break;
+    }
+
+    // Always from the full surface so that the error is measured against it
+    auto simplified = simplify(indices, vertices, target);
+    // Most of what is left is locked, the next levels would be the same
+    if (simplified.indices.size() * 5 > previous * 4) {
+      break;
+    }
+    optimize_vertex_cache(simplified.indices, vertices.size());
+
+    error = std::max(error, simplified.error);
+    chain.levels.push_back({
+        .start = static_cast<uint32_t>(chain.indices.size()),
+        .count = static_cast<uint32_t>(simplified.indices.size()),
+        .error = error,
+    });
+    chain.indices.insert(chain.indices.end(), simplified.indices.begin(), simplified.indices.end());
+    previous = simplified.indices.size();
+  }
+  return chain;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "renderer/mesh.h"
+
+namespace tr::mesh_opt {
+
+// Levels of detail built for each surface, the surface itself not included
+constexpr std::size_t max_lod_levels = 4;
+
+struct Simplified {
+  std::vector<uint32_t> indices;
+  // Root of the worst area weighted mean squared distance a collapse moved the surface by, in position units
+  float error;
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert 1997), stops once at most target_index_count indices are
+// left or nothing can collapse anymore
+// Edges collapse onto one of their ends so the vertices are reused as is. Vertices on a border or on an attribute
+// seam never go away, which keeps the outline and the texture charts in place
+auto simplify(std::span<const uint32_t> indices, std::span<const renderer::Vertex> vertices,
+              std::size_t target_index_count) -> Simplified;
+
+struct LodChain {
+  // Every level one after the other, level starts are relative to it
+  std::vector<uint32_t> indices;
+  std::vector<renderer::SurfaceLod> levels;
+};
+
+// Halves the triangle count from one level to the next, until it does not pay off anymore
+// indices are relative to vertices, so are the ones of the levels
+auto build_lods(std::span<const uint32_t> indices, std::span<const renderer::Vertex> vertices) -> LodChain;
+
+}  // namespace tr::mesh_opt
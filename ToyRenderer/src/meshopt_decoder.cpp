@@ -0,0 +1,357 @@
+#include "meshopt_decoder.h"
+
+#include <algorithm>  // for min, max, fill
+#include <array>      // for array
+#include <cmath>      // for abs, sqrt, ldexp
+#include <cstddef>    // for size_t, byte
+#include <cstdint>    // for uint8_t, uint32_t, int16_t, int8_t
+#include <cstring>    // for memcpy
+#include <limits>     // for numeric_limits
+#include <span>       // for span
+
+namespace {
+constexpr uint8_t vertex_header = 0xA0;
+constexpr uint8_t index_header = 0xE0;
+constexpr uint8_t sequence_header = 0xD0;
+
+// Vertex bytes are delta encoded per byte position in groups of 16, blocks of up to 256 vertices fit in 8 KiB
+constexpr std::size_t byte_group_size = 16;
+constexpr std::size_t vertex_block_bytes = 8192;
+constexpr std::size_t vertex_block_max_size = 256;
+constexpr std::size_t max_stride = 256;
+// The first vertex is stored at the very end, padded up to that
+constexpr std::size_t tail_min_size = 32;
+
+struct Cursor {
+  std::span<const uint8_t> data;
+  std::size_t offset;
+
+  [[nodiscard]] auto remaining() const -> std::size_t { return data.size() - offset; }
+  auto next() -> uint8_t { return data[offset++]; }
+};
+
+auto as_u8(std::span<const std::byte> bytes) -> std::span<const uint8_t> {
+  return {reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size()};
+}
+
+// 16 bytes stored on 0, 2, 4 or 8 bits each, the largest value of 2 and 4 bits means the byte follows as is
+auto decode_group(Cursor& in, std::span<uint8_t, byte_group_size> out, uint32_t bits_log2) -> bool {
+  switch (bits_log2) {
+    case 0:
+      std::ranges::fill(out, 0);
+      return true;
+    case 3:
+      if (in.remaining() < byte_group_size) {
+        return false;
+      }
+      std::memcpy(out.data(), in.data.data() + in.offset, byte_group_size);
+      in.offset += byte_group_size;
+      return true;
+    default:
+      break;
+  }
+
+  const std::size_t bits = std::size_t{1} << bits_log2;
+  const std::size_t packed = byte_group_size * bits / 8;
+  if (in.remaining() < packed) {
+    return false;
+  }
+  const auto escape = static_cast<uint8_t>((1U << bits) - 1);
+  auto escaped = in.offset + packed;
+  // Most significant bits first
+  for (std::size_t i = 0; i < byte_group_size; i++) {
+    const auto byte = in.data[in.offset + i * bits / 8];
+    const auto value = static_cast<uint8_t>((byte >> (8 - bits - (i * bits) % 8)) & escape);
+    if (value != escape) {
+      out[i] = value;
+    } else if (escaped < in.data.size()) {
+      out[i] = in.data[escaped++];
+    } else {
+      return false;
+    }
+  }
+  in.offset = escaped;
+  return true;
+}
+
+// out.size() is a multiple of 16, the 2 bits of each group size come first
+auto decode_bytes(Cursor& in, std::span<uint8_t> out) -> bool {
+  const auto group_count = out.size() / byte_group_size;
+  const auto header_size = (group_count + 3) / 4;
+  if (in.remaining() < header_size) {
+    return false;
+  }
+  const auto header = in.data.subspan(in.offset, header_size);
+  in.offset += header_size;
+  for (std::size_t g = 0; g < group_count; g++) {
+    const auto bits_log2 = (header[g / 4] >> ((g % 4) * 2)) & 3U;
+    if (!decode_group(in, out.subspan(g * byte_group_size).first<byte_group_size>(), bits_log2)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto read_vbyte(Cursor& in) -> uint32_t {
+  uint32_t result = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7) {
+    const auto group = in.next();
+    result |= (group & 127U) << shift;
+    if (group < 128) {
+      break;
+    }
+  }
+  return result;
+}
+
+auto unzigzag(uint32_t v) -> uint32_t { return (v >> 1) ^ (0U - (v & 1)); }
+
+void write_index(std::span<std::byte> out, std::size_t i, std::size_t index_size, uint32_t index) {
+  if (index_size == 2) {
+    const auto narrow = static_cast<uint16_t>(index);
+    std::memcpy(out.data() + i * 2, &narrow, 2);
+  } else {
+    std::memcpy(out.data() + i * 4, &index, 4);
+  }
+}
+
+auto round_to_int(float f) -> int { return static_cast<int>(f + (f >= 0.F ? 0.5F : -0.5F)); }
+
+template <class T>
+void octahedral(std::span<std::byte> data, std::size_t count) {
+  const auto max = static_cast<float>(std::numeric_limits<T>::max());
+  for (std::size_t i = 0; i < count; i++) {
+    std::array<T, 4> v{};
+    std::memcpy(v.data(), data.data() + i * sizeof(v), sizeof(v));
+
+    auto x = static_cast<float>(v[0]);
+    auto y = static_cast<float>(v[1]);
+    // z holds what 1 encodes to
+    const auto z = static_cast<float>(v[2]) - std::abs(x) - std::abs(y);
+    // Folded back for the lower hemisphere
+    const auto t = std::min(z, 0.F);
+    x += x >= 0.F ? t : -t;
+    y += y >= 0.F ? t : -t;
+
+    const auto s = max / std::sqrt(x * x + y * y + z * z);
+    v[0] = static_cast<T>(round_to_int(x * s));
+    v[1] = static_cast<T>(round_to_int(y * s));
+    v[2] = static_cast<T>(round_to_int(z * s));
+    std::memcpy(data.data() + i * sizeof(v), v.data(), sizeof(v));
+  }
+}
+}  // namespace
+
+auto tr::meshopt::decode_vertex_buffer(std::span<std::byte> out, std::size_t count, std::size_t stride,
+                                       std::span<const std::byte> in_bytes) -> bool {
+  if (stride == 0 || stride > max_stride || stride % 4 != 0 || out.size() < count * stride) {
+    return false;
+  }
+  const auto data = as_u8(in_bytes);
+  const auto tail_size = std::max(stride, tail_min_size);
+  if (data.size() < 1 + tail_size || data[0] != vertex_header) {
+    return false;
+  }
+  // Blocks end where the tail starts
+  Cursor in{data.first(data.size() - tail_size), 1};
+
+  std::array<uint8_t, max_stride> last{};
+  std::memcpy(last.data(), data.data() + data.size() - stride, stride);
+
+  const auto block_size = std::min((vertex_block_bytes / stride) & ~(byte_group_size - 1), vertex_block_max_size);
+  std::array<uint8_t, vertex_block_max_size> deltas{};
+  auto* dst = reinterpret_cast<uint8_t*>(out.data());
+  for (std::size_t first = 0; first < count; first += block_size) {
+    const auto size = std::min(block_size, count - first);
+    const auto aligned = (size + byte_group_size - 1) & ~(byte_group_size - 1);
+    for (std::size_t k = 0; k < stride; k++) {
+      if (!decode_bytes(in, std::span(deltas).first(aligned))) {
+        return false;
+      }
+      auto value = last[k];
+      for (std::size_t i = 0; i < size; i++) {
+        value = static_cast<uint8_t>(value + unzigzag(deltas[i]));
+        dst[(first + i) * stride + k] = value;
+      }
+      last[k] = value;
+    }
+  }
+  return in.remaining() == 0;
+}
+
+auto tr::meshopt::decode_index_buffer(std::span<std::byte> out, std::size_t count, std::size_t index_size,
+                                      std::span<const std::byte> in_bytes) -> bool {
+  if (count % 3 != 0 || (index_size != 2 && index_size != 4) || out.size() < count * index_size) {
+    return false;
+  }
+  // A code per triangle, the data then a table of the 16 most common aux codes
+  const auto data = as_u8(in_bytes);
+  if (data.size() < 1 + count / 3 + 16 || (data[0] & 0xF0) != index_header || (data[0] & 0x0F) > 1) {
+    return false;
+  }
+  const auto version = data[0] & 0x0F;
+  const auto codes = data.subspan(1, count / 3);
+  const auto aux_table = data.last(16);
+  // A triangle reads at most 16 bytes of data, the table leaves room for it
+  const auto data_end = data.size() - 16;
+  Cursor in{data, 1 + count / 3};
+
+  // Recent edges and vertices, read back from the newest
+  std::array<std::array<uint32_t, 2>, 16> edges{};
+  std::array<uint32_t, 16> vertices{};
+  std::ranges::fill(edges, std::array{~0U, ~0U});
+  std::ranges::fill(vertices, ~0U);
+  std::size_t edge_offset = 0;
+  std::size_t vertex_offset = 0;
+  const auto push_edge = [&](uint32_t a, uint32_t b) {
+    edges[edge_offset] = {a, b};
+    edge_offset = (edge_offset + 1) & 15;
+  };
+  const auto push_vertex = [&](uint32_t v, bool advance) {
+    vertices[vertex_offset] = v;
+    vertex_offset = (vertex_offset + (advance ? 1 : 0)) & 15;
+  };
+
+  // Next new vertex and last explicitly encoded index, those are delta encoded
+  uint32_t next = 0;
+  uint32_t last = 0;
+  const auto decode_index = [&] {
+    last += unzigzag(read_vbyte(in));
+    return last;
+  };
+  const uint32_t fec_max = version >= 1 ? 13 : 15;
+
+  for (std::size_t i = 0; i < count; i += 3) {
+    if (in.offset > data_end) {
+      return false;
+    }
+    const auto code = codes[i / 3];
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t c = 0;
+    if (code < 0xF0) {
+      // An edge from the fifo and a third vertex: new, from the fifo or explicit
+      const auto& edge = edges[(edge_offset - 1 - (code >> 4)) & 15];
+      a = edge[0];
+      b = edge[1];
+      const uint32_t fec = code & 15U;
+      if (fec < fec_max) {
+        c = fec == 0 ? next++ : vertices[(vertex_offset - 1 - fec) & 15];
+        push_vertex(c, fec == 0);
+      } else {
+        // 13 and 14 are the last explicit index minus and plus one
+        if (fec == 15) {
+          c = decode_index();
+        } else {
+          last += fec == 13 ? ~0U : 1U;
+          c = last;
+        }
+        push_vertex(c, true);
+      }
+      push_edge(c, b);
+      push_edge(a, c);
+    } else {
+      // Three vertices, each new, from the fifo or explicit. next moves for all of them before any explicit one
+      const auto aux = code < 0xFE ? aux_table[code & 15U] : in.next();
+      const uint32_t feb = aux >> 4U;
+      const uint32_t fec = aux & 15U;
+      const bool fea_explicit = code == 0xFF;
+      // An aux byte of 0 that is not from the table restarts the new vertices
+      if (code >= 0xFE && aux == 0) {
+        next = 0;
+      }
+      a = fea_explicit ? 0 : next++;
+      b = feb == 0 ? next++ : vertices[(vertex_offset - feb) & 15];
+      c = fec == 0 ? next++ : vertices[(vertex_offset - fec) & 15];
+      if (fea_explicit) {
+        a = decode_index();
+      }
+      if (feb == 15 && code >= 0xFE) {
+        b = decode_index();
+      }
+      if (fec == 15 && code >= 0xFE) {
+        c = decode_index();
+      }
+      push_vertex(a, true);
+      push_vertex(b, feb == 0 || feb == 15);
+      push_vertex(c, fec == 0 || fec == 15);
+      push_edge(b, a);
+      push_edge(c, b);
+      push_edge(a, c);
+    }
+    write_index(out, i, index_size, a);
+    write_index(out, i + 1, index_size, b);
+    write_index(out, i + 2, index_size, c);
+  }
+  return in.offset == data_end;
+}
+
+auto tr::meshopt::decode_index_sequence(std::span<std::byte> out, std::size_t count, std::size_t index_size,
+                                        std::span<const std::byte> in_bytes) -> bool {
+  if ((index_size != 2 && index_size != 4) || out.size() < count * index_size) {
+    return false;
+  }
+  const auto data = as_u8(in_bytes);
+  if (data.size() < 1 + count + 4 || (data[0] & 0xF0) != sequence_header || (data[0] & 0x0F) > 1) {
+    return false;
+  }
+  // An index reads at most 5 bytes, the 4 padding bytes at the end leave room for it
+  const auto data_end = data.size() - 4;
+  Cursor in{data, 1};
+
+  // Each index is a delta from the last one of either of two baselines
+  std::array<uint32_t, 2> last{};
+  for (std::size_t i = 0; i < count; i++) {
+    if (in.offset >= data_end) {
+      return false;
+    }
+    const auto v = read_vbyte(in);
+    auto& baseline = last[v & 1];
+    baseline += unzigzag(v >> 1);
+    write_index(out, i, index_size, baseline);
+  }
+  return in.offset == data_end;
+}
+
+void tr::meshopt::filter_octahedral(std::span<std::byte> data, std::size_t count, std::size_t stride) {
+  if (stride == 4) {
+    octahedral<int8_t>(data, count);
+  } else {
+    octahedral<int16_t>(data, count);
+  }
+}
+
+void tr::meshopt::filter_quaternion(std::span<std::byte> data, std::size_t count) {
+  const auto scale = 1.F / std::sqrt(2.F);
+  for (std::size_t i = 0; i < count; i++) {
+    std::array<int16_t, 4> v{};
+    std::memcpy(v.data(), data.data() + i * sizeof(v), sizeof(v));
+
+    // The largest component is left out, the others are in [-1/sqrt(2), 1/sqrt(2)] scaled by the high bits of the 4th
+    const auto ss = scale / static_cast<float>(v[3] | 3);
+    const auto x = static_cast<float>(v[0]) * ss;
+    const auto y = static_cast<float>(v[1]) * ss;
+    const auto z = static_cast<float>(v[2]) * ss;
+    const auto w = std::sqrt(std::max(1.F - x * x - y * y - z * z, 0.F));
+
+    const auto largest = static_cast<std::size_t>(v[3] & 3);
+    std::array<int16_t, 4> q{};
+    q[(largest + 1) & 3] = static_cast<int16_t>(round_to_int(x * 32767.F));
+    q[(largest + 2) & 3] = static_cast<int16_t>(round_to_int(y * 32767.F));
+    q[(largest + 3) & 3] = static_cast<int16_t>(round_to_int(z * 32767.F));
+    q[largest] = static_cast<int16_t>(round_to_int(w * 32767.F));
+    std::memcpy(data.data() + i * sizeof(q), q.data(), sizeof(q));
+  }
+}
+
+void tr::meshopt::filter_exponential(std::span<std::byte> data, std::size_t count, std::size_t stride) {
+  for (std::size_t i = 0; i < count * stride / 4; i++) {
+    uint32_t v = 0;
+    std::memcpy(&v, data.data() + i * 4, 4);
+    // Signed 24 bits of mantissa, signed 8 bits of exponent
+    const auto mantissa = static_cast<int32_t>(v << 8U) >> 8;
+    const auto exponent = static_cast<int32_t>(v) >> 24;
+    const auto f = std::ldexp(static_cast<float>(mantissa), exponent);
+    std::memcpy(data.data() + i * 4, &f, 4);
+  }
+}
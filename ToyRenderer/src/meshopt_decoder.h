@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+// Decoders for the buffer views of EXT_meshopt_compression, the bitstreams of meshoptimizer's vertex and index codecs
+// https://github.com/KhronosGroup/glTF/blob/main/extensions/2.0/Vendor/EXT_meshopt_compression/README.md
+// All of them return false when the data is malformed, out is then left half written
+namespace tr::meshopt {
+
+// ATTRIBUTES mode: count elements of stride bytes, stride is a multiple of 4 up to 256
+auto decode_vertex_buffer(std::span<std::byte> out, std::size_t count, std::size_t stride,
+                          std::span<const std::byte> in) -> bool;
+// TRIANGLES mode: count indices of index_size (2 or 4) bytes, count is a multiple of 3
+auto decode_index_buffer(std::span<std::byte> out, std::size_t count, std::size_t index_size,
+                         std::span<const std::byte> in) -> bool;
+// INDICES mode: any index list, of index_size (2 or 4) bytes
+auto decode_index_sequence(std::span<std::byte> out, std::size_t count, std::size_t index_size,
+                           std::span<const std::byte> in) -> bool;
+
+// Filters run in place on decoded ATTRIBUTES
+// OCTAHEDRAL: 4 int8 or int16 per element, xy encode the direction and z holds 1, back to a normalized xyz
+void filter_octahedral(std::span<std::byte> data, std::size_t count, std::size_t stride);
+// QUATERNION: 4 int16 per element, the 3 smallest components and the index of the largest, back to a unit xyzw
+void filter_quaternion(std::span<std::byte> data, std::size_t count);
+// EXPONENTIAL: 24 bits of mantissa and 8 of exponent per 32 bits, back to floats
+void filter_exponential(std::span<std::byte> data, std::size_t count, std::size_t stride);
+
+}  // namespace tr::meshopt
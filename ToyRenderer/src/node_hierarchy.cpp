@@ -0,0 +1,91 @@
+#include "node_hierarchy.h"
+
+#include <utils/assert.h>       // for TR_ASSERT
+#include <utils/cast.h>         // for narrow_cast
+#include <utils/thread_pool.h>  // for ThreadPool
+
+#include <algorithm>               // for fill, min, upper_bound
+#include <cstddef>                 // for size_t
+#include <cstdint>                 // for uint32_t
+#include <glm/gtc/quaternion.hpp>  // for mat4_cast
+#include <glm/mat4x4.hpp>          // for mat4
+#include <glm/vec4.hpp>            // for vec4
+#include <iterator>                // for distance
+
+namespace {
+// Nodes per task, a node is a few dozen flops so tasks have to be big
+constexpr std::size_t nodes_per_task = 4096;
+}  // namespace
+
+auto tr::NodeHierarchy::add(uint32_t parent, glm::vec3 translation, glm::quat rotation, glm::vec3 scale) -> uint32_t {
+  const auto node = utils::narrow_cast<uint32_t>(parents.size());
+
+  std::size_t depth = 0;
+  if (parent != no_parent) {
+    TR_ASSERT(parent < node, "parent {} of node {} has not been added yet", parent, node);
+    const auto parent_depth_end = std::ranges::upper_bound(depth_starts, parent);
+    depth = static_cast<std::size_t>(std::distance(depth_starts.begin(), parent_depth_end));
+  }
+  TR_ASSERT(depth + 1 >= depth_starts.size(), "node {} is not added depth by depth", node);
+  if (depth == depth_starts.size()) {
+    depth_starts.push_back(node);
+  }
+
+  parents.push_back(parent);
+  translations.push_back(translation);
+  rotations.push_back(rotation);
+  scales.push_back(scale);
+  worlds.emplace_back(1.F);
+  dirty.push_back(1);
+  any_dirty = true;
+  return node;
+}
+
+void tr::NodeHierarchy::set_local(uint32_t node, glm::vec3 translation, glm::quat rotation, glm::vec3 scale) {
+  translations[node] = translation;
+  rotations[node] = rotation;
+  scales[node] = scale;
+  dirty[node] = 1;
+  any_dirty = true;
+}
+
+void tr::NodeHierarchy::update_range(std::size_t begin, std::size_t end) {
+  for (std::size_t i = begin; i < end; i++) {
+    const auto parent = parents[i];
+    // The parent is a depth above, done already
+    if (parent != no_parent && dirty[parent] != 0) {
+      dirty[i] = 1;
+    }
+    if (dirty[i] == 0) {
+      continue;
+    }
+
+    // translate * rotate * scale, without the full products
+    auto local = glm::mat4_cast(rotations[i]);
+    local[0] *= scales[i].x;
+    local[1] *= scales[i].y;
+    local[2] *= scales[i].z;
+    local[3] = glm::vec4(translations[i], 1.F);
+    worlds[i] = parent == no_parent ? local : worlds[parent] * local;
+  }
+}
+
+auto tr::NodeHierarchy::update(utils::ThreadPool& pool) -> bool {
+  if (!any_dirty) {
+    return false;
+  }
+
+  for (std::size_t depth = 0; depth < depth_starts.size(); depth++) {
+    const std::size_t begin = depth_starts[depth];
+    const std::size_t end = depth + 1 < depth_starts.size() ? depth_starts[depth + 1] : parents.size();
+    const auto tasks = (end - begin + nodes_per_task - 1) / nodes_per_task;
+    pool.parallel_for(tasks, [&](std::size_t task) {
+      const auto task_begin = begin + task * nodes_per_task;
+      update_range(task_begin, std::min(end, task_begin + nodes_per_task));
+    });
+  }
+
+  std::ranges::fill(dirty, 0);
+  any_dirty = false;
+  return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/ext/quaternion_float.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <limits>
+#include <vector>
+
+namespace utils {
+class ThreadPool;
+}  // namespace utils
+
+namespace tr {
+
+// Transforms of every node of a scene as flat arrays, sorted by depth so parents always come before their children
+// World matrices are recomputed one depth after the other, each depth split across threads, only below the nodes
+// whose local transform changed
+class NodeHierarchy {
+ public:
+  static constexpr uint32_t no_parent = std::numeric_limits<uint32_t>::max();
+
+  // Nodes are added depth by depth: parent is either no_parent for a root added before any child, or a node of the
+  // depth right above. Returns the index of the node
+  auto add(uint32_t parent, glm::vec3 translation, glm::quat rotation, glm::vec3 scale) -> uint32_t;
+
+  void set_local(uint32_t node, glm::vec3 translation, glm::quat rotation, glm::vec3 scale);
+
+  // Returns whether any world matrix changed
+  auto update(utils::ThreadPool& pool) -> bool;
+
+  [[nodiscard]] auto size() const -> std::size_t { return parents.size(); }
+  [[nodiscard]] auto depth_count() const -> std::size_t { return depth_starts.size(); }
+  [[nodiscard]] auto world(uint32_t node) const -> const glm::mat4& { return worlds[node]; }
+
+ private:
+  void update_range(std::size_t begin, std::size_t end);
+
+  std::vector<uint32_t> parents;
+  std::vector<glm::vec3> translations;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<glm::mat4> worlds;
+  // Not a vector<bool>: nodes next to each other are updated from different threads
+  std::vector<uint8_t> dirty;
+  // First node of each depth
+  std::vector<uint32_t> depth_starts;
+  bool any_dirty = false;
+};
+
+}  // namespace tr
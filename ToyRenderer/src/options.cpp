@@ -39,7 +39,7 @@ struct Entry {
     std::string_view section;
   } info;
 
-  enum class Kind { Boolean, Count, Custom, Choice, String, Float, None } kind = Kind::None;
+  enum class Kind { Boolean, Count, Custom, Choice, String, Float, Unsigned, None } kind = Kind::None;
   union {
     struct {
       bool *value;
@@ -62,6 +62,9 @@ struct Entry {
     struct {
       float *value;
     } float_entry;
+    struct {
+      std::size_t *value;
+    } unsigned_entry;
     int d{};
   };
 };
@@ -122,6 +125,17 @@ auto CliParser::dispactch_action(const Entry &entry) -> ParseResult {
       }
       break;
     }
+    case Entry::Kind::Unsigned: {
+      if (!has_next()) {
+        return ParseResult::MalFormedInput;
+      }
+      auto val = next();
+      const auto [_, ec] = std::from_chars(val.data(), val.data() + val.size(), *entry.unsigned_entry.value);
+      if (ec != std::errc{}) {
+        return ParseResult::MalFormedInput;
+      }
+      break;
+    }
     case Entry::Kind::Choice: {
       if (!has_next()) {
         return ParseResult::MalFormedInput;
@@ -333,6 +347,33 @@ auto tr::Options::from_args(std::span<const char *> args) -> tr::Options {
           Entry::Kind::String,
           {.string_entry = {&ret.scene}},
       },
+      {
+          {'j', "loader-threads", "cap the number of threads used to load the scene (0: one per core)", "Scene"},
+          Entry::Kind::Unsigned,
+          {.unsigned_entry = {&ret.config.loader_threads}},
+      },
+      {
+          {0, "bake", "bake the scene into a .trscene next to it, loaded instead of the glTF from then on", "Scene"},
+          Entry::Kind::Boolean,
+          {.bool_entry = {&ret.config.bake, false}},
+      },
+      {
+          {0, "load-report", "write where loading the scene spent its time to this JSON file", "Scene"},
+          Entry::Kind::String,
+          {.string_entry = {&ret.load_report}},
+      },
+      {
+          {0, "texture-memory", "GPU memory in MiB past which texture levels get evicted (0: the driver budget)",
+           "Config"},
+          Entry::Kind::Unsigned,
+          {.unsigned_entry = {&ret.config.texture_memory}},
+      },
+      {
+          {0, "geometry-memory", "GPU memory in MiB for the meshes of the cells around the camera (0: the whole scene)",
+           "Config"},
+          Entry::Kind::Unsigned,
+          {.unsigned_entry = {&ret.config.geometry_memory}},
+      },
   });
   CliParser parser{.program_name = "ToyRenderer", .message = "Done by me with love <3", .entries = entries};
 
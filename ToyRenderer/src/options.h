@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <cstddef>
 #include <span>
 #include <string_view>
 
@@ -21,9 +22,17 @@ struct Options {
 
   struct {
     VkPresentModeKHR prefered_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    std::size_t loader_threads = 0;
+    bool bake = false;
+    // In MiB, 0 for the budget the driver reports
+    std::size_t texture_memory = 0;
+    // In MiB, 0 for the whole scene
+    std::size_t geometry_memory = 0;
   } config{};
 
   std::string_view scene;
+  // Where to write the JSON load report, none when empty
+  std::string_view load_report;
 
   static auto from_args(std::span<const char *> args) -> Options;
 };
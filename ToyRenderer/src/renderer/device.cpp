@@ -62,9 +62,27 @@ auto check_queues(VkPhysicalDevice physical_device, VkSurfaceKHR surface) -> std
     return families;
   };
 
+  // The fewer other things a family does, the more likely it is a copy engine that runs alongside the graphics one
+  // Partial copies to images need a 1x1x1 granularity, graphics and compute families always have it
+  const auto transfer_rank = [](const VkQueueFamilyProperties& family) -> std::optional<int> {
+    if ((family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
+      return 2;
+    }
+    if ((family.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0) {
+      return 1;
+    }
+    const auto granularity = family.minImageTransferGranularity;
+    if ((family.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0 && granularity.width == 1 && granularity.height == 1 &&
+        granularity.depth == 1) {
+      return 0;
+    }
+    return std::nullopt;
+  };
+
   std::optional<std::size_t> graphics_family;
   std::optional<std::size_t> present_family;
   std::optional<std::size_t> transfert_family;
+  std::optional<int> transfert_rank;
   for (std::size_t i = 0; i < queue_families.size(); i++) {
     const auto& queue_family = queue_families[i];
 
@@ -72,8 +90,9 @@ auto check_queues(VkPhysicalDevice physical_device, VkSurfaceKHR surface) -> std
       graphics_family = i;
     }
 
-    if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0) {
+    if (const auto rank = transfer_rank(queue_family); rank && (!transfert_rank || *rank < *transfert_rank)) {
       transfert_family = i;
+      transfert_rank = rank;
     }
 
     auto present_support = VK_FALSE;
@@ -85,6 +104,11 @@ auto check_queues(VkPhysicalDevice physical_device, VkSurfaceKHR surface) -> std
   if (!(graphics_family.has_value() && present_family.has_value() && transfert_family.has_value())) {
     return std::nullopt;
   }
+  if (*transfert_rank == 2) {
+    transfert_family = graphics_family;
+  }
+  spdlog::debug("Transfers go to queue family {}{}", *transfert_family,
+                *transfert_family == *graphics_family ? ", the graphics one" : "");
 
   return tr::renderer::QueuesInfo{
       .graphics_family = utils::narrow_cast<std::uint32_t>(*graphics_family),
@@ -129,6 +153,13 @@ auto gather_physical_device_infos(VkPhysicalDevice physical_device, VkSurfaceKHR
     return std::nullopt;
   }
 
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(physical_device, &features);
+  infos.texture_compression_bc = features.textureCompressionBC == VK_TRUE;
+  if (!infos.texture_compression_bc) {
+    spdlog::debug("BC texture compression is not supported");
+  }
+
   vkGetPhysicalDeviceProperties(physical_device, &infos.device_properties);
   vkGetPhysicalDeviceMemoryProperties(physical_device, &infos.memory_properties);
   // We take the 1st one suitable
@@ -188,6 +219,7 @@ auto tr::renderer::Device::init(const PhysicalDevice& infos) -> Device {
   vulkan12_features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
   vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
   vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+  vulkan12_features.timelineSemaphore = VK_TRUE;
 
   VkPhysicalDeviceVulkan13Features vulkan13_features{};
   vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
@@ -195,6 +227,9 @@ auto tr::renderer::Device::init(const PhysicalDevice& infos) -> Device {
   vulkan13_features.synchronization2 = VK_TRUE;
   vulkan13_features.dynamicRendering = VK_TRUE;
 
+  VkPhysicalDeviceFeatures features{};
+  features.textureCompressionBC = infos.texture_compression_bc ? VK_TRUE : VK_FALSE;
+
   const auto r = infos.extensions | std::views::transform(&std::string::c_str);
   const std::vector<const char*> extensions{r.begin(), r.end()};
 
@@ -208,7 +243,7 @@ auto tr::renderer::Device::init(const PhysicalDevice& infos) -> Device {
       .ppEnabledLayerNames = nullptr,
       .enabledExtensionCount = utils::narrow_cast<std::uint32_t>(extensions.size()),
       .ppEnabledExtensionNames = extensions.data(),
-      .pEnabledFeatures = nullptr,
+      .pEnabledFeatures = &features,
   };
 
   VkResult result = vkCreateDevice(infos.vk_physical_device, &device_create_info, nullptr, &device.vk_device);
@@ -27,6 +27,8 @@ struct PhysicalDevice {
   VkPhysicalDeviceProperties device_properties{};
   VkPhysicalDeviceMemoryProperties memory_properties{};
   QueuesInfo queues;
+  // Optional, scenes fall back to uncompressed textures without it
+  bool texture_compression_bc = false;
 
   static auto init(VkInstance instance, VkSurfaceKHR surface) -> PhysicalDevice;
 };
@@ -2,7 +2,10 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 
 #include "buffer.h"
 #include "descriptors.h"
@@ -37,10 +40,22 @@ struct Frame {
   utils::types::not_null_pointer<tr::renderer::FrameRessourceData> frm;
 
   const VulkanEngine *ctx;
+  // The frame runs the graphics commands of the transfers up to transfer_value, it waits for the timeline to reach it
+  // 0 if it runs none
+  VkSemaphore transfer_timeline = VK_NULL_HANDLE;
+  std::uint64_t transfer_value = 0;
 
   auto submitCmds(VkQueue queue) const -> VkResult {
+    const std::array semaphores{synchro.present_semaphore, transfer_timeline};
+    // Uploaded buffers may be read as soon as vertex input
+    const std::array<VkPipelineStageFlags, 2> stages{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+    const std::array<std::uint64_t, 2> values{0, transfer_value};
+    const std::size_t wait_count = transfer_value == 0 ? 1 : 2;
+
     return QueueSubmit{}
-        .wait_semaphores<1>({{synchro.present_semaphore}}, {{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}})
+        .wait_semaphores(std::span(semaphores).first(wait_count), std::span(stages).first(wait_count))
+        .wait_values(std::span(values).first(wait_count))
         .signal_semaphores({{synchro.render_semaphore}})
         .command_buffers({{cmd.vk_cmd}})
         .submit(queue, synchro.render_fence);
@@ -0,0 +1,105 @@
+#include "geometry_buffer.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "mesh.h"
+#include "ressources.h"
+#include "utils/assert.h"
+#include "utils/cast.h"
+#include "utils/data/range_allocator.h"
+
+namespace {
+using utils::data::range_allocator;
+
+auto index_size(VkIndexType index_type) -> std::size_t {
+  return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+}  // namespace
+
+auto tr::renderer::GeometryBuffer::init(Lifetime& lifetime, const BufferBuilder& bb, std::size_t vertex_capacity,
+                                        std::size_t index_capacity) -> GeometryBuffer {
+  GeometryBuffer geometry;
+  geometry.vertex_allocator.grow(vertex_capacity);
+  geometry.index_allocator.grow(index_capacity);
+
+  // Vulkan does not allow empty buffers. Meshes are written straight into them when they end up host visible
+  geometry.positions = bb.build_buffer({
+      .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .size = utils::narrow_cast<uint32_t>(std::max<std::size_t>(vertex_capacity * sizeof(VertexPosition), 1)),
+      .flags = BUFFER_OPTION_FLAG_DIRECT_UPLOAD_BIT,
+      .debug_name = "scene positions",
+  });
+  geometry.positions.tie(lifetime);
+  geometry.attributes = bb.build_buffer({
+      .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .size = utils::narrow_cast<uint32_t>(std::max<std::size_t>(vertex_capacity * sizeof(PackedAttributes), 1)),
+      .flags = BUFFER_OPTION_FLAG_DIRECT_UPLOAD_BIT,
+      .debug_name = "scene attributes",
+  });
+  geometry.attributes.tie(lifetime);
+  geometry.indices = bb.build_buffer({
+      .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .size = utils::narrow_cast<uint32_t>(std::max<std::size_t>(index_capacity, 1)),
+      .flags = BUFFER_OPTION_FLAG_DIRECT_UPLOAD_BIT,
+      .debug_name = "scene indices",
+  });
+  geometry.indices.tie(lifetime);
+  spdlog::debug("Geometry is {}", geometry.indices.mapped_data != nullptr ? "written directly" : "staged");
+  return geometry;
+}
+
+auto tr::renderer::GeometryBuffer::allocate(std::size_t vertex_count, std::size_t index_count,
+                                            VkIndexType index_type) -> GeometryAllocation {
+  const auto allocation = try_allocate(vertex_count, index_count, index_type);
+  TR_ASSERT(allocation, "no room left for {} vertices and {} indices in the geometry buffer", vertex_count,
+            index_count);
+  return *allocation;
+}
+
+auto tr::renderer::GeometryBuffer::try_allocate(std::size_t vertex_count, std::size_t index_count,
+                                                VkIndexType index_type) -> std::optional<GeometryAllocation> {
+  const auto vertices_ = vertex_allocator.allocate(vertex_count);
+  if (!vertices_) {
+    return std::nullopt;
+  }
+
+  const auto size = index_size(index_type);
+  const auto indices_ = index_allocator.allocate(index_count * size, size);
+  if (!indices_) {
+    vertex_allocator.free(*vertices_);
+    return std::nullopt;
+  }
+
+  return GeometryAllocation{
+      .vertices = *vertices_,
+      .indices = *indices_,
+      .index_type = index_type,
+  };
+}
+
+void tr::renderer::GeometryBuffer::free(const GeometryAllocation& allocation) {
+  vertex_allocator.free(allocation.vertices);
+  index_allocator.free(allocation.indices);
+}
+
+tr::renderer::GeometryBinder::GeometryBinder(VkCommandBuffer cmd_, const GeometryBuffer& geometry_,
+                                             VertexStreams streams)
+    : cmd(cmd_), geometry(geometry_) {
+  const std::array buffers{geometry.positions.buffer, geometry.attributes.buffer};
+  const std::array<VkDeviceSize, 2> offsets{};
+  const uint32_t binding_count = streams == VertexStreams::All ? 2 : 1;
+  vkCmdBindVertexBuffers(cmd, 0, binding_count, buffers.data(), offsets.data());
+}
+
+void tr::renderer::GeometryBinder::bind(const GeometryAllocation& allocation) {
+  if (allocation.index_type != index_type) {
+    index_type = allocation.index_type;
+    vkCmdBindIndexBuffer(cmd, geometry.indices.buffer, 0, index_type);
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "ressources.h"
+#include "utils/data/range_allocator.h"
+
+namespace tr::renderer {
+struct Lifetime;
+
+// Where a mesh lives in the GeometryBuffer
+struct GeometryAllocation {
+  // In vertices
+  utils::data::range_allocator::range vertices{};
+  // In bytes, aligned on the index size
+  utils::data::range_allocator::range indices{};
+  VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+
+  [[nodiscard]] auto vertex_offset() const -> int32_t { return static_cast<int32_t>(vertices.offset); }
+  [[nodiscard]] auto first_index() const -> uint32_t {
+    return static_cast<uint32_t>(indices.offset / (index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4));
+  }
+};
+
+// Two vertex buffers, one per stream (see VertexPosition), and one index buffer for every mesh of the scene: passes
+// bind them once and pick meshes with vertexOffset and firstIndex. A mesh has the same vertex offset in both streams
+class GeometryBuffer {
+ public:
+  static auto init(Lifetime& lifetime, const BufferBuilder& bb, std::size_t vertex_capacity,
+                   std::size_t index_capacity) -> GeometryBuffer;
+
+  auto allocate(std::size_t vertex_count, std::size_t index_count, VkIndexType index_type) -> GeometryAllocation;
+  // Same without asserting, nullopt when either buffer is too full
+  auto try_allocate(std::size_t vertex_count, std::size_t index_count, VkIndexType index_type)
+      -> std::optional<GeometryAllocation>;
+  void free(const GeometryAllocation& allocation);
+
+  // In vertices and in bytes
+  [[nodiscard]] auto vertex_usage() const -> std::size_t { return vertex_allocator.used(); }
+  [[nodiscard]] auto index_usage() const -> std::size_t { return index_allocator.used(); }
+
+  BufferRessource positions;
+  BufferRessource attributes;
+  BufferRessource indices;
+
+ private:
+  utils::data::range_allocator vertex_allocator;
+  utils::data::range_allocator index_allocator;
+};
+
+enum class VertexStreams : uint8_t {
+  // For depth only pipelines, whose vertex input is VertexInput<VertexPosition>
+  Positions,
+  // VertexInput<VertexPosition, PackedAttributes>
+  All,
+};
+
+// Binds the GeometryBuffer for a pass, the index buffer is rebound only when the index type changes
+class GeometryBinder {
+ public:
+  GeometryBinder(VkCommandBuffer cmd_, const GeometryBuffer& geometry_, VertexStreams streams = VertexStreams::All);
+
+  void bind(const GeometryAllocation& allocation);
+
+ private:
+  VkCommandBuffer cmd;
+  const GeometryBuffer& geometry;
+  VkIndexType index_type = VK_INDEX_TYPE_MAX_ENUM;
+};
+
+}  // namespace tr::renderer
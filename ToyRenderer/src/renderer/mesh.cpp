@@ -0,0 +1,63 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace {
+// Folds the unit sphere onto the [-1, 1] square, decoded by oct_decode in math.glsl
+auto oct_encode(glm::vec3 n) -> std::array<int16_t, 2> {
+  const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  if (l1 == 0.F) {
+    // Missing attribute, decodes as (0, 0, 1)
+    return {0, 0};
+  }
+  n /= l1;
+
+  glm::vec2 e{n.x, n.y};
+  if (n.z < 0.F) {
+    const glm::vec2 sign{n.x >= 0.F ? 1.F : -1.F, n.y >= 0.F ? 1.F : -1.F};
+    e = (1.F - glm::abs(glm::vec2{n.y, n.x})) * sign;
+  }
+  return {std::bit_cast<int16_t>(glm::packSnorm1x16(e.x)), std::bit_cast<int16_t>(glm::packSnorm1x16(e.y))};
+}
+}  // namespace
+
+auto tr::renderer::PackedAttributes::pack(const Vertex& vertex) -> PackedAttributes {
+  return {
+      .normal = oct_encode(vertex.normal),
+      .tangent = oct_encode(glm::vec3(vertex.tangent)),
+      .color = {glm::packUnorm1x8(vertex.color.r), glm::packUnorm1x8(vertex.color.g),
+                glm::packUnorm1x8(vertex.color.b), vertex.tangent.w < 0.F ? uint8_t{0} : uint8_t{0xFF}},
+      .uv1 = {glm::packHalf1x16(vertex.uv1.x), glm::packHalf1x16(vertex.uv1.y)},
+      .uv2 = {glm::packHalf1x16(vertex.uv2.x), glm::packHalf1x16(vertex.uv2.y)},
+  };
+}
+
+void tr::renderer::Mesh::summarize_surfaces() {
+  bounding_box = {};
+  lod_errors.clear();
+  for (std::size_t s = 0; s < surfaces.size(); s++) {
+    const auto& surface = surfaces[s];
+    if (s == 0) {
+      bounding_box = surface.bounding_box;
+    } else {
+      bounding_box.min = glm::min(bounding_box.min, surface.bounding_box.min);
+      bounding_box.max = glm::max(bounding_box.max, surface.bounding_box.max);
+    }
+
+    // Surfaces with fewer levels stay on their coarsest one, it has been checked by a finer level of the mesh already
+    lod_errors.resize(std::max<std::size_t>(lod_errors.size(), surface.lod_count));
+    for (uint32_t level = 0; level < surface.lod_count; level++) {
+      lod_errors[level] = std::max(lod_errors[level], lods[surface.first_lod + level].error);
+    }
+  }
+}
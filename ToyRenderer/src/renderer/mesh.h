@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/vector_float2.hpp>
 #include <glm/ext/vector_float3.hpp>
 #include <glm/ext/vector_float4.hpp>
 #include <glm/fwd.hpp>
@@ -11,6 +14,7 @@
 #include <vector>
 
 #include "../camera.h"
+#include "geometry_buffer.h"
 #include "ressources.h"
 #include "vertex.h"
 
@@ -18,39 +22,54 @@ namespace tr::renderer {
 enum class image_ressource_handle : uint32_t;
 enum class buffer_ressource_handle : uint32_t;
 
+// Full precision vertex, what the loader works with. The GPU only ever sees VertexPosition and PackedAttributes
 struct Vertex {
   glm::vec3 pos;
   glm::vec3 normal;
-  glm::vec3 tangent;
+  // w is the handedness of the uv mapping, +1 or -1
+  glm::vec4 tangent;
   glm::vec3 color;
   glm::vec2 uv1;
   glm::vec2 uv2;
+};
+
+// Vertices are split in two streams, binding 0 is the positions: depth only passes fetch nothing else
+struct VertexPosition {
+  glm::vec3 pos;
 
-  const static std::array<VkVertexInputAttributeDescription, 6> attributes;
-  const static std::array<VkVertexInputBindingDescription, 1> bindings;
+  const static std::array<VertexAttribute, 1> layout;
 };
-inline constexpr std::array<VkVertexInputAttributeDescription, 6> Vertex::attributes =
-    AttributeBuilder<6>{}
-        .binding(0)
-        .attribute(0, offsetof(Vertex, pos), VK_FORMAT_R32G32B32_SFLOAT)
-        .attribute(1, offsetof(Vertex, normal), VK_FORMAT_R32G32B32_SFLOAT)
-        .attribute(2, offsetof(Vertex, tangent), VK_FORMAT_R32G32B32_SFLOAT)
-        .attribute(3, offsetof(Vertex, color), VK_FORMAT_R32G32B32_SFLOAT)
-        .attribute(4, offsetof(Vertex, uv1), VK_FORMAT_R32G32_SFLOAT)
-        .attribute(5, offsetof(Vertex, uv2), VK_FORMAT_R32G32_SFLOAT)
-        .build();
-
-inline constexpr std::array<VkVertexInputBindingDescription, 1> Vertex::bindings =
-    std::to_array<VkVertexInputBindingDescription>({
-        {
-            .binding = 0,
-            .stride = sizeof(tr::renderer::Vertex),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        },
-    });
+inline constexpr std::array<VertexAttribute, 1> VertexPosition::layout{{
+    {0, offsetof(VertexPosition, pos), VK_FORMAT_R32G32B32_SFLOAT},
+}};
+static_assert(sizeof(VertexPosition) == 12);
+
+// Binding 1 is everything else, packed, the vertex fetch unit converts back to floats:
+// - normal and tangent are octahedral encoded unit vectors
+// - color alpha is the tangent handedness, 0 for -1
+// - uvs are half floats
+struct PackedAttributes {
+  std::array<int16_t, 2> normal;
+  std::array<int16_t, 2> tangent;
+  std::array<uint8_t, 4> color;
+  std::array<uint16_t, 2> uv1;
+  std::array<uint16_t, 2> uv2;
+
+  static auto pack(const Vertex& vertex) -> PackedAttributes;
+
+  const static std::array<VertexAttribute, 5> layout;
+};
+inline constexpr std::array<VertexAttribute, 5> PackedAttributes::layout{{
+    {1, offsetof(PackedAttributes, normal), VK_FORMAT_R16G16_SNORM},
+    {2, offsetof(PackedAttributes, tangent), VK_FORMAT_R16G16_SNORM},
+    {3, offsetof(PackedAttributes, color), VK_FORMAT_R8G8B8A8_UNORM},
+    {4, offsetof(PackedAttributes, uv1), VK_FORMAT_R16G16_SFLOAT},
+    {5, offsetof(PackedAttributes, uv2), VK_FORMAT_R16G16_SFLOAT},
+}};
+static_assert(sizeof(PackedAttributes) == 20);
 
 struct MaterialHandles {
-  image_ressource_handle albedo_handle;
+  std::optional<image_ressource_handle> albedo_handle;
   std::optional<image_ressource_handle> normal_handle;
   std::optional<image_ressource_handle> metallic_roughness_handle;
 };
@@ -66,23 +85,63 @@ struct AABB {
   glm::vec3 max;
 };
 
+// About 64 vertices and 124 triangles of a surface, small enough to be culled on their own
+// The triangles are contiguous in the index buffer, start is relative to the mesh like GeoSurface::start
+struct Meshlet {
+  uint32_t start;
+  uint32_t count;
+  glm::vec3 center;
+  float radius;
+  // Every triangle normal is in the cone, cone_cutoff is the sine of its half angle
+  // 1 when the cone is too wide for the meshlet to ever be entirely back facing
+  glm::vec3 cone_axis;
+  float cone_cutoff;
+};
+
+// A simplified version of a surface, drawn instead of it when its error is small enough on screen
+// Its indices follow the ones of every surface of the mesh, start is relative to the mesh like GeoSurface::start
+struct SurfaceLod {
+  uint32_t start;
+  uint32_t count;
+  // How far it is from the surface, in mesh space
+  float error;
+};
+
 struct GeoSurface {
   uint32_t start;
   uint32_t count;
   MaterialHandles material;
   AABB bounding_box;
+  // Average uv units per unit of mesh space
+  float uv_density;
+  // Into Mesh::meshlets
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+  // Into Mesh::lods, from the finest to the coarsest
+  uint32_t first_lod;
+  uint32_t lod_count;
 };
 
 struct Mesh {
   std::string name;
 
-  struct GPUMeshBuffers {
-    BufferRessource vertices;
-    std::optional<BufferRessource> indices;
-  } buffers;
+  // Indices are 16 bits whenever the vertices allow it
+  GeometryAllocation geometry;
 
   std::vector<GeoSurface> surfaces;
-  glm::mat4x4 transform = glm::identity<glm::mat4x4>();
+  std::vector<Meshlet> meshlets;
+  std::vector<SurfaceLod> lods;
+  // World matrix of every place the mesh is drawn at, all of them in one instanced draw per surface
+  std::vector<glm::mat4x4> instances;
+
+  // Of every surface, instances are culled and given a level of detail once for the whole mesh
+  AABB bounding_box{};
+  // Error of each level of the whole mesh, the largest of its surfaces: lod_errors[i - 1] is the one of level i, which
+  // draws lods[first_lod + min(i, lod_count) - 1] of every surface. Level 0 is the surfaces themselves
+  std::vector<float> lod_errors;
+
+  // Fills bounding_box and lod_errors from surfaces and lods
+  void summarize_surfaces();
 };
 
 struct DirectionalLight {
@@ -91,9 +150,14 @@ struct DirectionalLight {
   glm::vec3 color;
   float padding2_ = 0.0;
 
+  // Bounds of the orthographic projection, in light view space
+  static constexpr float half_extent = 10.F;
+  static constexpr float z_near = 0.1F;
+  static constexpr float z_far = 50.F;
+
   [[nodiscard]] auto camera_info() const -> CameraInfo {
     const glm::vec3 pos = 40.F * direction;
-    auto projMat = glm::ortho(-10., 10., -10., 10., 0.1, 50.);
+    auto projMat = glm::ortho(-half_extent, half_extent, -half_extent, half_extent, z_near, z_far);
     projMat[1][1] *= -1;
     return {
         .projMatrix = projMat,
@@ -18,6 +18,7 @@
 #include "../descriptors.h"           // for DescriptorSetLayoutBuilder, Des...
 #include "../device.h"                // for Device
 #include "../frame.h"                 // for Frame
+#include "../geometry_buffer.h"       // for GeometryBinder
 #include "../mesh.h"                  // for GeoSurface, MaterialHandles, Mesh
 #include "../pipeline.h"              // for PipelineBuilder, FileIncluder
 #include "../ressource_definition.h"  // for DefaultRessources, RENDERED, DEPTH
@@ -84,8 +85,10 @@ void tr::renderer::Forward::init(Lifetime &lifetime, VulkanContext &ctx, Ressour
   };
   const auto dynamic_state_state = PipelineDynamicStateBuilder{}.dynamic_state(dynamic_states).build();
 
-  const auto vertex_input_state =
-      PipelineVertexInputStateBuilder{}.vertex_attributes(Vertex::attributes).vertex_bindings(Vertex::bindings).build();
+  const auto vertex_input_state = PipelineVertexInputStateBuilder{}
+                                      .vertex_attributes(VertexInput<VertexPosition, PackedAttributes>::attributes)
+                                      .vertex_bindings(VertexInput<VertexPosition, PackedAttributes>::bindings)
+                                      .build();
   const auto input_assembly_state =
       PipelineInputAssemblyBuilder{}.topology_(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST).build();
   const auto viewport_state = PipelineViewportStateBuilder{}.viewports_count(1).scissors_count(1).build();
@@ -172,18 +175,14 @@ void tr::renderer::Forward::init(Lifetime &lifetime, VulkanContext &ctx, Ressour
   }
 }
 
-void tr::renderer::Forward::draw_mesh(Frame &frame, const Frustum &frustum, const Mesh &mesh,
-                                      const DefaultRessources &default_ressources) const {
+void tr::renderer::Forward::draw_mesh(Frame &frame, GeometryBinder &binder, const Frustum &frustum, const Mesh &mesh,
+                                      const glm::mat4x4 &transform, const DefaultRessources &default_ressources) const {
   auto &shadow_map_ressource = frame.frm->get_image_ressource(shadow_map_handle);
 
-  const VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(frame.cmd.vk_cmd, 0, 1, &mesh.buffers.vertices.buffer, &offset);
-  if (mesh.buffers.indices) {
-    vkCmdBindIndexBuffer(frame.cmd.vk_cmd, mesh.buffers.indices->buffer, 0, VK_INDEX_TYPE_UINT32);
-  }
+  binder.bind(mesh.geometry);
 
   vkCmdPushConstants(frame.cmd.vk_cmd, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4),
-                     &mesh.transform);
+                     &transform);
 
   std::span<const GeoSurface> const surfaces = mesh.surfaces;
   for (const auto &surface : FrustrumCulling::filter(frustum, surfaces)) {
@@ -194,7 +193,10 @@ void tr::renderer::Forward::draw_mesh(Frame &frame, const Frustum &frustum, cons
         .image_info({{
             {
                 .sampler = default_ressources.sampler,
-                .imageView = frame.frm->get_image_ressource(surface.material.albedo_handle).view,
+                .imageView = frame.frm
+                                 ->get_image_ressource(
+                                     surface.material.albedo_handle.value_or(default_ressources.albedo_handle))
+                                 .view,
                 .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             },
             {
@@ -229,11 +231,8 @@ void tr::renderer::Forward::draw_mesh(Frame &frame, const Frustum &frustum, cons
     vkCmdBindDescriptorSets(frame.cmd.vk_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &descriptor, 0,
                             nullptr);
 
-    if (mesh.buffers.indices) {
-      vkCmdDrawIndexed(frame.cmd.vk_cmd, surface.count, 1, surface.start, 0, 0);
-    } else {
-      vkCmdDraw(frame.cmd.vk_cmd, surface.count, 1, surface.start, 0);
-    }
+    vkCmdDrawIndexed(frame.cmd.vk_cmd, surface.count, 1, mesh.geometry.first_index() + surface.start,
+                     mesh.geometry.vertex_offset(), 0);
   }
 }
 
@@ -14,6 +14,7 @@
 #include "../debug.h"
 #include "../descriptors.h"
 #include "../frame.h"
+#include "../geometry_buffer.h"
 #include "../mesh.h"
 #include "../ressource_definition.h"
 #include "frustrum_culling.h"
@@ -75,7 +76,7 @@ struct Forward {
   void end_draw(VkCommandBuffer cmd) const;
 
   template <utils::types::range_of<const Mesh &> Range>
-  void draw(Frame &frame, VkRect2D render_area, const Camera &cam, Range meshes,
+  void draw(Frame &frame, VkRect2D render_area, const Camera &cam, const GeometryBuffer &geometry, Range meshes,
             std::span<const DirectionalLight> lights, DefaultRessources default_ressources) const {
     const DebugCmdScope scope(frame.cmd.vk_cmd, "Forward");
 
@@ -84,6 +85,7 @@ struct Forward {
     auto fr = Frustum::from_camera(cam);
     const auto camInfo = cam.cameraInfo();
 
+    GeometryBinder binder{frame.cmd.vk_cmd, geometry};
     for (const auto &light : lights) {
       PushConstant data{
           light.camera_info(),
@@ -92,15 +94,18 @@ struct Forward {
       vkCmdPushConstants(frame.cmd.vk_cmd, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4x4),
                          sizeof(data), &data);
 
+      // Not instanced, each instance is its own draw
       for (const auto &mesh : meshes) {
-        draw_mesh(frame, fr.transform(camInfo.viewMatrix * mesh.transform), mesh, default_ressources);
+        for (const auto &instance : mesh.instances) {
+          draw_mesh(frame, binder, fr.transform(camInfo.viewMatrix * instance), mesh, instance, default_ressources);
+        }
       }
     }
     end_draw(frame.cmd.vk_cmd);
   }
 
-  void draw_mesh(Frame &frame, const Frustum &frustum, const Mesh &mesh,
-                 const DefaultRessources &default_ressources) const;
+  void draw_mesh(Frame &frame, GeometryBinder &binder, const Frustum &frustum, const Mesh &mesh,
+                 const glm::mat4x4 &transform, const DefaultRessources &default_ressources) const;
   auto imgui() -> bool;
 
   struct PushConstant {
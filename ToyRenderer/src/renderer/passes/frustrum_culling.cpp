@@ -1,7 +1,9 @@
 #include "frustrum_culling.h"
 
+#include <algorithm>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/vector_float4.hpp>
+#include <glm/matrix.hpp>
 
 namespace tr::renderer {
 
@@ -65,6 +67,87 @@ auto Frustum::from_camera(const Camera& cam) -> Frustum {
   };
 }
 
+auto Frustum::from_ortho(float half_width, float half_height, float z_near, float z_far) -> Frustum {
+  return Frustum{
+      .front = Plane::from_normal_point({0, 0, -1}, {0, 0, -z_near}),
+      .back = Plane::from_normal_point({0, 0, 1}, {0, 0, -z_far}),
+      .right = Plane::from_normal_point({-1, 0, 0}, {half_width, 0, 0}),
+      .left = Plane::from_normal_point({1, 0, 0}, {-half_width, 0, 0}),
+      .top = Plane::from_normal_point({0, -1, 0}, {0, half_height, 0}),
+      .bottom = Plane::from_normal_point({0, 1, 0}, {0, -half_height, 0}),
+  };
+}
+
+auto MeshletCulling::View::from(const Frustum& view_frustum, glm::vec4 view_eye, const glm::mat4& model_view,
+                                float view_pixels_per_unit) -> View {
+  // With a perspective eye, distances are measured in mesh space too and the scale cancels out
+  float scale = 1.F;
+  if (view_eye.w == 0.F) {
+    scale = std::max({glm::length(glm::vec3(model_view[0])), glm::length(glm::vec3(model_view[1])),
+                      glm::length(glm::vec3(model_view[2]))});
+  }
+  return {
+      .frustum = view_frustum.transform(model_view),
+      .eye = glm::inverse(model_view) * view_eye,
+      .pixels_per_unit = view_pixels_per_unit * scale,
+  };
+}
+
+auto MeshletCulling::visible(const View& view, const Meshlet& meshlet) -> bool {
+  // Planes are neither normalized nor free of the model scale, the distance has to be rescaled
+  const auto outside = [&](const Plane& plane) {
+    return plane.dist(meshlet.center) < -meshlet.radius * glm::length(glm::vec3(plane.p));
+  };
+  const auto& f = view.frustum;
+  if (outside(f.top) || outside(f.bottom) || outside(f.right) || outside(f.left)) {
+    return false;
+  }
+
+  if (meshlet.cone_cutoff >= 1.F) {
+    return true;
+  }
+  // Conservative over the whole bounding sphere, see meshoptimizer's meshopt_computeClusterBounds
+  if (view.eye.w == 0.F) {
+    const auto forward = -glm::normalize(glm::vec3(view.eye));
+    return glm::dot(forward, meshlet.cone_axis) < meshlet.cone_cutoff;
+  }
+  const auto eye_to_center = meshlet.center - glm::vec3(view.eye) / view.eye.w;
+  return glm::dot(eye_to_center, meshlet.cone_axis) <
+         meshlet.cone_cutoff * glm::length(eye_to_center) + meshlet.radius;
+}
+
+void MeshletCulling::filter(const View& view, std::span<const Meshlet> meshlets, std::vector<IndexRange>& ranges) {
+  for (const auto& meshlet : meshlets) {
+    if (!visible(view, meshlet)) {
+      continue;
+    }
+    if (!ranges.empty() && ranges.back().start + ranges.back().count == meshlet.start) {
+      ranges.back().count += meshlet.count;
+    } else {
+      ranges.push_back({meshlet.start, meshlet.count});
+    }
+  }
+}
+
+auto LodSelection::select(const MeshletCulling::View& view, const Mesh& mesh, float threshold) -> uint32_t {
+  auto pixels_per_error = view.pixels_per_unit;
+  if (view.eye.w != 0.F) {
+    const auto eye = glm::vec3(view.eye) / view.eye.w;
+    const auto distance = glm::length(glm::clamp(eye, mesh.bounding_box.min, mesh.bounding_box.max) - eye);
+    if (distance == 0.F) {
+      return 0;
+    }
+    pixels_per_error /= distance;
+  }
+
+  // Errors only grow along the chain
+  uint32_t level = 0;
+  while (level < mesh.lod_errors.size() && mesh.lod_errors[level] * pixels_per_error <= threshold) {
+    level++;
+  }
+  return level;
+}
+
 // Those should be stored alongside the frustrum
 auto Frustum::points() const -> std::array<glm::vec3, 8> {
   auto intersect_planes = [&](const Plane& a, const Plane& b, const Plane& c) -> glm::vec3 {
@@ -3,6 +3,8 @@
 #include <utils/types.h>  // for range_of
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <glm/common.hpp>  // for abs
 #include <glm/ext/vector_float3.hpp>
 #include <glm/fwd.hpp>                   // for vec3, mat4
@@ -11,9 +13,11 @@
 #include <glm/mat4x4.hpp>                // for mat4
 #include <glm/vec3.hpp>                  // for vec, operator*, operator+
 #include <ranges>                        // for filter
+#include <span>                          // for span
+#include <vector>                        // for vector
 
 #include "../../camera.h"  // for Camera
-#include "../mesh.h"       // for AABB, GeoSurface
+#include "../mesh.h"       // for AABB, GeoSurface, Meshlet, SurfaceLod, Mesh
 
 namespace tr::renderer {
 
@@ -36,6 +40,8 @@ struct Frustum {
   Plane front, back, right, left, top, bottom;
 
   static auto from_camera(const Camera& cam) -> Frustum;
+  // Symmetric orthographic projection looking down -z
+  static auto from_ortho(float half_width, float half_height, float z_near, float z_far) -> Frustum;
   [[nodiscard]] auto transform(const glm::mat4& transform_) const -> Frustum;
   [[nodiscard]] auto points() const -> std::array<glm::vec3, 8>;
 };
@@ -52,4 +58,42 @@ struct FrustrumCulling {
   }
 };
 
+// Part of the index buffer of a mesh, relative to it like GeoSurface::start
+struct IndexRange {
+  uint32_t start;
+  uint32_t count;
+};
+
+struct CullingStats {
+  std::size_t scene_triangles = 0;
+  std::size_t submitted_triangles = 0;
+  // Left out once the instance buffer is full
+  std::size_t dropped_instances = 0;
+};
+
+struct MeshletCulling {
+  // Everything is in the space of the mesh
+  struct View {
+    Frustum frustum;
+    // Homogeneous position of the eye, w = 0 for an orthographic camera: it is then the direction the eye is at
+    glm::vec4 eye;
+    // Pixels covered by one unit of the mesh, at a distance of one unit from the eye when it is a perspective one
+    float pixels_per_unit;
+
+    // view_frustum and view_eye are in view space, view_pixels_per_unit is in view units
+    static auto from(const Frustum& view_frustum, glm::vec4 view_eye, const glm::mat4& model_view,
+                     float view_pixels_per_unit) -> View;
+  };
+
+  static auto visible(const View& view, const Meshlet& meshlet) -> bool;
+
+  // Appends the visible meshlets to ranges, neighbours are merged in a single range
+  static void filter(const View& view, std::span<const Meshlet> meshlets, std::vector<IndexRange>& ranges);
+};
+
+struct LodSelection {
+  // Coarsest level of mesh whose error covers at most threshold pixels, see Mesh::lod_errors
+  static auto select(const MeshletCulling::View& view, const Mesh& mesh, float threshold) -> uint32_t;
+};
+
 }  // namespace tr::renderer
@@ -2,12 +2,10 @@
 
 #include <shaderc/env.h>      // for shaderc_env_version_vulkan_1_3
 #include <shaderc/shaderc.h>  // for shaderc_glsl_fragment_shader
-#include <spdlog/spdlog.h>
 #include <vulkan/vulkan_core.h>  // for VkShaderStageFlagBits, VkDescri...
 
 #include <array>                // for array, to_array
 #include <cstdint>              // for uint32_t
-#include <glm/fwd.hpp>          // for mat4x4
 #include <optional>             // for optional
 #include <shaderc/shaderc.hpp>  // for CompileOptions, Compiler
 #include <span>                 // for span
@@ -17,6 +15,7 @@
 #include "../descriptors.h"           // for DescriptorSetLayoutBindingBuilder
 #include "../device.h"                // for Device
 #include "../frame.h"                 // for Frame
+#include "../geometry_buffer.h"       // for GeometryBinder
 #include "../mesh.h"                  // for GeoSurface, MaterialHandles, Mesh
 #include "../pipeline.h"              // for PipelineColorBlendAttachmentSta...
 #include "../ressource_definition.h"  // for GBUFFER_0, GBUFFER_1, GBUFFER_2
@@ -24,7 +23,8 @@
 #include "../ressources.h"            // for BufferRessourceDefinition, Imag...
 #include "../synchronisation.h"       // for SyncColorAttachmentOutput, Sync...
 #include "../vulkan_engine.h"         // for VulkanEngine
-#include "frustrum_culling.h"         // for FrustrumCulling
+#include "frustrum_culling.h"         // for IndexRange, MeshletCulling
+#include "instancing.h"               // for InstanceCulling, InstanceWriter
 #include "pass.h"                     // for ColorAttachment, PassInfo, Basi...
 #include "utils/cast.h"               // for narrow_cast, to_array
 #include "utils/misc.h"               // for ignore_unused
@@ -64,6 +64,12 @@ const PassDefinition gbuffer_pass{
                     .descriptor_count(1)
                     .stages(VK_SHADER_STAGE_VERTEX_BIT)
                     .build(),
+                DescriptorSetLayoutBindingBuilder{}
+                    .binding_(1)
+                    .descriptor_type(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                    .descriptor_count(1)
+                    .stages(VK_SHADER_STAGE_VERTEX_BIT)
+                    .build(),
             },
             {
                 DescriptorSetLayoutBindingBuilder{}
@@ -82,21 +88,16 @@ const PassDefinition gbuffer_pass{
         },
     .push_constants =
         {
-            {
-                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-                .offset = 0,
-                .size = sizeof(glm::mat4x4),
-            },
             {
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .offset = sizeof(glm::mat4x4),
+                .offset = 0,
                 .size = 3 * sizeof(uint32_t),
             },
         },
     .inputs =
         {
             .images = {},
-            .buffers = {CAMERA},
+            .buffers = {CAMERA, INSTANCES},
         },
     .outputs =
         {
@@ -114,8 +115,8 @@ const PassDefinition gbuffer_pass{
 
 constexpr BasicPipelineDefinition gbuffer_pipeline{
     .vertex_input_state = PipelineVertexInputStateBuilder{}
-                              .vertex_attributes(Vertex::attributes)
-                              .vertex_bindings(Vertex::bindings)
+                              .vertex_attributes(VertexInput<VertexPosition, PackedAttributes>::attributes)
+                              .vertex_bindings(VertexInput<VertexPosition, PackedAttributes>::bindings)
                               .build(),
     .input_assembly_state = PipelineInputAssemblyBuilder{}.topology_(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST).build(),
     .rasterizer_state = PipelineRasterizationStateBuilder{}.cull_mode(VK_CULL_MODE_BACK_BIT).build(),
@@ -193,12 +194,18 @@ void GBuffer::start_draw(Frame &frame, VkRect2D render_area, const DefaultRessou
 
   const auto &b = frame.frm->get_buffer_ressource(pass_info.inputs.buffers[0]);
   const VkDescriptorBufferInfo buffer_info{b.buffer, 0, b.size};
+  const auto &instances = frame.frm->get_buffer_ressource(pass_info.inputs.buffers[1]);
+  const VkDescriptorBufferInfo instances_info{instances.buffer, 0, instances.size};
 
   const auto camera_descriptor = frame.allocate_descriptor(pass_info.descriptor_set_layouts[0]);
   DescriptorUpdater{camera_descriptor, 0}
       .type(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
       .buffer_info({&buffer_info, 1})
       .write(frame.ctx->ctx.device.vk_device);
+  DescriptorUpdater{camera_descriptor, 1}
+      .type(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+      .buffer_info({&instances_info, 1})
+      .write(frame.ctx->ctx.device.vk_device);
 
   vkCmdBindDescriptorSets(frame.cmd.vk_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pass_info.pipeline_layout, 0, 1,
                           &camera_descriptor, 0, nullptr);
@@ -224,42 +231,51 @@ void GBuffer::start_draw(Frame &frame, VkRect2D render_area, const DefaultRessou
                           descrs.size(), descrs.data(), 0, nullptr);
 }
 
-void GBuffer::draw_mesh(Frame &frame, const Frustum &frustum, const Mesh &mesh,
-                        const DefaultRessources &default_ressources) const {
-  const VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(frame.cmd.vk_cmd, 0, 1, &mesh.buffers.vertices.buffer, &offset);
-  if (mesh.buffers.indices) {
-    vkCmdBindIndexBuffer(frame.cmd.vk_cmd, mesh.buffers.indices->buffer, 0, VK_INDEX_TYPE_UINT32);
+void GBuffer::draw_mesh(Frame &frame, GeometryBinder &binder, InstanceWriter &instances,
+                        std::span<const MeshletCulling::View> views, float lod_threshold, const Mesh &mesh,
+                        const DefaultRessources &default_ressources, std::vector<std::vector<uint32_t>> &levels,
+                        std::vector<IndexRange> &ranges) const {
+  binder.bind(mesh.geometry);
+  for (const auto &surface : mesh.surfaces) {
+    culling_stats.scene_triangles += surface.count / 3 * mesh.instances.size();
   }
 
-  vkCmdPushConstants(frame.cmd.vk_cmd, pass_info.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4),
-                     &mesh.transform);
+  // One instanced draw per surface and per level of detail in use, the instances of a level are written once and
+  // shared by every surface
+  InstanceCulling::filter(views, mesh, lod_threshold, levels);
+  for (uint32_t level = 0; level < levels.size(); level++) {
+    const auto drawn = instances.push(mesh, levels[level]);
+    if (drawn.count == 0) {
+      continue;
+    }
+    for (const auto &surface : mesh.surfaces) {
+      ranges.clear();
+      InstanceCulling::ranges(views, levels[level], mesh, surface, level, ranges);
+      if (ranges.empty()) {
+        continue;
+      }
 
-  int i = 0;
-  std::span<const GeoSurface> const surfaces = mesh.surfaces;
-  for (const auto &surface : FrustrumCulling::filter(frustum, surfaces)) {
-    i++;
-    const struct {
-      uint32_t albedo_idx;
-      uint32_t normal_idx;
-      uint32_t metallic_roughness_idx;
-    } idx{
-        .albedo_idx = frame.frm->image_index(surface.material.albedo_handle),
-        .normal_idx =
-            frame.frm->image_index(surface.material.normal_handle.value_or(default_ressources.normal_map_handle)),
-        .metallic_roughness_idx = frame.frm->image_index(
-            surface.material.metallic_roughness_handle.value_or(default_ressources.metallic_roughness_handle)),
-    };
-    vkCmdPushConstants(frame.cmd.vk_cmd, pass_info.pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4x4),
-                       sizeof(idx), &idx);
+      const struct {
+        uint32_t albedo_idx;
+        uint32_t normal_idx;
+        uint32_t metallic_roughness_idx;
+      } idx{
+          .albedo_idx =
+              frame.frm->image_index(surface.material.albedo_handle.value_or(default_ressources.albedo_handle)),
+          .normal_idx =
+              frame.frm->image_index(surface.material.normal_handle.value_or(default_ressources.normal_map_handle)),
+          .metallic_roughness_idx = frame.frm->image_index(
+              surface.material.metallic_roughness_handle.value_or(default_ressources.metallic_roughness_handle)),
+      };
+      vkCmdPushConstants(frame.cmd.vk_cmd, pass_info.pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(idx),
+                         &idx);
 
-    if (mesh.buffers.indices) {
-      vkCmdDrawIndexed(frame.cmd.vk_cmd, surface.count, 1, surface.start, 0, 0);
-    } else {
-      vkCmdDraw(frame.cmd.vk_cmd, surface.count, 1, surface.start, 0);
+      for (const auto &range : ranges) {
+        vkCmdDrawIndexed(frame.cmd.vk_cmd, range.count, drawn.count, mesh.geometry.first_index() + range.start,
+                         mesh.geometry.vertex_offset(), drawn.first);
+        culling_stats.submitted_triangles += range.count / 3 * drawn.count;
+      }
     }
   }
-
-  spdlog::trace("surface drawn: {}", i);
 }
 }  // namespace tr::renderer
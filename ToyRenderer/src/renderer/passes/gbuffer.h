@@ -2,12 +2,18 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <cmath>
+#include <span>
+#include <vector>
+
 #include "../../camera.h"
 #include "../buffer.h"
 #include "../debug.h"
 #include "../frame.h"
+#include "../geometry_buffer.h"
 #include "../ressource_definition.h"
 #include "frustrum_culling.h"
+#include "instancing.h"
 #include "pass.h"
 
 namespace tr::renderer {
@@ -22,6 +28,8 @@ namespace tr::renderer {
 struct GBuffer {
   PassInfo pass_info;
   VkPipeline pipeline = VK_NULL_HANDLE;
+  // Of the last draw
+  mutable CullingStats culling_stats;
 
   void init(Lifetime &lifetime, VulkanContext &ctx, RessourceManager &rm, Lifetime &setup_lifetime);
 
@@ -29,24 +37,45 @@ struct GBuffer {
   void end_draw(VkCommandBuffer cmd) const;
 
   template <utils::types::range_of<const Mesh &> Range>
-  void draw(Frame &frame, VkRect2D render_area, const Camera &cam, Range meshes,
+  void draw(Frame &frame, VkRect2D render_area, const Camera &cam, const GeometryBuffer &geometry, Range meshes,
             DefaultRessources default_ressources) const {
     const DebugCmdScope scope(frame.cmd.vk_cmd, "GBuffer");
 
     start_draw(frame, render_area, default_ressources);
+    culling_stats = {};
 
     // TODO: not needed every frame ! only when camera changes
     auto fr = Frustum::from_camera(cam);
     const auto camInfo = cam.cameraInfo();
+    const auto pixels_per_unit = static_cast<float>(render_area.extent.height) / (2.F * std::tan(cam.fovy / 2.F));
+    const auto lod_threshold = lod_pixel_threshold.resolve();
 
+    GeometryBinder binder{frame.cmd.vk_cmd, geometry};
+    auto instances = InstanceWriter::from(frame.frm->get_buffer_ressource(pass_info.inputs.buffers[1]));
+    // Kept from one mesh to the next
+    std::vector<MeshletCulling::View> views;
+    std::vector<std::vector<uint32_t>> levels;
+    std::vector<IndexRange> ranges;
     for (const auto &mesh : meshes) {
-      draw_mesh(frame, fr.transform(camInfo.viewMatrix * mesh.transform), mesh, default_ressources);
+      // Not in any resident cell, it has no geometry either
+      if (mesh.instances.empty()) {
+        continue;
+      }
+      views.clear();
+      for (const auto &instance : mesh.instances) {
+        views.push_back(MeshletCulling::View::from(fr, {0, 0, 0, 1}, camInfo.viewMatrix * instance, pixels_per_unit));
+      }
+      draw_mesh(frame, binder, instances, views, lod_threshold, mesh, default_ressources, levels, ranges);
     }
+    culling_stats.dropped_instances = instances.dropped;
     end_draw(frame.cmd.vk_cmd);
   }
 
-  void draw_mesh(Frame &frame, const Frustum &frustum, const Mesh &mesh,
-                 const DefaultRessources &default_ressources) const;
+  // views[i] is the view of mesh.instances[i], levels and ranges are scratch space
+  void draw_mesh(Frame &frame, GeometryBinder &binder, InstanceWriter &instances,
+                 std::span<const MeshletCulling::View> views, float lod_threshold, const Mesh &mesh,
+                 const DefaultRessources &default_ressources, std::vector<std::vector<uint32_t>> &levels,
+                 std::vector<IndexRange> &ranges) const;
 };
 
 }  // namespace tr::renderer
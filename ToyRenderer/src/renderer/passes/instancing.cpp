@@ -0,0 +1,75 @@
+#include "instancing.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <span>
+#include <vector>
+
+#include "../mesh.h"
+#include "../ressources.h"
+#include "frustrum_culling.h"
+#include "utils/assert.h"
+#include "utils/cast.h"
+
+namespace tr::renderer {
+
+void InstanceCulling::filter(std::span<const MeshletCulling::View> views, const Mesh& mesh, float threshold,
+                             std::vector<std::vector<uint32_t>>& levels) {
+  // Buckets are kept from one mesh to the next so that they don't get allocated again
+  levels.resize(std::max<std::size_t>(levels.size(), mesh.lod_errors.size() + 1));
+  for (auto& level : levels) {
+    level.clear();
+  }
+  for (std::size_t i = 0; i < views.size(); i++) {
+    if (FrustrumCulling::filter_one(views[i].frustum, mesh.bounding_box)) {
+      levels[LodSelection::select(views[i], mesh, threshold)].push_back(utils::narrow_cast<uint32_t>(i));
+    }
+  }
+}
+
+void InstanceCulling::ranges(std::span<const MeshletCulling::View> views, std::span<const uint32_t> bucket,
+                             const Mesh& mesh, const GeoSurface& surface, uint32_t level,
+                             std::vector<IndexRange>& ranges) {
+  // Surfaces with fewer levels than the mesh stay on their coarsest one
+  level = std::min(level, surface.lod_count);
+  // The mesh is visible, a lone instance can still skip the surfaces it does not see
+  if (bucket.size() == 1 && !FrustrumCulling::filter_one(views[bucket[0]].frustum, surface.bounding_box)) {
+    return;
+  }
+  if (level == 0) {
+    // Meshlets are culled per instance, with several of them each one would need its own ranges
+    if (bucket.size() == 1) {
+      MeshletCulling::filter(views[bucket[0]],
+                             std::span(mesh.meshlets).subspan(surface.first_meshlet, surface.meshlet_count), ranges);
+    } else {
+      ranges.push_back({surface.start, surface.count});
+    }
+    return;
+  }
+  // Levels are not split into meshlets, they are only picked far away where they would not cull much anyway
+  const auto& lod = mesh.lods[surface.first_lod + level - 1];
+  ranges.push_back({lod.start, lod.count});
+}
+
+auto InstanceWriter::from(const BufferRessource& buffer) -> InstanceWriter {
+  TR_ASSERT(buffer.mapped_data != nullptr, "instances are not mapped");
+  return {
+      .transforms = {static_cast<glm::mat4x4*>(buffer.mapped_data), buffer.size / sizeof(glm::mat4x4)},
+      .count = 0,
+      .dropped = 0,
+  };
+}
+
+auto InstanceWriter::push(const Mesh& mesh, std::span<const uint32_t> bucket) -> InstanceRange {
+  const auto first = count;
+  const auto fitting = std::min(bucket.size(), transforms.size() - count);
+  for (std::size_t i = 0; i < fitting; i++) {
+    transforms[count++] = mesh.instances[bucket[i]];
+  }
+  dropped += bucket.size() - fitting;
+  return {first, count - first};
+}
+
+}  // namespace tr::renderer
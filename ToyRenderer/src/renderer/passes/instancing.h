@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <span>
+#include <vector>
+
+#include "frustrum_culling.h"
+
+namespace tr::renderer {
+struct BufferRessource;
+struct GeoSurface;
+struct Mesh;
+
+struct InstanceCulling {
+  // Buckets the visible instances of mesh by level of detail, each bucket is then one instanced draw per surface
+  // views[i] is the view of mesh.instances[i], levels[l] gets the indices into views drawn at level l
+  static void filter(std::span<const MeshletCulling::View> views, const Mesh& mesh, float threshold,
+                     std::vector<std::vector<uint32_t>>& levels);
+
+  // Appends what a bucket of level draws of surface: the visible meshlets when it is a lone instance at full detail,
+  // nothing when that instance does not see the surface, the whole level of the surface otherwise
+  static void ranges(std::span<const MeshletCulling::View> views, std::span<const uint32_t> bucket, const Mesh& mesh,
+                     const GeoSurface& surface, uint32_t level, std::vector<IndexRange>& ranges);
+};
+
+// Instances of an instanced draw, firstInstance and instanceCount
+struct InstanceRange {
+  uint32_t first;
+  uint32_t count;
+};
+
+// Fills the mapped buffer of world matrices that the vertex shader reads with gl_InstanceIndex
+struct InstanceWriter {
+  std::span<glm::mat4x4> transforms;
+  uint32_t count = 0;
+  // Instances that did not fit
+  std::size_t dropped = 0;
+
+  static auto from(const BufferRessource& buffer) -> InstanceWriter;
+
+  // Copies the world matrices of mesh.instances[i] for every i of bucket, those that do not fit are dropped
+  auto push(const Mesh& mesh, std::span<const uint32_t> bucket) -> InstanceRange;
+};
+
+}  // namespace tr::renderer
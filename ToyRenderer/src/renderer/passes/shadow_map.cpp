@@ -9,9 +9,9 @@
 #include <algorithm>            // for copy, max
 #include <array>                // for array, to_array
 #include <format>               // for format
-#include <glm/fwd.hpp>          // for mat4x4
 #include <optional>             // for optional
 #include <shaderc/shaderc.hpp>  // for CompileOptions, Compiler
+#include <span>                 // for span
 #include <utility>              // for pair
 #include <vector>               // for vector
 
@@ -24,13 +24,16 @@
 #include "../descriptors.h"           // for DescriptorSetLayoutBuilder, Des...
 #include "../device.h"                // for Device
 #include "../frame.h"                 // for Frame
-#include "../mesh.h"                  // for GeoSurface, Mesh, Vertex, Direc...
+#include "../geometry_buffer.h"       // for GeometryBinder, GeometryBuffer
+#include "../mesh.h"                  // for GeoSurface, Mesh, VertexPosition...
 #include "../pipeline.h"              // for PipelineBuilder, PipelineLayout...
 #include "../ressource_definition.h"  // for SHADOW_MAP, shadow_map_extent
 #include "../ressource_manager.h"     // for FrameRessourceData, RessourceMa...
 #include "../ressources.h"            // for BufferRessource, ImageRessource
 #include "../synchronisation.h"       // for SyncLateDepth, ImageMemoryBarrier
 #include "../vulkan_engine.h"         // for VulkanEngine
+#include "frustrum_culling.h"         // for IndexRange, MeshletCulling, Frustum
+#include "instancing.h"               // for InstanceCulling, InstanceWriter
 #include "utils/types.h"              // for not_null_pointer
 
 void tr::renderer::ShadowMap::init(Lifetime &lifetime, VulkanContext &ctx, RessourceManager &rm,
@@ -42,6 +45,7 @@ void tr::renderer::ShadowMap::init(Lifetime &lifetime, VulkanContext &ctx, Resso
   rendered_handle = rm.register_transient_image(RENDERED);
   shadow_map_handle = rm.register_transient_image(SHADOW_MAP);
   shadow_camera_handle = rm.register_buffer(SHADOW_CAMERA);
+  shadow_instances_handle = rm.register_buffer(SHADOW_INSTANCES);
 
   shaderc::Compiler compiler;
   shaderc::CompileOptions options;
@@ -67,8 +71,10 @@ void tr::renderer::ShadowMap::init(Lifetime &lifetime, VulkanContext &ctx, Resso
   };
   const auto dynamic_state_state = PipelineDynamicStateBuilder{}.dynamic_state(dynamic_states).build();
 
-  const auto vertex_input_state =
-      PipelineVertexInputStateBuilder{}.vertex_attributes(Vertex::attributes).vertex_bindings(Vertex::bindings).build();
+  const auto vertex_input_state = PipelineVertexInputStateBuilder{}
+                                      .vertex_attributes(VertexInput<VertexPosition>::attributes)
+                                      .vertex_bindings(VertexInput<VertexPosition>::bindings)
+                                      .build();
 
   const auto input_assembly_state =
       PipelineInputAssemblyBuilder{}.topology_(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST).build();
@@ -83,18 +89,7 @@ void tr::renderer::ShadowMap::init(Lifetime &lifetime, VulkanContext &ctx, Resso
   descriptor_set_layouts = std::to_array({
       tr::renderer::DescriptorSetLayoutBuilder{}.bindings(tr::renderer::ShadowMap::set_0).build(ctx.device.vk_device),
   });
-  const auto push_constant_ranges = std::to_array<VkPushConstantRange>({
-      {
-          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-          .offset = 0,
-          .size = sizeof(glm::mat4x4),
-      },
-  });
-
-  pipeline_layout = PipelineLayoutBuilder{}
-                        .set_layouts(descriptor_set_layouts)
-                        .push_constant_ranges(push_constant_ranges)
-                        .build(ctx.device.vk_device);
+  pipeline_layout = PipelineLayoutBuilder{}.set_layouts(descriptor_set_layouts).build(ctx.device.vk_device);
   pipeline = PipelineBuilder{}
                  .stages(shader_stages)
                  .layout_(pipeline_layout)
@@ -157,46 +152,91 @@ void tr::renderer::ShadowMap::start_draw(Frame &frame) const {
   vkCmdBindPipeline(frame.cmd.vk_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 }
 
-void tr::renderer::ShadowMap::draw_mesh(Frame &frame, const Mesh &mesh) const {
-  const VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(frame.cmd.vk_cmd, 0, 1, &mesh.buffers.vertices.buffer, &offset);
-  if (mesh.buffers.indices) {
-    vkCmdBindIndexBuffer(frame.cmd.vk_cmd, mesh.buffers.indices->buffer, 0, VK_INDEX_TYPE_UINT32);
+void tr::renderer::ShadowMap::draw_mesh(Frame &frame, GeometryBinder &binder, InstanceWriter &instances,
+                                        std::span<const MeshletCulling::View> views, float lod_threshold,
+                                        const Mesh &mesh, std::vector<std::vector<uint32_t>> &levels,
+                                        std::vector<IndexRange> &ranges) const {
+  for (const auto &surface : mesh.surfaces) {
+    culling_stats.scene_triangles += surface.count / 3 * mesh.instances.size();
   }
 
-  vkCmdPushConstants(frame.cmd.vk_cmd, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4),
-                     &mesh.transform);
-
-  for (const auto &surface : mesh.surfaces) {
-    if (mesh.buffers.indices) {
-      vkCmdDrawIndexed(frame.cmd.vk_cmd, surface.count, 1, surface.start, 0, 0);
-    } else {
-      vkCmdDraw(frame.cmd.vk_cmd, surface.count, 1, surface.start, 0);
+  // Materials don't matter here, one instanced draw per surface and per level of detail in use, the instances of a
+  // level are written once and shared by every surface
+  InstanceCulling::filter(views, mesh, lod_threshold, levels);
+  bool bound = false;
+  for (uint32_t level = 0; level < levels.size(); level++) {
+    const auto drawn = instances.push(mesh, levels[level]);
+    if (drawn.count == 0) {
+      continue;
+    }
+    if (!bound) {
+      binder.bind(mesh.geometry);
+      bound = true;
+    }
+    for (const auto &surface : mesh.surfaces) {
+      ranges.clear();
+      InstanceCulling::ranges(views, levels[level], mesh, surface, level, ranges);
+      for (const auto &range : ranges) {
+        vkCmdDrawIndexed(frame.cmd.vk_cmd, range.count, drawn.count, mesh.geometry.first_index() + range.start,
+                         mesh.geometry.vertex_offset(), drawn.first);
+        culling_stats.submitted_triangles += range.count / 3 * drawn.count;
+      }
     }
   }
 }
-void tr::renderer::ShadowMap::draw(Frame &frame, const DirectionalLight &light, std::span<const Mesh> meshes) const {
+void tr::renderer::ShadowMap::draw(Frame &frame, const DirectionalLight &light, const GeometryBuffer &geometry,
+                                   std::span<const Mesh> meshes) const {
   const DebugCmdScope scope(frame.cmd.vk_cmd, "Shadow map");
 
   start_draw(frame);
+  culling_stats = {};
 
+  const auto light_info = light.camera_info();
   frame.frm->update_buffer<CameraInfo>(frame.ctx->allocator, shadow_camera_handle,
-                                       [&](CameraInfo *info) { *info = light.camera_info(); });
+                                       [&](CameraInfo *info) { *info = light_info; });
 
   const auto &b = frame.frm->get_buffer_ressource(shadow_camera_handle);
   const VkDescriptorBufferInfo buffer_info{b.buffer, 0, b.size};
+  const auto &instances_buffer = frame.frm->get_buffer_ressource(shadow_instances_handle);
+  const VkDescriptorBufferInfo instances_info{instances_buffer.buffer, 0, instances_buffer.size};
   const auto camera_descriptor = frame.allocate_descriptor(descriptor_set_layouts[0]);
   DescriptorUpdater{camera_descriptor, 0}
       .type(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
       .buffer_info({&buffer_info, 1})
       .write(frame.ctx->ctx.device.vk_device);
+  DescriptorUpdater{camera_descriptor, 1}
+      .type(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+      .buffer_info({&instances_info, 1})
+      .write(frame.ctx->ctx.device.vk_device);
 
   vkCmdBindDescriptorSets(frame.cmd.vk_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &camera_descriptor,
                           0, nullptr);
 
+  const auto frustum = Frustum::from_ortho(DirectionalLight::half_extent, DirectionalLight::half_extent,
+                                           DirectionalLight::z_near, DirectionalLight::z_far);
+  const auto pixels_per_unit =
+      static_cast<float>(shadow_map_extent.resolve().height) / (2.F * DirectionalLight::half_extent);
+  const auto lod_threshold = lod_shadow_pixel_threshold.resolve();
+
+  GeometryBinder binder{frame.cmd.vk_cmd, geometry, VertexStreams::Positions};
+  auto instances = InstanceWriter::from(instances_buffer);
+  // Kept from one mesh to the next
+  std::vector<MeshletCulling::View> views;
+  std::vector<std::vector<uint32_t>> levels;
+  std::vector<IndexRange> ranges;
   for (const auto &mesh : meshes) {
-    draw_mesh(frame, mesh);
+    // Not in any resident cell, it has no geometry either
+    if (mesh.instances.empty()) {
+      continue;
+    }
+    views.clear();
+    for (const auto &instance : mesh.instances) {
+      views.push_back(
+          MeshletCulling::View::from(frustum, {0, 0, 1, 0}, light_info.viewMatrix * instance, pixels_per_unit));
+    }
+    draw_mesh(frame, binder, instances, views, lod_threshold, mesh, levels, ranges);
   }
+  culling_stats.dropped_instances = instances.dropped;
   end_draw(frame.cmd.vk_cmd);
 }
 
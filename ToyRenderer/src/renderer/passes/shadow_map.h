@@ -5,8 +5,11 @@
 
 #include <array>
 #include <span>
+#include <vector>
 
 #include "../descriptors.h"
+#include "frustrum_culling.h"
+#include "instancing.h"
 #include "utils/cast.h"
 
 namespace tr {
@@ -15,6 +18,8 @@ class RessourceManager;
 enum class buffer_ressource_handle : uint32_t;
 struct DirectionalLight;
 struct Frame;
+class GeometryBinder;
+class GeometryBuffer;
 struct Lifetime;
 struct Mesh;
 enum class image_ressource_handle : uint32_t;
@@ -32,6 +37,9 @@ struct ShadowMap {
   image_ressource_handle rendered_handle{};
   image_ressource_handle shadow_map_handle{};
   buffer_ressource_handle shadow_camera_handle{};
+  buffer_ressource_handle shadow_instances_handle{};
+  // Of the last draw
+  mutable CullingStats culling_stats;
 
   static constexpr std::array set_0 = utils::to_array({
       DescriptorSetLayoutBindingBuilder{}
@@ -40,6 +48,12 @@ struct ShadowMap {
           .descriptor_count(1)
           .stages(VK_SHADER_STAGE_VERTEX_BIT)
           .build(),
+      DescriptorSetLayoutBindingBuilder{}
+          .binding_(1)
+          .descriptor_type(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+          .descriptor_count(1)
+          .stages(VK_SHADER_STAGE_VERTEX_BIT)
+          .build(),
   });
 
   void init(Lifetime &lifetime, VulkanContext &ctx, RessourceManager &rm, Lifetime &setup_lifetime);
@@ -47,9 +61,13 @@ struct ShadowMap {
   void start_draw(Frame &frame) const;
   void end_draw(VkCommandBuffer cmd) const;
 
-  void draw(Frame &frame, const DirectionalLight &light, std::span<const Mesh> meshes) const;
+  void draw(Frame &frame, const DirectionalLight &light, const GeometryBuffer &geometry,
+            std::span<const Mesh> meshes) const;
 
-  void draw_mesh(Frame &frame, const Mesh &mesh) const;
+  // views[i] is the view of mesh.instances[i], levels and ranges are scratch space
+  void draw_mesh(Frame &frame, GeometryBinder &binder, InstanceWriter &instances,
+                 std::span<const MeshletCulling::View> views, float lod_threshold, const Mesh &mesh,
+                 std::vector<std::vector<uint32_t>> &levels, std::vector<IndexRange> &ranges) const;
 
   void imgui(RessourceManager &rm) const;
 };
@@ -3,8 +3,10 @@
 #include <vulkan/vulkan_core.h>
 
 #include <cstddef>
+#include <cstdint>
 #include <span>
 
+#include "utils/assert.h"
 #include "utils/cast.h"
 namespace tr::renderer {
 
@@ -20,6 +22,14 @@ struct QueueSubmit {
       .signalSemaphoreCount = 0,
       .pSignalSemaphores = nullptr,
   };
+  VkTimelineSemaphoreSubmitInfo timeline_info{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreValueCount = 0,
+      .pWaitSemaphoreValues = nullptr,
+      .signalSemaphoreValueCount = 0,
+      .pSignalSemaphoreValues = nullptr,
+  };
 
   template <const std::size_t N>
   auto wait_semaphores(std::span<const VkSemaphore, N> semaphores,
@@ -30,18 +40,47 @@ struct QueueSubmit {
     return *this;
   }
 
+  auto wait_semaphores(std::span<const VkSemaphore> semaphores,
+                       std::span<const VkPipelineStageFlags> wait_dst_stage_mask) -> QueueSubmit& {
+    TR_ASSERT(semaphores.size() == wait_dst_stage_mask.size(), "one stage mask per semaphore is needed");
+    submit_info.waitSemaphoreCount = utils::narrow_cast<uint32_t>(semaphores.size());
+    submit_info.pWaitSemaphores = semaphores.data();
+    submit_info.pWaitDstStageMask = wait_dst_stage_mask.data();
+    return *this;
+  }
+
   auto signal_semaphores(std::span<const VkSemaphore> semaphores) -> QueueSubmit& {
     submit_info.signalSemaphoreCount = utils::narrow_cast<uint32_t>(semaphores.size());
     submit_info.pSignalSemaphores = semaphores.data();
     return *this;
   }
 
+  // One value per waited semaphore, binary semaphores ignore theirs
+  auto wait_values(std::span<const uint64_t> values) -> QueueSubmit& {
+    TR_ASSERT(values.size() == submit_info.waitSemaphoreCount, "one value per waited semaphore is needed");
+    timeline_info.waitSemaphoreValueCount = utils::narrow_cast<uint32_t>(values.size());
+    timeline_info.pWaitSemaphoreValues = values.data();
+    return *this;
+  }
+
+  // One value per signaled semaphore, binary semaphores ignore theirs
+  auto signal_values(std::span<const uint64_t> values) -> QueueSubmit& {
+    TR_ASSERT(values.size() == submit_info.signalSemaphoreCount, "one value per signaled semaphore is needed");
+    timeline_info.signalSemaphoreValueCount = utils::narrow_cast<uint32_t>(values.size());
+    timeline_info.pSignalSemaphoreValues = values.data();
+    return *this;
+  }
+
   auto command_buffers(std::span<const VkCommandBuffer> buffers) -> QueueSubmit& {
     submit_info.pCommandBuffers = buffers.data();
     submit_info.commandBufferCount = utils::narrow_cast<uint32_t>(buffers.size());
     return *this;
   }
 
-  auto submit(VkQueue queue, VkFence fence) -> VkResult { return vkQueueSubmit(queue, 1, &submit_info, fence); }
+  auto submit(VkQueue queue, VkFence fence) -> VkResult {
+    const bool timeline = timeline_info.waitSemaphoreValueCount != 0 || timeline_info.signalSemaphoreValueCount != 0;
+    submit_info.pNext = timeline ? &timeline_info : nullptr;
+    return vkQueueSubmit(queue, 1, &submit_info, fence);
+  }
 };
 }  // namespace tr::renderer
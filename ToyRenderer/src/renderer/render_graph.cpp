@@ -1,9 +1,11 @@
 #include "render_graph.h"
 
 #include <imgui.h>
+#include <spdlog/spdlog.h>
 #include <vulkan/vulkan_core.h>
 
 #include <array>
+#include <format>
 #include <glm/fwd.hpp>
 #include <glm/geometric.hpp>
 #include <glm/mat4x4.hpp>
@@ -14,9 +16,11 @@
 #include "deletion_stack.h"
 #include "device.h"
 #include "frame.h"
+#include "geometry_buffer.h"
 #include "mesh.h"
 #include "passes/debug.h"
 #include "passes/shadow_map.h"
+#include "ressource_definition.h"
 #include "ressource_manager.h"
 #include "ressources.h"
 #include "synchronisation.h"
@@ -26,7 +30,8 @@
 #include "utils/types.h"
 #include "vulkan_engine.h"
 
-void tr::renderer::RenderGraph::draw(Frame& frame, std::span<const Mesh> meshes, const Camera& camera) const {
+void tr::renderer::RenderGraph::draw(Frame& frame, const GeometryBuffer& geometry, std::span<const Mesh> meshes,
+                                     const Camera& camera) const {
   frame.write_cpu_timestamp(CPU_TIMESTAMP_INDEX_DRAW_TOP);
   auto internal_extent = frame.frm->get_image_ressource(rendered_handle).extent;
   auto swapchain_extent = frame.frm->get_image_ressource(swapchain_handle).extent;
@@ -36,7 +41,7 @@ void tr::renderer::RenderGraph::draw(Frame& frame, std::span<const Mesh> meshes,
 
   frame.write_gpu_timestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GPU_TIMESTAMP_INDEX_TOP);
 
-  passes.gbuffer.draw(frame, {{0, 0}, internal_extent}, camera, meshes, default_ressources);
+  passes.gbuffer.draw(frame, {{0, 0}, internal_extent}, camera, geometry, meshes, default_ressources);
 
   frame.write_cpu_timestamp(CPU_TIMESTAMP_INDEX_GBUFFER_BOTTOM);
   frame.write_gpu_timestamp(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, GPU_TIMESTAMP_INDEX_GBUFFER_BOTTOM);
@@ -47,7 +52,7 @@ void tr::renderer::RenderGraph::draw(Frame& frame, std::span<const Mesh> meshes,
           .color = {2, 2, 2},
       },
   });
-  passes.shadow_map.draw(frame, lights[0], meshes);
+  passes.shadow_map.draw(frame, lights[0], geometry, meshes);
 
   frame.write_cpu_timestamp(CPU_TIMESTAMP_INDEX_SHADOW_BOTTOM);
   frame.write_gpu_timestamp(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, GPU_TIMESTAMP_INDEX_SHADOW_BOTTOM);
@@ -55,7 +60,7 @@ void tr::renderer::RenderGraph::draw(Frame& frame, std::span<const Mesh> meshes,
   passes.ssao.draw(frame, {{0, 0}, internal_extent});
   passes.deferred.draw(frame, {{0, 0}, internal_extent}, lights);
 
-  /* passes.forward.draw(frame, {{0, 0}, internal_extent}, camera, meshes, lights, default_ressources); */
+  /* passes.forward.draw(frame, {{0, 0}, internal_extent}, camera, geometry, meshes, lights, default_ressources); */
 
   Debug::global().draw(frame, {{0, 0}, internal_extent});
 
@@ -88,31 +93,49 @@ void tr::renderer::RenderGraph::init(tr::renderer::VulkanEngine& engine, Transfe
   shadow_camera_handle = engine.rm.register_transient_buffer(SHADOW_CAMERA);
 
   {
-    const VkSamplerCreateInfo sampler_create_info{
-        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .magFilter = VK_FILTER_LINEAR,
-        .minFilter = VK_FILTER_LINEAR,
-        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-        .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-        .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-        .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-        .mipLodBias = 0,
-        .anisotropyEnable = VK_FALSE,
-        .maxAnisotropy = 0,
-        .compareEnable = VK_FALSE,
-        .compareOp = VK_COMPARE_OP_NEVER,
-        .minLod = 0,
-        .maxLod = 0,
-        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
-        .unnormalizedCoordinates = VK_FALSE,
+    const auto create_sampler = [&](float max_lod) {
+      const VkSamplerCreateInfo sampler_create_info{
+          .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .magFilter = VK_FILTER_LINEAR,
+          .minFilter = VK_FILTER_LINEAR,
+          .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+          .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+          .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+          .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+          .mipLodBias = 0,
+          .anisotropyEnable = VK_FALSE,
+          .maxAnisotropy = 0,
+          .compareEnable = VK_FALSE,
+          .compareOp = VK_COMPARE_OP_NEVER,
+          .minLod = 0,
+          .maxLod = max_lod,
+          .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+          .unnormalizedCoordinates = VK_FALSE,
+      };
+      VkSampler sampler = VK_NULL_HANDLE;
+      VK_UNWRAP(vkCreateSampler, engine.ctx.device.vk_device, &sampler_create_info, nullptr, &sampler);
+      engine.lifetime.global.tie(DeviceHandle::Sampler, sampler);
+      return sampler;
     };
-    VK_UNWRAP(vkCreateSampler, engine.ctx.device.vk_device, &sampler_create_info, nullptr, &default_ressources.sampler);
-    engine.lifetime.global.tie(DeviceHandle::Sampler, default_ressources.sampler);
+
+    mipmapped_sampler = create_sampler(VK_LOD_CLAMP_NONE);
+    base_level_sampler = create_sampler(0);
+    default_ressources.sampler = sample_mipmaps ? mipmapped_sampler : base_level_sampler;
   }
 
   {
+    default_ressources.albedo = engine.image_builder().build_image({
+        .flags = 0,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .size = {StaticExtent{1, 1}},
+        .format = {StaticFormat{VK_FORMAT_R8G8B8A8_UNORM}},
+        .debug_name = "default albedo_texture",
+    });
+    default_ressources.albedo_handle = engine.rm.register_storage_image(default_ressources.albedo);
+    default_ressources.albedo.tie(engine.lifetime.global);
+
     default_ressources.metallic_roughness = engine.image_builder().build_image({
         .flags = 0,
         .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
@@ -128,34 +151,38 @@ void tr::renderer::RenderGraph::init(tr::renderer::VulkanEngine& engine, Transfe
         .flags = 0,
         .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .size = {StaticExtent{1, 1}},
-        .format = {StaticFormat{VK_FORMAT_R32G32B32A32_SFLOAT}},
+        .format = {StaticFormat{VK_FORMAT_R8G8_UNORM}},
         .debug_name = "default normal_texture",
     });
     default_ressources.normal_map_handle = engine.rm.register_storage_image(default_ressources.normal_map);
     default_ressources.normal_map.tie(engine.lifetime.global);
 
-    ImageMemoryBarrier::submit<2>(
+    ImageMemoryBarrier::submit<3>(
         t.cmd.vk_cmd, {{
+                          default_ressources.albedo.prepare_barrier(tr::renderer::SyncImageTransfer),
                           default_ressources.metallic_roughness.prepare_barrier(tr::renderer::SyncImageTransfer),
                           default_ressources.normal_map.prepare_barrier(tr::renderer::SyncImageTransfer),
                       }});
 
     {
       std::array<uint8_t, 4> data{0xFF, 0xFF, 0xFF, 0xFF};
-      t.upload_image(default_ressources.metallic_roughness, {{0, 0}, {1, 1}}, std::as_bytes(std::span(data)), 2);
+      t.upload_image(default_ressources.albedo, {{0, 0}, {1, 1}}, std::as_bytes(std::span(data)));
+    }
+
+    {
+      std::array<uint8_t, 2> data{0xFF, 0xFF};
+      t.upload_image(default_ressources.metallic_roughness, {{0, 0}, {1, 1}}, std::as_bytes(std::span(data)));
     }
 
     {
-      std::array<float, 4> data{0.0, 0.0, 1.0, 0.0};
-      t.upload_image(default_ressources.normal_map, {{0, 0}, {1, 1}}, std::as_bytes(std::span(data)), 16);
+      // Only xy are stored, z is reconstructed: this is a flat (0, 0, 1) normal
+      std::array<uint8_t, 2> data{0x80, 0x80};
+      t.upload_image(default_ressources.normal_map, {{0, 0}, {1, 1}}, std::as_bytes(std::span(data)));
     }
 
-    tr::renderer::ImageMemoryBarrier::submit<2>(
-        t.graphics_cmd.vk_cmd,
-        {{
-            default_ressources.metallic_roughness.prepare_barrier(tr::renderer::SyncFragmentShaderReadOnly),
-            default_ressources.normal_map.prepare_barrier(tr::renderer::SyncFragmentShaderReadOnly),
-        }});
+    t.hand_over(default_ressources.albedo, tr::renderer::SyncFragmentShaderReadOnly);
+    t.hand_over(default_ressources.metallic_roughness, tr::renderer::SyncFragmentShaderReadOnly);
+    t.hand_over(default_ressources.normal_map, tr::renderer::SyncFragmentShaderReadOnly);
   }
 }
 
@@ -170,6 +197,40 @@ void tr::renderer::RenderGraph::imgui(VulkanEngine& engine) {
     reinit_passes(engine);
   }
 
+  // Compare the GBuffer GPU time with and without mipmaps, it shows best when looking at the scene from afar
+  if (ImGui::Checkbox("Sample texture mipmaps", &sample_mipmaps)) {
+    default_ressources.sampler = sample_mipmaps ? mipmapped_sampler : base_level_sampler;
+
+    // GPU_TIME_PERIODS[1] is the GBuffer, it has not seen a frame with the new sampler yet
+    gbuffer_ms[sample_mipmaps ? 0 : 1] = engine.debug_info.avg_gpu_timelines[1].state;
+    if (gbuffer_ms[0] && gbuffer_ms[1]) {
+      spdlog::info("GBuffer GPU time: {:.3f}ms with mipmaps, {:.3f}ms without", *gbuffer_ms[1], *gbuffer_ms[0]);
+    }
+  }
+
+  const auto culling_stats = [](const char* pass, const CullingStats& stats) {
+    const auto ratio = stats.scene_triangles == 0 ? 0. : static_cast<double>(stats.submitted_triangles) /
+                                                             static_cast<double>(stats.scene_triangles);
+    ImGui::Text("%s", std::format("{}: {} / {} triangles submitted ({:.0f}%)", pass, stats.submitted_triangles,
+                                  stats.scene_triangles, 100. * ratio)
+                          .c_str());
+    if (stats.dropped_instances != 0) {
+      ImGui::Text("%s", std::format("{}: {} instances dropped", pass, stats.dropped_instances).c_str());
+    }
+  };
+  culling_stats("GBuffer", passes.gbuffer.culling_stats);
+  culling_stats("Shadow map", passes.shadow_map.culling_stats);
+
+  // At 0 only levels that lost nothing are used
+  const auto lod_slider = [](const char* label, const CVarFloat& cvar) {
+    float threshold = cvar.resolve();
+    if (ImGui::SliderFloat(label, &threshold, 0.F, 16.F, "%.1f px")) {
+      cvar.save(threshold);
+    }
+  };
+  lod_slider("LOD threshold", lod_pixel_threshold);
+  lod_slider("Shadow LOD threshold", lod_shadow_pixel_threshold);
+
   passes.shadow_map.imgui(engine.rm);
   if (passes.deferred.imgui()) {
     passes.deferred.init(engine.lifetime.global, engine.ctx, engine.rm, setup_lifetime);
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <vulkan/vulkan_core.h>
+
+#include <array>
 #include <cstdint>
+#include <optional>
 #include <span>
 
 #include "passes/deferred.h"
@@ -16,6 +20,7 @@ namespace renderer {
 class VulkanEngine;
 enum class buffer_ressource_handle : uint32_t;
 struct Frame;
+class GeometryBuffer;
 struct Mesh;
 struct Transferer;
 enum class image_ressource_handle : uint32_t;
@@ -28,7 +33,7 @@ namespace tr::renderer {
 class RenderGraph {
  public:
   void init(VulkanEngine& engine, Transferer& t);
-  void draw(Frame& frame, std::span<const Mesh> meshes, const Camera& camera) const;
+  void draw(Frame& frame, const GeometryBuffer& geometry, std::span<const Mesh> meshes, const Camera& camera) const;
 
   void imgui(VulkanEngine&);
 
@@ -44,6 +49,12 @@ class RenderGraph {
   } passes;
 
   DefaultRessources default_ressources{};
+  // default_ressources.sampler is one of them
+  VkSampler mipmapped_sampler = VK_NULL_HANDLE;
+  VkSampler base_level_sampler = VK_NULL_HANDLE;
+  bool sample_mipmaps = true;
+  // Smoothed GBuffer GPU time in ms, without and with mipmaps, as it was when switching away from it
+  std::array<std::optional<float>, 2> gbuffer_ms{};
 
   image_ressource_handle swapchain_handle{};
   image_ressource_handle rendered_handle{};
@@ -14,9 +14,15 @@ namespace tr::renderer {
 
 CVAR_FLOAT(internal_resolution_scale, 1.0)
 CVAR_EXTENT2D(shadow_map_extent, 1024, 1024)
+// Largest error a level of detail may have on screen, in pixels. Shadows are blurred anyway, they get coarser ones
+CVAR_FLOAT(lod_pixel_threshold, 1.0)
+CVAR_FLOAT(lod_shadow_pixel_threshold, 4.0)
 
+// Bound in place of the textures a material does not have, or does not have yet while the scene streams in
 struct DefaultRessources {
   VkSampler sampler;
+  ImageRessource albedo;
+  image_ressource_handle albedo_handle;
   ImageRessource metallic_roughness;
   image_ressource_handle metallic_roughness_handle;
   ImageRessource normal_map;
@@ -173,4 +179,29 @@ static constexpr BufferRessourceDefinition DEBUG_VERTICES{
         },
     .scope = RessourceScope::Transient,
 };
+
+// World matrices read with gl_InstanceIndex, written while recording the draws
+constexpr uint32_t max_instances = 1 << 16;
+static constexpr BufferRessourceDefinition INSTANCES{
+    .id = BufferRessourceId::Instances,
+    .definition =
+        {
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .size = utils::narrow_cast<uint32_t>(sizeof(glm::mat4x4)) * max_instances,
+            .flags = BUFFER_OPTION_FLAG_CPU_TO_GPU_BIT | BUFFER_OPTION_FLAG_CREATE_MAPPED_BIT,
+            .debug_name = "instances",
+        },
+    .scope = RessourceScope::Transient,
+};
+static constexpr BufferRessourceDefinition SHADOW_INSTANCES{
+    .id = BufferRessourceId::ShadowInstances,
+    .definition =
+        {
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .size = utils::narrow_cast<uint32_t>(sizeof(glm::mat4x4)) * max_instances,
+            .flags = BUFFER_OPTION_FLAG_CPU_TO_GPU_BIT | BUFFER_OPTION_FLAG_CREATE_MAPPED_BIT,
+            .debug_name = "shadow instances",
+        },
+    .scope = RessourceScope::Transient,
+};
 }  // namespace tr::renderer
@@ -89,6 +89,12 @@ auto tr::renderer::RessourceManager::register_storage_image(ImageRessource res)
       .into_handle();
 }
 
+void tr::renderer::RessourceManager::replace_storage_image(image_ressource_handle handle, ImageRessource res) {
+  const auto info = ImageRessourceInfo::from_handle(handle);
+  TR_ASSERT(info.scope == RessourceScope::Storage && info.index < storage_images.size(), "not a storage image");
+  storage_images[info.index] = res;
+}
+
 auto tr::renderer::RessourceManager::register_external_image(ImageRessourceDefinition def) -> image_ressource_handle {
   const auto i =
       find_or_push_back(external_images, def.id, &ImageRessourceDefinition::id, [def](auto& /*id*/) { return def; });
@@ -159,6 +159,8 @@ class RessourceManager {
 
   // Those setup functions should all be idempotent!
   auto register_storage_image(ImageRessource res) -> image_ressource_handle;
+  // Frames acquired from now on get res, the ones in flight keep the previous image
+  void replace_storage_image(image_ressource_handle handle, ImageRessource res);
   auto register_external_image(ImageRessourceDefinition def) -> image_ressource_handle;
   auto register_transient_image(ImageRessourceDefinition def) -> image_ressource_handle;
   auto register_image(ImageRessourceDefinition def) -> image_ressource_handle {
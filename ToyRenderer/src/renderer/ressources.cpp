@@ -3,8 +3,10 @@
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
+#include <array>
 #include <cstdint>
 #include <format>
+#include <optional>
 #include <variant>
 
 #include "../registry.h"
@@ -14,6 +16,7 @@
 #include "synchronisation.h"
 #include "utils.h"
 #include "utils/misc.h"
+#include "vkformat.h"  // IWYU pragma: keep
 
 auto tr::renderer::ImageRessource::as_attachment(
     std::variant<VkClearValue, ImageClearOpLoad, ImageClearOpDontCare> clearOp) -> VkRenderingAttachmentInfo {
@@ -60,7 +63,7 @@ auto tr::renderer::ImageRessource::prepare_barrier(SyncInfo dst) -> std::optiona
                                 VkImageSubresourceRange{
                                     .aspectMask = aspectMask,
                                     .baseMipLevel = 0,
-                                    .levelCount = 1,
+                                    .levelCount = mip_levels,
                                     .baseArrayLayer = 0,
                                     .layerCount = 1,
                                 });
@@ -76,6 +79,86 @@ auto tr::renderer::ImageRessource::prepare_barrier(SyncInfo dst) -> std::optiona
   return barrier;
 }
 
+void tr::renderer::ImageRessource::generate_mipmaps(VkCommandBuffer cmd) {
+  TR_ASSERT(sync_info.layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, "mipmaps are generated from an uploaded image");
+  TR_ASSERT(!FormatBlock::of(format).is_compressed(), "{} can't be blitted, its mipmaps have to be baked", format);
+
+  static constexpr SyncInfo level_dst{
+      .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+  };
+  static constexpr SyncInfo level_src{
+      .accessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+      .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      .queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+  };
+  const auto level_barrier = [&](uint32_t level) {
+    std::array barriers{level_dst.barrier(level_src, image,
+                                          VkImageSubresourceRange{
+                                              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                              .baseMipLevel = level,
+                                              .levelCount = 1,
+                                              .baseArrayLayer = 0,
+                                              .layerCount = 1,
+                                          })};
+    ImageMemoryBarrier::submit(cmd, barriers);
+  };
+  const auto corner = [](VkExtent2D e) {
+    return VkOffset3D{utils::narrow_cast<int32_t>(e.width), utils::narrow_cast<int32_t>(e.height), 1};
+  };
+
+  for (uint32_t level = 1; level < mip_levels; level++) {
+    // The previous level has been written, it is read to produce this one
+    level_barrier(level - 1);
+
+    const VkImageBlit2 blit{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+        .pNext = nullptr,
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+        .srcOffsets = {{0, 0, 0}, corner(mip_extent(extent, level - 1))},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+        .dstOffsets = {{0, 0, 0}, corner(mip_extent(extent, level))},
+    };
+    const VkBlitImageInfo2 blit_info{
+        .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+        .pNext = nullptr,
+        .srcImage = image,
+        .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .dstImage = image,
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regionCount = 1,
+        .pRegions = &blit,
+        .filter = VK_FILTER_LINEAR,
+    };
+    vkCmdBlitImage2(cmd, &blit_info);
+  }
+  level_barrier(mip_levels - 1);
+
+  sync_info = level_src;
+}
+
+auto tr::renderer::ImageRessource::prepare_queue_transfer(SyncInfo dst, uint32_t src_family, uint32_t dst_family)
+    -> std::array<VkImageMemoryBarrier2, 2> {
+  TR_ASSERT(src_family != dst_family, "no ownership transfer is needed within queue family {}", src_family);
+  sync_info.queueFamilyIndex = src_family;
+  const auto barrier = prepare_barrier(dst.copy().queue(dst_family));
+  TR_ASSERT(barrier.has_value(), "a barrier is always needed across queue families");
+  // Past it, the queue family that owns the image is the one that uses it
+  sync_info.queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+  // Both do the same layout transition, the release makes the writes available and the acquire makes them visible
+  auto release = *barrier;
+  release.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+  release.dstAccessMask = VK_ACCESS_2_NONE;
+  auto acquire = *barrier;
+  acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+  acquire.srcAccessMask = VK_ACCESS_2_NONE;
+  return {release, acquire};
+}
+
 auto tr::renderer::ImageRessource::invalidate() -> ImageRessource& {
   sync_info = SrcImageMemoryBarrierUndefined;
   return *this;
@@ -83,7 +166,45 @@ auto tr::renderer::ImageRessource::invalidate() -> ImageRessource& {
 
 auto tr::renderer::ImageRessource::from_external_image(VkImage image, VkImageView view, VkImageUsageFlags usage,
                                                        VkExtent2D extent, SyncInfo sync_info) -> ImageRessource {
-  return {image, view, sync_info, nullptr, usage, extent};
+  return {image, view, sync_info, nullptr, usage, extent, VK_FORMAT_UNDEFINED, 1};
+}
+
+auto tr::renderer::FormatBlock::find(VkFormat format) -> std::optional<FormatBlock> {
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+      return FormatBlock{1, 1, 1};
+    case VK_FORMAT_R8G8_UNORM:
+      return FormatBlock{1, 1, 2};
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      return FormatBlock{1, 1, 4};
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return FormatBlock{1, 1, 8};
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return FormatBlock{1, 1, 16};
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+      return FormatBlock{4, 4, 8};
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return FormatBlock{4, 4, 16};
+    default:
+      return std::nullopt;
+  }
+}
+
+auto tr::renderer::FormatBlock::of(VkFormat format) -> FormatBlock {
+  const auto block = find(format);
+  TR_ASSERT(block, "unsupported format {}", format);
+  return *block;
 }
 auto tr::renderer::ImageDefinition::vk_format(const Swapchain& swapchain) const -> VkFormat {
   return format.resolve(swapchain);
@@ -105,6 +226,11 @@ auto tr::renderer::ImageDefinition::vk_aspect_mask() const -> VkImageAspectFlags
   return aspectMask;
 }
 
+auto tr::renderer::ImageDefinition::is_block_compressed(const Swapchain& swapchain) const -> bool {
+  const auto vk_format = format.resolve(swapchain);
+  return vk_format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && vk_format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK;
+}
+
 auto tr::renderer::ImageDefinition::vk_extent(const Swapchain& swapchain) const -> VkExtent3D {
   return size.resolve(swapchain);
 }
@@ -113,6 +239,9 @@ auto tr::renderer::ImageBuilder::build_image(ImageDefinition definition) const -
   const auto format = definition.vk_format(*swapchain);
   const auto aspect_mask = definition.vk_aspect_mask();
   const auto extent = definition.vk_extent(*swapchain);
+  TR_ASSERT(!definition.is_block_compressed(*swapchain) ||
+                (definition.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT)) == 0,
+            "{} is block compressed, it can only be sampled or copied", definition.debug_name);
 
   const VkImageCreateInfo image_create_info{
       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -121,7 +250,7 @@ auto tr::renderer::ImageBuilder::build_image(ImageDefinition definition) const -
       .imageType = VK_IMAGE_TYPE_2D,
       .format = format,
       .extent = extent,
-      .mipLevels = 1,
+      .mipLevels = definition.mip_levels,
       .arrayLayers = 1,
       .samples = VK_SAMPLE_COUNT_1_BIT,
       .tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -165,7 +294,7 @@ auto tr::renderer::ImageBuilder::build_image(ImageDefinition definition) const -
           {
               .aspectMask = aspect_mask,
               .baseMipLevel = 0,
-              .levelCount = 1,
+              .levelCount = definition.mip_levels,
               .baseArrayLayer = 0,
               .layerCount = 1,
           },
@@ -181,6 +310,8 @@ auto tr::renderer::ImageBuilder::build_image(ImageDefinition definition) const -
       .alloc = alloc,
       .usage = definition.usage,
       .extent = {.width = extent.width, .height = extent.height},
+      .format = format,
+      .mip_levels = definition.mip_levels,
   };
 
   return res;
@@ -215,6 +346,11 @@ auto tr::renderer::BufferDefinition::vma_flags() const -> VmaAllocationCreateFla
   if ((flags & BUFFER_OPTION_FLAG_CREATE_MAPPED_BIT) != 0) {
     flags_ |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
   }
+  if ((flags & BUFFER_OPTION_FLAG_DIRECT_UPLOAD_BIT) != 0) {
+    // VMA only maps it when it lands in host visible memory
+    flags_ |= VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+              VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  }
   return flags_;
 }
 
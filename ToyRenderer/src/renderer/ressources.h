@@ -2,6 +2,10 @@
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <string_view>
@@ -39,6 +43,8 @@ enum class BufferRessourceId {
   Camera,
   ShadowCamera,
   DebugVertices,
+  Instances,
+  ShadowInstances,
   MAX,
 };
 
@@ -57,6 +63,9 @@ using BufferOptionFlags = std::uint32_t;
 enum BufferOptionFlagsBits {
   BUFFER_OPTION_FLAG_CPU_TO_GPU_BIT = 1 << 0,
   BUFFER_OPTION_FLAG_CREATE_MAPPED_BIT = 1 << 1,
+  // Device local and mapped when that memory is host visible too, as on integrated GPUs or with resizable BAR. It is
+  // then written straight, otherwise mapped_data is null and uploads go through a staging buffer
+  BUFFER_OPTION_FLAG_DIRECT_UPLOAD_BIT = 1 << 2,
 };
 
 struct BufferDefinition {
@@ -94,11 +103,21 @@ struct ImageRessource {
   VmaAllocation alloc;
   VkImageUsageFlags usage;
   VkExtent2D extent;
+  VkFormat format;
+  uint32_t mip_levels;
 
   static auto from_external_image(VkImage image, VkImageView view, VkImageUsageFlags usage, VkExtent2D extent,
                                   SyncInfo sync_info = SrcImageMemoryBarrierUndefined) -> ImageRessource;
   auto invalidate() -> ImageRessource&;
+  // Barriers always cover every mip level, sync_info is the state they all share
   [[nodiscard]] auto prepare_barrier(SyncInfo dst) -> std::optional<VkImageMemoryBarrier2>;
+  // Ownership transfer from the queue family src_family, where the image is used, to dst_family where it ends in dst
+  // The release barrier goes to a command buffer of the first, the acquire one to one of the second
+  [[nodiscard]] auto prepare_queue_transfer(SyncInfo dst, uint32_t src_family, uint32_t dst_family)
+      -> std::array<VkImageMemoryBarrier2, 2>;
+  // Fills the levels below the base one by successive linear blits, the whole image has to be a transfer destination
+  // with its base level uploaded. Every level ends up as a transfer source
+  void generate_mipmaps(VkCommandBuffer cmd);
 
   auto as_attachment(ClearOp clearOp) -> VkRenderingAttachmentInfo;
 
@@ -196,6 +215,42 @@ struct StaticFormat {
   [[nodiscard]] auto resolve(const Swapchain& /*swapchain*/) const -> VkFormat { return format; }
 };
 
+// Number of levels of a full mip chain, down to 1x1
+inline auto mip_level_count(VkExtent2D extent) -> uint32_t {
+  return static_cast<uint32_t>(std::bit_width(std::max(extent.width, extent.height)));
+}
+
+inline auto mip_extent(VkExtent2D extent, uint32_t level) -> VkExtent2D {
+  return {std::max(extent.width >> level, 1U), std::max(extent.height >> level, 1U)};
+}
+
+// Formats are stored as blocks of texels, uncompressed formats simply have 1x1 blocks
+struct FormatBlock {
+  uint32_t width;
+  uint32_t height;
+  uint32_t size;
+
+  // nullopt for the formats textures are never uploaded in
+  [[nodiscard]] static auto find(VkFormat format) -> std::optional<FormatBlock>;
+  [[nodiscard]] static auto of(VkFormat format) -> FormatBlock;
+  [[nodiscard]] auto is_compressed() const -> bool { return width > 1 || height > 1; }
+  // Partial blocks on the right and bottom edges still take a whole block
+  [[nodiscard]] auto row_pitch(uint32_t image_width) const -> std::size_t {
+    return std::size_t{(image_width + width - 1) / width} * size;
+  }
+  [[nodiscard]] auto size_bytes(VkExtent2D extent) const -> std::size_t {
+    return row_pitch(extent.width) * ((extent.height + height - 1) / height);
+  }
+  // Size of the first levels of a mip chain, stored one after the other
+  [[nodiscard]] auto size_bytes(VkExtent2D extent, uint32_t levels) const -> std::size_t {
+    std::size_t size = 0;
+    for (uint32_t level = 0; level < levels; level++) {
+      size += size_bytes(mip_extent(extent, level));
+    }
+    return size;
+  }
+};
+
 struct ImageFormat : std::variant<SwapchainFormat, StaticFormat> {
   constexpr friend auto operator<=>(const ImageFormat& a, const ImageFormat& b) = default;
   [[nodiscard]] auto resolve(const Swapchain& swapchain) const -> VkFormat;
@@ -207,10 +262,12 @@ struct ImageDefinition {
   VkImageUsageFlags usage;
   ImageExtent size;
   ImageFormat format;
+  uint32_t mip_levels = 1;
   std::string_view debug_name;
 
   [[nodiscard]] auto vk_format(const Swapchain& swapchain) const -> VkFormat;
   [[nodiscard]] auto vk_aspect_mask() const -> VkImageAspectFlags;
+  [[nodiscard]] auto is_block_compressed(const Swapchain& swapchain) const -> bool;
   [[nodiscard]] auto vk_extent(const Swapchain& swapchain) const -> VkExtent3D;
   [[nodiscard]] auto depends_on(ImageDependency dep) const -> bool {
     return size.depends_on(dep) || format.depends_on(dep);
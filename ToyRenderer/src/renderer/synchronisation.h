@@ -124,7 +124,7 @@ static constexpr SyncInfo SyncPresent{
 };
 
 static constexpr SyncInfo SyncImageTransfer{
-    .accessMask = 0,
+    .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
     .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
     .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
     .queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
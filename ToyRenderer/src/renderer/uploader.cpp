@@ -1,59 +1,32 @@
 #include "uploader.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <span>
 
 #include "ressources.h"
 #include "synchronisation.h"
 #include "utils.h"
 #include "utils/assert.h"
 #include "utils/cast.h"
+#include "vkformat.h"  // IWYU pragma: keep
 
-auto tr::renderer::StagingBuffer::commit(VkCommandBuffer cmd, VkBuffer dst, uint32_t dst_offset) -> StagingBuffer& {
-  const VkBufferCopy region{
-      .srcOffset = offset,
-      .dstOffset = dst_offset,
-      .size = to_upload,
-  };
-  vkCmdCopyBuffer(cmd, buffer, dst, 1, &region);
-
-  offset += to_upload;
-  return *this;
-}
-auto tr::renderer::StagingBuffer::commit_image(VkCommandBuffer cmd, const ImageRessource& image, VkRect2D r)
-    -> StagingBuffer& {
-  const VkBufferImageCopy region{
-      .bufferOffset = offset,
-      .bufferRowLength = 0,
-      .bufferImageHeight = 0,
-      .imageSubresource =
-          {
-              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-              .mipLevel = 0,
-              .baseArrayLayer = 0,
-              .layerCount = 1,
-          },
-      .imageOffset = {r.offset.x, r.offset.y, 0},
-      .imageExtent = {r.extent.width, r.extent.height, 1},
-  };
-
-  vkCmdCopyBufferToImage(cmd, buffer, image.image, image.sync_info.layout, 1, &region);
-
-  offset += to_upload;
-  return *this;
-}
-
-auto tr::renderer::StagingBuffer::consume(std::size_t size, std::size_t alignement) -> std::span<std::byte> {
+auto tr::renderer::StagingBuffer::consume(std::size_t size, std::size_t alignement) -> MappedMemoryRange {
+  TR_ASSERT(std::has_single_bit(alignement), "alignement {} is not a power of two", alignement);
   TR_ASSERT(available(alignement) >= size, "StagingBuffer already filled");
   offset = utils::align<std::uint32_t>(offset, utils::narrow_cast<uint32_t>(alignement));
 
   auto out = std::as_writable_bytes(std::span{reinterpret_cast<std::byte*>(alloc_info.pMappedData), alloc_info.size})
                  .subspan(offset, size);
-  to_upload = utils::narrow_cast<uint32_t>(size);
-  return out;
+  const MappedMemoryRange range{out, buffer, offset};
+  offset += utils::narrow_cast<uint32_t>(size);
+  return range;
 }
 
-void tr::renderer::StagingBuffer::reset() { to_upload = offset = 0; }
+void tr::renderer::StagingBuffer::reset() { offset = 0; }
 
 auto tr::renderer::StagingBuffer::init(VmaAllocator allocator, uint32_t size) -> StagingBuffer {
   VkBuffer buf = VK_NULL_HANDLE;
@@ -84,34 +57,314 @@ auto tr::renderer::StagingBuffer::init(VmaAllocator allocator, uint32_t size) ->
 
   return {buf, alloc, alloc_info};
 }
-auto tr::renderer::Uploader::init(VmaAllocator allocator) -> Uploader {
-  Uploader u{allocator};
+auto tr::renderer::StagingRing::init(Lifetime& lifetime, VmaAllocator allocator, std::uint32_t size) -> StagingRing {
+  TR_ASSERT((size & (size - 1)) == 0, "the staging ring size {} is not a power of two", size);
+  StagingRing ring;
+  ring.staging = StagingBuffer::init(allocator, size);
+  lifetime.tie(VmaHandle::Buffer, ring.staging.buffer, ring.staging.alloc);
+  return ring;
+}
+
+auto tr::renderer::StagingRing::before_end(std::size_t alignement) const -> std::size_t {
+  const auto size = staging.alloc_info.size;
+  const auto free = size - (head - tail);
+  const auto padding = utils::align(head % size, alignement) - head % size;
+  if (head % size + padding >= size || free <= padding) {
+    return 0;
+  }
+  return std::min(size - head % size, free) - padding;
+}
+
+auto tr::renderer::StagingRing::available(std::size_t alignement) const -> std::size_t {
+  const auto offset = head % staging.alloc_info.size;
+  const auto used = head - tail;
+  // Unless the memory in use wraps, the start of the buffer is free up to the tail
+  const auto from_start = offset > used ? offset - used : 0;
+  return std::max(before_end(alignement), from_start);
+}
+
+auto tr::renderer::StagingRing::consume(std::size_t size, std::size_t alignement) -> MappedMemoryRange {
+  TR_ASSERT(std::has_single_bit(alignement), "alignement {} is not a power of two", alignement);
+  TR_ASSERT(available(alignement) >= size, "StagingRing already filled");
+  const auto ring_size = staging.alloc_info.size;
+  if (before_end(alignement) < size) {
+    // The end of the buffer is skipped
+    head += ring_size - head % ring_size;
+  }
+  const auto start = utils::align(head % ring_size, alignement);
+  head += start - head % ring_size + size;
+
+  auto out = std::as_writable_bytes(std::span{reinterpret_cast<std::byte*>(staging.alloc_info.pMappedData), ring_size})
+                 .subspan(start, size);
+  return {out, staging.buffer, start};
+}
+
+void tr::renderer::StagingRing::close(std::uint64_t value) {
+  if (head != (regions.empty() ? tail : regions.back().end)) {
+    regions.push_back({head, value});
+  }
+}
+
+void tr::renderer::StagingRing::reclaim(std::uint64_t completed) {
+  while (!regions.empty() && regions.front().value <= completed) {
+    tail = regions.front().end;
+    regions.pop_front();
+  }
+}
+
+void tr::renderer::StagingPool::defer_deletion(VmaDeletionStack& vma_deletion_stack) {
+  for (auto& sb : spare) {
+    sb.defer_deletion(vma_deletion_stack);
+  }
+  spare.clear();
+}
+
+auto tr::renderer::Uploader::init(VmaAllocator allocator, StagingRing& ring, StagingPool& pool) -> Uploader {
+  Uploader u{allocator, ring, pool};
   return u;
 }
 
 void tr::renderer::Uploader::defer_trim(VmaDeletionStack& allocator_deletion_queue) {
+  // The GPU is done with them
   for (auto& sb : staging_buffers) {
-    sb.defer_deletion(allocator_deletion_queue);
+    if (pool->spare.size() < StagingPool::max_spare) {
+      sb.reset();
+      pool->spare.push_back(sb);
+    } else {
+      sb.defer_deletion(allocator_deletion_queue);
+    }
   }
   staging_buffers.clear();
 }
+
+void tr::renderer::Uploader::next_staging_buffer() {
+  if (pool->spare.empty()) {
+    staging_buffers.push_back(StagingBuffer::init(allocator, utils::narrow_cast<uint32_t>(staging_buffer_size)));
+  } else {
+    staging_buffers.push_back(pool->spare.back());
+    pool->spare.pop_back();
+  }
+}
+
+auto tr::renderer::Uploader::reserve(std::size_t size, std::size_t at_least, std::size_t alignement) -> std::size_t {
+  // Filling the end of a buffer with tiny chunks is not worth the copies
+  const auto worth = std::min(size, std::max(at_least, staging_buffer_size / 8));
+  if (available(alignement) < worth) {
+    next_staging_buffer();
+  }
+  return available(alignement);
+}
+
 auto tr::renderer::Uploader::map(std::size_t size, std::size_t alignement) -> MappedMemoryRange {
   TR_ASSERT(staging_buffer_size > size, "Buffer too big: staging_buffer_size {}, size {}", staging_buffer_size, size);
-  if (staging_buffers.empty() || staging_buffers.back().available() < size) {
-    staging_buffers.push_back(StagingBuffer::init(allocator, utils::narrow_cast<uint32_t>(staging_buffer_size)));
+  if (available(alignement) < size) {
+    next_staging_buffer();
   }
 
-  return {staging_buffers.back().consume(size, alignement)};
+  return consume(size, alignement);
+}
+
+auto tr::renderer::Uploader::map_chunk(std::size_t size, std::size_t alignement) -> MappedMemoryRange {
+  const auto room = reserve(size, alignement, alignement);
+  const auto chunk = size <= room ? size : room / alignement * alignement;
+  return consume(chunk, alignement);
 }
 
-void tr::renderer::Uploader::commit_buffer(VkCommandBuffer cmd, MappedMemoryRange /*mapped*/, VkBuffer buf,
+void tr::renderer::Uploader::flush_mapped(const BufferRessource& dst, std::size_t offset, std::size_t size) {
+  VK_UNWRAP(vmaFlushAllocation, allocator, dst.alloc, offset, size);
+}
+
+void tr::renderer::Uploader::commit_buffer(VkCommandBuffer cmd, MappedMemoryRange mapped, VkBuffer buf,
                                            std::size_t size, std::size_t offset) {
-  staging_buffers.back().to_upload = utils::narrow_cast<uint32_t>(size);
-  staging_buffers.back().commit(cmd, buf, utils::narrow_cast<uint32_t>(offset));
+  TR_ASSERT(size <= mapped.mapped.size(), "{} bytes were mapped, can't upload {}", mapped.mapped.size(), size);
+  TR_ASSERT(copy_cmd == VK_NULL_HANDLE || copy_cmd == cmd, "the copies of an uploader go to the same command buffer");
+  copy_cmd = cmd;
+  stats.requested++;
+
+  auto copies = std::ranges::find_if(buffer_copies, [&](const BufferCopies& c) {
+    return c.src == mapped.buffer && c.dst == buf;
+  });
+  if (copies == buffer_copies.end()) {
+    copies = buffer_copies.insert(copies, {mapped.buffer, buf, {}});
+  }
+  copies->regions.push_back({
+      .srcOffset = mapped.offset,
+      .dstOffset = offset,
+      .size = size,
+  });
+}
+
+void tr::renderer::Uploader::commit_image(VkCommandBuffer cmd, MappedMemoryRange mapped, const ImageRessource& image,
+                                          VkRect2D r, std::size_t size, std::size_t row_pitch, uint32_t mip_level,
+                                          uint32_t array_layer) {
+  TR_ASSERT(size <= mapped.mapped.size(), "{} bytes were mapped, can't upload {}", mapped.mapped.size(), size);
+  TR_ASSERT(copy_cmd == VK_NULL_HANDLE || copy_cmd == cmd, "the copies of an uploader go to the same command buffer");
+  const auto block = FormatBlock::of(image.format);
+  const auto x = static_cast<uint32_t>(r.offset.x);
+  const auto y = static_cast<uint32_t>(r.offset.y);
+  TR_ASSERT(x % block.width == 0 && y % block.height == 0, "copies to {} images must start on a block boundary",
+            image.format);
+  TR_ASSERT(row_pitch % block.size == 0, "row pitch {} is not made of whole blocks of {} bytes", row_pitch, block.size);
+  TR_ASSERT(mip_level < image.mip_levels, "the image has no mip level {}", mip_level);
+  copy_cmd = cmd;
+  stats.requested++;
+
+  // The layout is the one the image is in when the copy is asked, barriers recorded until the flush must not change it
+  auto copies = std::ranges::find_if(image_copies, [&](const ImageCopies& c) {
+    return c.src == mapped.buffer && c.dst == image.image && c.layout == image.sync_info.layout;
+  });
+  if (copies == image_copies.end()) {
+    copies = image_copies.insert(copies, {mapped.buffer, image.image, image.sync_info.layout, {}});
+  }
+  copies->regions.push_back({
+      .bufferOffset = mapped.offset,
+      // Vulkan wants the row length in texels
+      .bufferRowLength = utils::narrow_cast<uint32_t>(row_pitch / block.size * block.width),
+      .bufferImageHeight = 0,
+      .imageSubresource =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .mipLevel = mip_level,
+              .baseArrayLayer = array_layer,
+              .layerCount = 1,
+          },
+      .imageOffset = {r.offset.x, r.offset.y, 0},
+      .imageExtent = {r.extent.width, r.extent.height, 1},
+  });
+}
+
+void tr::renderer::Uploader::flush() {
+  for (auto& copies : buffer_copies) {
+    // Uploads of neighbouring ranges usually sit next to each other in the staging memory too
+    std::ranges::sort(copies.regions, {}, &VkBufferCopy::dstOffset);
+    std::size_t merged = 0;
+    for (std::size_t i = 1; i < copies.regions.size(); i++) {
+      auto& last = copies.regions[merged];
+      const auto& region = copies.regions[i];
+      if (last.srcOffset + last.size == region.srcOffset && last.dstOffset + last.size == region.dstOffset) {
+        last.size += region.size;
+      } else {
+        copies.regions[++merged] = region;
+      }
+    }
+    copies.regions.resize(merged + 1);
+
+    vkCmdCopyBuffer(copy_cmd, copies.src, copies.dst, utils::narrow_cast<uint32_t>(copies.regions.size()),
+                    copies.regions.data());
+    stats.commands++;
+    stats.regions += copies.regions.size();
+  }
+  for (const auto& copies : image_copies) {
+    vkCmdCopyBufferToImage(copy_cmd, copies.src, copies.dst, copies.layout,
+                           utils::narrow_cast<uint32_t>(copies.regions.size()), copies.regions.data());
+    stats.commands++;
+    stats.regions += copies.regions.size();
+  }
+  buffer_copies.clear();
+  image_copies.clear();
+}
+
+void tr::renderer::Transferer::hand_over(ImageRessource& image, SyncInfo dst) {
+  // The frame waits for the transfer, that is all it takes within a family
+  if (transfer_queue_family == graphics_queue_family) {
+    ImageMemoryBarrier::submit<1>(graphics_cmd.vk_cmd, {{image.prepare_barrier(dst)}});
+    return;
+  }
+
+  auto [release, acquire] = image.prepare_queue_transfer(dst, transfer_queue_family, graphics_queue_family);
+  image_releases.push_back(release);
+  // Mipmaps may be generated right after
+  ImageMemoryBarrier::submit(graphics_cmd.vk_cmd, std::span(&acquire, 1));
+}
+
+void tr::renderer::Transferer::hand_over(const BufferRessource& buffer, std::size_t offset, std::size_t size,
+                                         VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+  if (transfer_queue_family == graphics_queue_family || buffer.mapped_data != nullptr) {
+    return;
+  }
+
+  const VkBufferMemoryBarrier2 release{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+      .pNext = nullptr,
+      .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+      .dstAccessMask = VK_ACCESS_2_NONE,
+      .srcQueueFamilyIndex = transfer_queue_family,
+      .dstQueueFamilyIndex = graphics_queue_family,
+      .buffer = buffer.buffer,
+      .offset = offset,
+      .size = size,
+  };
+  buffer_releases.push_back(release);
+  auto acquire = release;
+  acquire.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+  acquire.srcAccessMask = VK_ACCESS_2_NONE;
+  acquire.dstStageMask = dst_stage;
+  acquire.dstAccessMask = dst_access;
+  buffer_acquires.push_back(acquire);
 }
 
-void tr::renderer::Uploader::commit_image(VkCommandBuffer cmd, MappedMemoryRange /*mapped*/,
-                                          const ImageRessource& image, VkRect2D r, std::size_t size) {
-  staging_buffers.back().to_upload = utils::narrow_cast<uint32_t>(size);
-  staging_buffers.back().commit_image(cmd, image, r);
+void tr::renderer::Transferer::flush() {
+  uploader.flush();
+
+  const auto barriers = [](VkCommandBuffer command_buffer, std::span<const VkImageMemoryBarrier2> images,
+                           std::span<const VkBufferMemoryBarrier2> buffers) {
+    if (images.empty() && buffers.empty()) {
+      return;
+    }
+    const VkDependencyInfo dependency_info{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = utils::narrow_cast<uint32_t>(buffers.size()),
+        .pBufferMemoryBarriers = buffers.data(),
+        .imageMemoryBarrierCount = utils::narrow_cast<uint32_t>(images.size()),
+        .pImageMemoryBarriers = images.data(),
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+  };
+  barriers(cmd.vk_cmd, image_releases, buffer_releases);
+  barriers(graphics_cmd.vk_cmd, {}, buffer_acquires);
+  image_releases.clear();
+  buffer_releases.clear();
+  buffer_acquires.clear();
+}
+
+void tr::renderer::Uploader::upload_image(VkCommandBuffer cmd, const ImageRessource& image, VkRect2D r,
+                                          std::span<const std::byte> src, std::size_t row_pitch, uint32_t mip_level,
+                                          uint32_t array_layer) {
+  const auto block = FormatBlock::of(image.format);
+  const auto tight_pitch = block.row_pitch(r.extent.width);
+  const auto pitch = row_pitch == 0 ? tight_pitch : row_pitch;
+  const auto rows = (r.extent.height + block.height - 1) / block.height;
+  // The last row needs no padding
+  const auto size = pitch * (rows - 1) + tight_pitch;
+  TR_ASSERT(src.size() >= size, "{} bytes are needed to upload a {}x{} {} image, got {}", size, r.extent.width,
+            r.extent.height, image.format, src.size());
+  TR_ASSERT(tight_pitch <= staging_buffer_size, "a row of a {} texels wide {} image does not fit in a staging buffer",
+            r.extent.width, image.format);
+
+  // Slabs of whole rows of blocks, as many as fit in the staging buffer
+  // Offsets in the staging buffer have to be a multiple of the block size, and of 4 on a transfer only queue. Block
+  // sizes are powers of two
+  const auto alignement = std::max<std::size_t>(block.size, 4);
+  for (uint32_t row = 0; row < rows;) {
+    const auto room = reserve(size - row * pitch, tight_pitch, alignement);
+    const auto slab_rows = std::min(rows - row, utils::narrow_cast<uint32_t>((room - tight_pitch) / pitch + 1));
+    const auto slab_size = pitch * (slab_rows - 1) + tight_pitch;
+
+    auto data = consume(slab_size, alignement);
+    std::memcpy(data.mapped.data(), src.data() + row * pitch, slab_size);
+
+    const auto top = row * block.height;
+    const VkRect2D slab{
+        .offset = {r.offset.x, r.offset.y + utils::narrow_cast<int32_t>(top)},
+        .extent = {r.extent.width, std::min(slab_rows * block.height, r.extent.height - top)},
+    };
+    commit_image(cmd, data, image, slab, slab_size, row_pitch, mip_level, array_layer);
+    row += slab_rows;
+  }
 }
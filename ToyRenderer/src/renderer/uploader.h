@@ -6,30 +6,33 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <span>
 #include <utility>
 #include <vector>
 
 #include "buffer.h"
 #include "deletion_stack.h"
+#include "ressources.h"
+#include "synchronisation.h"
 #include "utils/assert.h"
 #include "utils/cast.h"
 #include "utils/misc.h"
 
-namespace tr {
-namespace renderer {
-struct ImageRessource;
-}  // namespace renderer
-}  // namespace tr
-
 namespace tr::renderer {
+// Where the bytes to upload are written, and where the copy reads them from
+struct MappedMemoryRange {
+  std::span<std::byte> mapped;
+  VkBuffer buffer;
+  std::size_t offset;
+};
+
 struct StagingBuffer {
   VkBuffer buffer = VK_NULL_HANDLE;
   VmaAllocation alloc = nullptr;
   VmaAllocationInfo alloc_info{};
 
   uint32_t offset = 0;
-  uint32_t to_upload = 0;
 
   static auto init(VmaAllocator allocator, std::uint32_t size = 65536) -> StagingBuffer;
   void defer_deletion(VmaDeletionStack& vma_deletion_stack) const {
@@ -39,61 +42,192 @@ struct StagingBuffer {
   [[nodiscard]] auto available(std::size_t alignement = 1) const -> std::size_t {
     return alloc_info.size - utils::align(offset, utils::narrow_cast<uint32_t>(alignement));
   }
-  auto consume(std::size_t size, std::size_t alignement = 1) -> std::span<std::byte>;
-  auto commit(VkCommandBuffer, VkBuffer, uint32_t offset) -> StagingBuffer&;
-  auto commit_image(VkCommandBuffer cmd, const ImageRessource& image, VkRect2D r) -> StagingBuffer&;
+  auto consume(std::size_t size, std::size_t alignement = 1) -> MappedMemoryRange;
   void reset();
 };
 
-struct MappedMemoryRange {
-  std::span<std::byte> mapped;
+// Persistent staging memory written as a ring. What a transfer writes is kept until the transfer queue is done with
+// it, that is until the timeline semaphore of the transfers reaches the value the transfer signals
+class StagingRing {
+ public:
+  // size is a power of two
+  static auto init(Lifetime& lifetime, VmaAllocator allocator, std::uint32_t size) -> StagingRing;
+
+  // The most that can be consumed in one piece
+  [[nodiscard]] auto available(std::size_t alignement = 1) const -> std::size_t;
+  auto consume(std::size_t size, std::size_t alignement = 1) -> MappedMemoryRange;
+  // What was consumed since the last close is read by the submit signaling value
+  void close(std::uint64_t value);
+  // The submits up to completed are done, their memory can be written again
+  void reclaim(std::uint64_t completed);
+
+ private:
+  // What can be consumed without skipping the end of the buffer
+  [[nodiscard]] auto before_end(std::size_t alignement) const -> std::size_t;
+
+  StagingBuffer staging;
+  // Ever growing, modulo the buffer size they are offsets in it. Memory in use goes from tail to head
+  std::size_t head = 0;
+  std::size_t tail = 0;
+  struct Region {
+    std::size_t end;
+    std::uint64_t value;
+  };
+  std::deque<Region> regions;
+};
+
+// Staging buffers for what does not fit in the ring, those of retired transfers are handed to the next ones instead
+// of being freed and allocated again. At most max_spare are kept
+struct StagingPool {
+  static constexpr std::size_t max_spare = 4;
+  std::vector<StagingBuffer> spare;
+
+  void defer_deletion(VmaDeletionStack& vma_deletion_stack);
+};
+
+// Copies asked of an uploader, and the commands and regions they were merged into
+struct CopyStats {
+  std::size_t requested = 0;
+  std::size_t commands = 0;
+  std::size_t regions = 0;
+
+  auto operator+=(const CopyStats& other) -> CopyStats& {
+    requested += other.requested;
+    commands += other.commands;
+    regions += other.regions;
+    return *this;
+  }
 };
 
 class Uploader {
  public:
   Uploader(Uploader&& other) noexcept
-      : allocator(std::exchange(other.allocator, nullptr)), staging_buffers(std::exchange(other.staging_buffers, {})) {}
-  static auto init(VmaAllocator allocator) -> Uploader;
+      : allocator(std::exchange(other.allocator, nullptr)),
+        ring(std::exchange(other.ring, nullptr)),
+        pool(std::exchange(other.pool, nullptr)),
+        staging_buffers(std::exchange(other.staging_buffers, {})),
+        copy_cmd(std::exchange(other.copy_cmd, VK_NULL_HANDLE)),
+        buffer_copies(std::exchange(other.buffer_copies, {})),
+        image_copies(std::exchange(other.image_copies, {})),
+        stats(std::exchange(other.stats, {})) {}
+  // Uploads go through ring, then through staging buffers taken from pool once it is full. They are given back to
+  // the pool when trimmed. Both have to outlive the uploader
+  static auto init(VmaAllocator allocator, StagingRing& ring, StagingPool& pool) -> Uploader;
 
+  // All of size at once, up to a staging buffer
   auto map(std::size_t size, std::size_t alignement = 1) -> MappedMemoryRange;
+  // Some of size, as much as the staging memory in use still holds unless that is too little, always a multiple of
+  // alignement. Bigger uploads go chunk by chunk
+  auto map_chunk(std::size_t size, std::size_t alignement = 1) -> MappedMemoryRange;
+  // Copies are queued per destination, flush records them in cmd. Every copy of an uploader goes to the same cmd and a
+  // transfer writes each byte once
   void commit_buffer(VkCommandBuffer cmd, MappedMemoryRange mapped, VkBuffer buf, std::size_t size, std::size_t offset);
   void commit_image(VkCommandBuffer cmd, MappedMemoryRange mapped, const ImageRessource& image, VkRect2D r,
-                    std::size_t size);
-
-  auto upload_buffer(VkCommandBuffer cmd, VkBuffer dst, std::size_t offset, std::span<const std::byte> src,
-                     std::size_t alignemnt = 1) {
-    auto data = map(src.size(), alignemnt);
-    TR_ASSERT(src.size() == data.mapped.size(), "Can't upload buffer all at once");
+                    std::size_t size, std::size_t row_pitch = 0, uint32_t mip_level = 0, uint32_t array_layer = 0);
 
-    std::memcpy(data.mapped.data(), src.data(), src.size());
-    commit_buffer(cmd, data, dst, src.size(), offset);
+  // Uploads size bytes to dst at offset chunk by chunk, fill(chunk, from) writes bytes [from, from + chunk.size())
+  template <class Fill>
+  void upload_buffer_with(VkCommandBuffer cmd, VkBuffer dst, std::size_t offset, std::size_t size,
+                          std::size_t alignement, Fill&& fill) {
+    for (std::size_t done = 0; done < size;) {
+      auto data = map_chunk(size - done, alignement);
+      fill(data.mapped, done);
+      commit_buffer(cmd, data, dst, data.mapped.size(), offset + done);
+      done += data.mapped.size();
+    }
   }
 
-  // TODO: support memory layouts + stride and other things, maybe
-  auto upload_image(VkCommandBuffer cmd, const ImageRessource& image, VkRect2D r, std::span<const std::byte> src,
-                    std::size_t alignemnt = 1) {
-    auto data = map(src.size(), alignemnt);
-    TR_ASSERT(src.size() == data.mapped.size(), "Can't upload image all at once");
+  // Written straight into dst when it is mapped, see BUFFER_OPTION_FLAG_DIRECT_UPLOAD_BIT. Nothing is recorded then
+  // and the submit makes the writes visible. What the GPU may still read can't be written this way
+  template <class Fill>
+  void upload_buffer_with(VkCommandBuffer cmd, const BufferRessource& dst, std::size_t offset, std::size_t size,
+                          std::size_t alignement, Fill&& fill) {
+    if (dst.mapped_data == nullptr) {
+      upload_buffer_with(cmd, dst.buffer, offset, size, alignement, std::forward<Fill>(fill));
+      return;
+    }
+    TR_ASSERT(offset + size <= dst.size, "upload of {} bytes at {} past the end of a buffer of {}", size, offset,
+              dst.size);
+    fill(std::span(static_cast<std::byte*>(dst.mapped_data) + offset, size), std::size_t{0});
+    flush_mapped(dst, offset, size);
+  }
 
-    std::memcpy(data.mapped.data(), src.data(), src.size());
-    commit_image(cmd, data, image, r, src.size());
+  void upload_buffer(VkCommandBuffer cmd, VkBuffer dst, std::size_t offset, std::span<const std::byte> src,
+                     std::size_t alignemnt = 1) {
+    upload_buffer_with(cmd, dst, offset, src.size(), alignemnt, [&](std::span<std::byte> chunk, std::size_t from) {
+      std::memcpy(chunk.data(), src.data() + from, chunk.size());
+    });
   }
+  void upload_buffer(VkCommandBuffer cmd, const BufferRessource& dst, std::size_t offset,
+                     std::span<const std::byte> src, std::size_t alignemnt = 1) {
+    upload_buffer_with(cmd, dst, offset, src.size(), alignemnt, [&](std::span<std::byte> chunk, std::size_t from) {
+      std::memcpy(chunk.data(), src.data() + from, chunk.size());
+    });
+  }
+
+  // src is made of whole texel blocks, row_pitch is the size in bytes of a row of blocks in src, 0 if tightly packed
+  // r is in texels of mip_level. Images bigger than what is left of the staging buffer go in slabs of whole rows
+  void upload_image(VkCommandBuffer cmd, const ImageRessource& image, VkRect2D r, std::span<const std::byte> src,
+                    std::size_t row_pitch = 0, uint32_t mip_level = 0, uint32_t array_layer = 0);
+
+  // Records the queued copies, one command per destination with adjacent buffer ranges merged
+  void flush();
+  [[nodiscard]] auto copy_stats() const -> const CopyStats& { return stats; }
+
+  // What went through the ring is read by the submit signaling value of the transfer timeline
+  void close(std::uint64_t value) { ring->close(value); }
 
-  // Reset memory for staging_buffers
+  // Gives the staging buffers back to the pool, those it has no room for are deleted. The ring is not trimmed, it
+  // knows when its memory is free
   void defer_trim(VmaDeletionStack& allocator_deletion_queue);
 
-  ~Uploader() { TR_ASSERT(staging_buffers.empty(), "Trim Uploader before deleting it"); }
+  ~Uploader() {
+    TR_ASSERT(staging_buffers.empty(), "Trim Uploader before deleting it");
+    TR_ASSERT(buffer_copies.empty() && image_copies.empty(), "Flush Uploader before deleting it");
+  }
 
   Uploader(const Uploader&) = delete;
   auto operator=(const Uploader&) -> Uploader& = delete;
   auto operator=(Uploader&& other) -> Uploader& = delete;
 
  private:
-  explicit Uploader(VmaAllocator allocator_) : allocator(allocator_) {}
+  Uploader(VmaAllocator allocator_, StagingRing& ring_, StagingPool& pool_)
+      : allocator(allocator_), ring(&ring_), pool(&pool_) {}
+  // Leaves the ring for good, it won't have more room before the transfer is submitted
+  void next_staging_buffer();
+  [[nodiscard]] auto available(std::size_t alignement) const -> std::size_t {
+    return staging_buffers.empty() ? ring->available(alignement) : staging_buffers.back().available(alignement);
+  }
+  auto consume(std::size_t size, std::size_t alignement) -> MappedMemoryRange {
+    return staging_buffers.empty() ? ring->consume(size, alignement) : staging_buffers.back().consume(size, alignement);
+  }
+  // Room left in the staging memory in use. Moves to the next buffer if it can't take all of size and has less than
+  // at_least bytes, or an eighth of a buffer, left
+  auto reserve(std::size_t size, std::size_t at_least, std::size_t alignement) -> std::size_t;
+  // Makes host writes to dst visible, its memory may not be coherent
+  void flush_mapped(const BufferRessource& dst, std::size_t offset, std::size_t size);
 
   VmaAllocator allocator;
+  StagingRing* ring;
+  StagingPool* pool;
   std::vector<tr::renderer::StagingBuffer> staging_buffers{};
   std::size_t staging_buffer_size = 1 << 25;
+
+  VkCommandBuffer copy_cmd = VK_NULL_HANDLE;
+  struct BufferCopies {
+    VkBuffer src;
+    VkBuffer dst;
+    std::vector<VkBufferCopy> regions;
+  };
+  std::vector<BufferCopies> buffer_copies{};
+  struct ImageCopies {
+    VkBuffer src;
+    VkImage dst;
+    VkImageLayout layout;
+    std::vector<VkBufferImageCopy> regions;
+  };
+  std::vector<ImageCopies> image_copies{};
+  CopyStats stats{};
 };
 
 struct Transferer {
@@ -102,14 +236,35 @@ struct Transferer {
   uint32_t transfer_queue_family;
   uint32_t graphics_queue_family;
   Uploader uploader;
+  // What the transfer replaces, destroyed once the frames that may still use it are done
+  Lifetime replaced{};
 
   void upload_buffer(VkBuffer dst, std::size_t offset, std::span<const std::byte> src, std::size_t alignement = 1) {
     uploader.upload_buffer(cmd.vk_cmd, dst, offset, src, alignement);
   }
-  void upload_image(const ImageRessource& image, VkRect2D r, std::span<const std::byte> src,
-                    std::size_t alignemnt = 1) {
-    uploader.upload_image(cmd.vk_cmd, image, r, src, alignemnt);
+  void upload_buffer(const BufferRessource& dst, std::size_t offset, std::span<const std::byte> src,
+                     std::size_t alignement = 1) {
+    uploader.upload_buffer(cmd.vk_cmd, dst, offset, src, alignement);
   }
+  void upload_image(const ImageRessource& image, VkRect2D r, std::span<const std::byte> src, std::size_t row_pitch = 0,
+                    uint32_t mip_level = 0, uint32_t array_layer = 0) {
+    uploader.upload_image(cmd.vk_cmd, image, r, src, row_pitch, mip_level, array_layer);
+  }
+
+  // Once its uploads are asked, gives what the transfer queue wrote to the graphics queue: a release barrier in cmd
+  // and an acquire one in graphics_cmd when they are different families. The image ends in dst. Releases wait for
+  // flush to come after the copies. Mapped buffers are written by the host, the transfer queue never owns them
+  void hand_over(ImageRessource& image, SyncInfo dst);
+  void hand_over(const BufferRessource& buffer, std::size_t offset, std::size_t size, VkPipelineStageFlags2 dst_stage,
+                 VkAccessFlags2 dst_access);
+
+  // Records the queued copies then the release barriers, that have to come after them
+  void flush();
+
+  // Waiting for flush
+  std::vector<VkImageMemoryBarrier2> image_releases{};
+  std::vector<VkBufferMemoryBarrier2> buffer_releases{};
+  std::vector<VkBufferMemoryBarrier2> buffer_acquires{};
 };
 
 }  // namespace tr::renderer
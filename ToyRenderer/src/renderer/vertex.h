@@ -39,4 +39,44 @@ struct AttributeBuilder {
 
   consteval auto build() -> std::array<VkVertexInputAttributeDescription, N> { return attributes; };
 };
+
+struct VertexAttribute {
+  uint32_t location;
+  std::size_t offset;
+  VkFormat format;
+};
+
+// Vertex input state of pipelines reading each of Vs from its own binding, in order, generated at compile time from
+// their layout
+template <class... Vs>
+struct VertexInput {
+  static constexpr std::size_t attribute_count = (Vs::layout.size() + ...);
+
+  static constexpr std::array<VkVertexInputAttributeDescription, attribute_count> attributes = []() consteval {
+    AttributeBuilder<attribute_count> builder{};
+    uint32_t binding = 0;
+    const auto add = [&]<class V>() consteval {
+      builder.binding(binding++);
+      for (const auto& attribute : V::layout) {
+        builder.attribute(attribute.location, attribute.offset, attribute.format);
+      }
+    };
+    (add.template operator()<Vs>(), ...);
+    return builder.build();
+  }();
+
+  static constexpr std::array<VkVertexInputBindingDescription, sizeof...(Vs)> bindings = []() consteval {
+    std::array<VkVertexInputBindingDescription, sizeof...(Vs)> descriptions{};
+    uint32_t binding = 0;
+    ((descriptions[binding] =
+          {
+              .binding = binding,
+              .stride = sizeof(Vs),
+              .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+          },
+      binding++),
+     ...);
+    return descriptions;
+  }();
+};
 }  // namespace tr::renderer
@@ -3,7 +3,6 @@
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 #include <utils/cast.h>
-#include <utils/misc.h>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
@@ -11,6 +10,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <utility>
 #include <set>
 #include <vector>
 
@@ -48,6 +48,8 @@ auto tr::renderer::VulkanEngine::start_frame() -> std::optional<Frame> {
   VK_UNWRAP(vkWaitForFences, ctx.device.vk_device, 1, &frame_synchronisation_pool[frame_id_mod].render_fence, VK_TRUE,
             1000000000);
   debug_info.write_cpu_timestamp(CPU_TIMESTAMP_INDEX_ACQUIRE_FRAME_WAIT_FENCE);
+  // The frame that last used this slot is done, so are the transfers it ran
+  retire_transfers(frame_id > MAX_FRAMES_IN_FLIGHT ? frame_id - MAX_FRAMES_IN_FLIGHT : 0);
   auto& frm_opt = frame_ressource_data[frame_id_mod];
   if (frm_opt) {
     rm.release_frame_data(std::move(frm_opt.value()));
@@ -97,9 +99,13 @@ auto tr::renderer::VulkanEngine::start_frame() -> std::optional<Frame> {
                          graphic_command_buffers_for_next_frame.data());
     graphic_command_buffers_for_next_frame.clear();
 
-    // TODO: free the command buffers we need to wait until they are not used anymore?
-    // we could use a fence for this
-    // std::queue<std::pair<VkFence, std::vector<VkCommandBuffer>>>
+    frame.transfer_timeline = transfer_timeline;
+    frame.transfer_value = submitted_transfers;
+    for (auto& transfer : pending_transfers) {
+      if (transfer.frame_id == 0) {
+        transfer.frame_id = frame_id;
+      }
+    }
   }
 
   return frame;
@@ -186,10 +192,27 @@ void tr::renderer::VulkanEngine::init(tr::Options& options, std::span<const char
   transfer_command_pool =
       CommandPool::init(lifetime.global, ctx.device, ctx.physical_device, CommandPool::TargetQueue::Transfer);
 
+  const VkSemaphoreTypeCreateInfo timeline_create_info{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .pNext = nullptr,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  const VkSemaphoreCreateInfo timeline_semaphore_create_info{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &timeline_create_info,
+      .flags = 0,
+  };
+  VK_UNWRAP(vkCreateSemaphore, ctx.device.vk_device, &timeline_semaphore_create_info, nullptr, &transfer_timeline);
+  set_debug_object_name(ctx.device.vk_device, VK_OBJECT_TYPE_SEMAPHORE, transfer_timeline, "transfer timeline");
+  lifetime.global.tie(DeviceHandle::Semaphore, transfer_timeline);
+  staging_ring = StagingRing::init(lifetime.global, allocator, staging_ring_size);
+
   for (auto& frame_descriptor_allocator : frame_descriptor_allocators) {
     frame_descriptor_allocator = DescriptorAllocator::init(lifetime.global, ctx.device.vk_device, 8192,
                                                            {{
                                                                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2048},
+                                                               {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2048},
                                                                {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2048},
                                                                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2048},
                                                            }});
@@ -205,7 +228,11 @@ void tr::renderer::VulkanEngine::init(tr::Options& options, std::span<const char
 }
 
 auto tr::renderer::VulkanEngine::start_transfer() -> Transferer {
-  utils::ignore_unused(this);
+  // The transfer queue may be done with the staging memory of transfers no frame ran yet
+  std::uint64_t completed = 0;
+  VK_UNWRAP(vkGetSemaphoreCounterValue, ctx.device.vk_device, transfer_timeline, &completed);
+  staging_ring.reclaim(completed);
+
   auto cmd = OneTimeCommandBuffer::allocate(ctx.device.vk_device, transfer_command_pool);
   auto graphics_cmd = OneTimeCommandBuffer::allocate(ctx.device.vk_device, graphic_command_pool_for_next_frame, false);
 
@@ -216,25 +243,63 @@ auto tr::renderer::VulkanEngine::start_transfer() -> Transferer {
       graphics_cmd,
       ctx.physical_device.queues.transfer_family,
       ctx.physical_device.queues.graphics_family,
-      Uploader::init(allocator),
+      Uploader::init(allocator, staging_ring, staging_pool),
+      {},
   };
 }
 void tr::renderer::VulkanEngine::end_transfer(Transferer&& t_in) {
   Transferer t{std::move(t_in)};
+  t.flush();
+  copies += t.uploader.copy_stats();
   VK_UNWRAP(t.cmd.end);
   VK_UNWRAP(t.graphics_cmd.end);
+
+  // Nothing waits here: the next frame waits for the timeline to reach the transfer before running its graphics
+  // commands, which acquire what the transfer queue released. The timeline also tells when the staging memory can be
+  // written again
+  const std::uint64_t value = submitted_transfers + 1;
+  t.uploader.close(value);
+  VK_CHECK(QueueSubmit{}
+               .command_buffers({{t.cmd.vk_cmd}})
+               .signal_semaphores({{transfer_timeline}})
+               .signal_values({{value}})
+               .submit(ctx.device.transfer_queue, VK_NULL_HANDLE),
+           vkQueueSubmit);
   graphic_command_buffers_for_next_frame.push_back(t.graphics_cmd.vk_cmd);
 
-  QueueSubmit{}.command_buffers({{t.cmd.vk_cmd}}).submit(ctx.device.transfer_queue, VK_NULL_HANDLE);
+  pending_transfers.push_back({
+      .cmd = t.cmd,
+      .graphics_cmd = t.graphics_cmd,
+      .uploader = std::move(t.uploader),
+      .replaced = std::move(t.replaced),
+      .frame_id = 0,
+  });
+  submitted_transfers++;
+}
 
-  // WARN: THIS IS BAD: we should keep the uploader until all the uploads are done
-  // Maybe within a deletion queue with a fence ? Or smthg like that
-  sync();
-  t.uploader.defer_trim(lifetime.frame.allocator);
+void tr::renderer::VulkanEngine::retire_transfers(std::uint32_t completed_frame_id) {
+  // Frames run the transfers in submission order
+  while (!pending_transfers.empty() && pending_transfers.front().frame_id != 0 &&
+         pending_transfers.front().frame_id <= completed_frame_id) {
+    auto& transfer = pending_transfers.front();
+    vkFreeCommandBuffers(ctx.device.vk_device, transfer_command_pool, 1, &transfer.cmd.vk_cmd);
+    vkFreeCommandBuffers(ctx.device.vk_device, graphic_command_pool_for_next_frame, 1, &transfer.graphics_cmd.vk_cmd);
+    transfer.uploader.defer_trim(lifetime.frame.allocator);
+    transfer.replaced.cleanup(ctx.device.vk_device, allocator);
+    pending_transfers.pop_front();
+    retired_transfers++;
+  }
 }
 
 tr::renderer::VulkanEngine::~VulkanEngine() {
   sync();
+  // Never run by a frame, the device is idle so they are done all the same
+  for (auto& transfer : pending_transfers) {
+    transfer.frame_id = frame_id + 1;
+  }
+  retire_transfers(frame_id + 1);
+  staging_pool.defer_deletion(lifetime.frame.allocator);
+  lifetime.frame.cleanup(ctx.device.vk_device, allocator);
 
   for (std::size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkFreeCommandBuffers(ctx.device.vk_device, graphic_command_pools[i], 1, &graphics_command_buffers[i].vk_cmd);
@@ -268,6 +333,7 @@ tr::renderer::VulkanEngine::~VulkanEngine() {
 
 void tr::renderer::VulkanEngine::sync() {
   VK_UNWRAP(vkDeviceWaitIdle, ctx.device.vk_device);
+  retire_transfers(frame_id);
   for (auto& f : frame_ressource_data) {
     if (f) {
       rm.release_frame_data(std::move(*f));
@@ -4,11 +4,14 @@
 #include <vulkan/vulkan_core.h>
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <optional>
 #include <span>
 #include <utility>
 
+#include "buffer.h"
 #include "constants.h"
 #include "context.h"
 #include "debug.h"
@@ -23,7 +26,6 @@
 namespace tr {
 namespace renderer {
 class DescriptorAllocator;
-struct OneTimeCommandBuffer;
 }  // namespace renderer
 struct Options;
 }  // namespace tr
@@ -60,6 +62,17 @@ class VulkanEngine {
     end_transfer(std::move(transferer));
   }
 
+  // Transfers submitted since the last frame started, a frame waits on at most two of them
+  [[nodiscard]] auto transfers_waiting_for_frame() const -> std::size_t {
+    return graphic_command_buffers_for_next_frame.size();
+  }
+  // Transfers are numbered from 1 in submission order, they are done in that order too. Done is once their staging
+  // buffers are released, a few frames after the GPU is done with them
+  [[nodiscard]] auto last_transfer() const -> std::uint64_t { return submitted_transfers; }
+  [[nodiscard]] auto transfer_done(std::uint64_t transfer) const -> bool { return transfer <= retired_transfers; }
+  // Of every transfer so far
+  [[nodiscard]] auto copy_stats() const -> const CopyStats& { return copies; }
+
   void sync();
   void imgui() { debug_info.imgui(*this); }
 
@@ -91,6 +104,7 @@ class VulkanEngine {
   void rebuild_swapchain();
   void rebuild_invalidated();
   void build_ressources();
+  void retire_transfers(std::uint32_t completed_frame_id);
 
   GLFWwindow* window{};
 
@@ -108,6 +122,27 @@ class VulkanEngine {
   utils::data::static_stack<VkCommandBuffer, 2> graphic_command_buffers_for_next_frame{};
 
   VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
+  // Submitted transfers, kept until the GPU is done with their staging buffers and with what they replace. The frame
+  // running the graphics commands of a transfer waits for the timeline to reach it, so a transfer is done once that
+  // frame is
+  struct PendingTransfer {
+    OneTimeCommandBuffer cmd;
+    OneTimeCommandBuffer graphics_cmd;
+    Uploader uploader;
+    Lifetime replaced;
+    // 0 until a frame runs it
+    std::uint32_t frame_id;
+  };
+  std::deque<PendingTransfer> pending_transfers;
+  // Signaled with its number by each transfer once the transfer queue is done with it
+  VkSemaphore transfer_timeline = VK_NULL_HANDLE;
+  StagingRing staging_ring;
+  static constexpr std::uint32_t staging_ring_size = 1U << 26;
+  // Staging buffers of retired transfers, for the next ones
+  StagingPool staging_pool;
+  std::uint64_t submitted_transfers{};
+  std::uint64_t retired_transfers{};
+  CopyStats copies{};
   friend VulkanEngineDebugInfo;
 };
 
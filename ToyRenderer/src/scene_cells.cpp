@@ -0,0 +1,131 @@
+#include "scene_cells.h"
+
+#include <spdlog/spdlog.h>  // for info
+#include <utils/cast.h>     // for narrow_cast
+
+#include <algorithm>       // for clamp, max, min, sort, unique
+#include <cmath>           // for floor
+#include <cstddef>         // for size_t
+#include <cstdint>         // for uint32_t
+#include <glm/common.hpp>  // for min, max
+#include <glm/mat4x4.hpp>  // for mat4
+#include <glm/vec3.hpp>    // for vec3
+#include <glm/vec4.hpp>    // for vec4
+#include <limits>          // for numeric_limits
+#include <span>            // for span
+#include <vector>          // for vector
+
+#include "node_hierarchy.h"  // for NodeHierarchy
+#include "renderer/mesh.h"   // for AABB
+
+namespace {
+auto empty_box() -> tr::renderer::AABB {
+  return {glm::vec3(std::numeric_limits<float>::infinity()), glm::vec3(-std::numeric_limits<float>::infinity())};
+}
+
+void grow(tr::renderer::AABB& box, const tr::renderer::AABB& other) {
+  box.min = glm::min(box.min, other.min);
+  box.max = glm::max(box.max, other.max);
+}
+
+auto transformed(const tr::renderer::AABB& box, const glm::mat4& transform) -> tr::renderer::AABB {
+  auto out = empty_box();
+  for (std::size_t corner = 0; corner < 8; corner++) {
+    const glm::vec3 p{
+        (corner & 1) != 0 ? box.max.x : box.min.x,
+        (corner & 2) != 0 ? box.max.y : box.min.y,
+        (corner & 4) != 0 ? box.max.z : box.min.z,
+    };
+    const auto world = glm::vec3(transform * glm::vec4(p, 1.F));
+    out.min = glm::min(out.min, world);
+    out.max = glm::max(out.max, world);
+  }
+  return out;
+}
+}  // namespace
+
+auto tr::SceneCells::build(utils::ThreadPool& pool, const SceneData& scene) -> SceneCells {
+  NodeHierarchy nodes;
+  for (const auto& node : scene.nodes) {
+    nodes.add(node.parent, node.translation, node.rotation, node.scale);
+  }
+  nodes.update(pool);
+
+  // World bounds of every instance, mesh by mesh
+  std::vector<SceneData::CellInstance> all_instances;
+  std::vector<renderer::AABB> instance_bounds;
+  auto scene_bounds = empty_box();
+  for (std::size_t m = 0; m < scene.meshes.size(); m++) {
+    const auto& mesh = scene.meshes[m];
+    auto mesh_bounds = empty_box();
+    for (const auto& surface : mesh.surfaces) {
+      grow(mesh_bounds, surface.bounding_box);
+    }
+    if (mesh.surfaces.empty()) {
+      continue;
+    }
+    for (std::size_t i = 0; i < mesh.instances.size(); i++) {
+      all_instances.push_back({utils::narrow_cast<uint32_t>(m), utils::narrow_cast<uint32_t>(i)});
+      instance_bounds.push_back(transformed(mesh_bounds, nodes.world(mesh.instances[i])));
+      grow(scene_bounds, instance_bounds.back());
+    }
+  }
+
+  SceneCells cells;
+  if (all_instances.empty()) {
+    return cells;
+  }
+
+  const auto extent = scene_bounds.max - scene_bounds.min;
+  const auto cell_size = std::max(std::max(extent.x, extent.z) / static_cast<float>(cells_per_side), 1e-3F);
+  const auto grid_coordinate = [&](float x, float min) {
+    const auto c = static_cast<int>(std::floor((x - min) / cell_size));
+    return static_cast<std::size_t>(std::clamp(c, 0, static_cast<int>(cells_per_side) - 1));
+  };
+
+  std::vector<std::vector<SceneData::CellInstance>> grid(std::size_t{cells_per_side} * cells_per_side);
+  std::vector<renderer::AABB> grid_bounds(grid.size(), empty_box());
+  for (std::size_t i = 0; i < all_instances.size(); i++) {
+    const auto center = (instance_bounds[i].min + instance_bounds[i].max) / 2.F;
+    const auto g = grid_coordinate(center.z, scene_bounds.min.z) * cells_per_side +
+                   grid_coordinate(center.x, scene_bounds.min.x);
+    grid[g].push_back(all_instances[i]);
+    grow(grid_bounds[g], instance_bounds[i]);
+  }
+
+  // Offsets first, the spans are made once the vectors are done growing
+  struct Ranges {
+    std::size_t instances;
+    std::size_t instance_count;
+    std::size_t materials;
+    std::size_t material_count;
+  };
+  std::vector<Ranges> ranges;
+  std::vector<uint32_t> cell_materials;
+  for (std::size_t g = 0; g < grid.size(); g++) {
+    if (grid[g].empty()) {
+      continue;
+    }
+    cell_materials.clear();
+    for (const auto& instance : grid[g]) {
+      for (const auto& surface : scene.meshes[instance.mesh].surfaces) {
+        cell_materials.push_back(surface.material);
+      }
+    }
+    std::ranges::sort(cell_materials);
+    const auto [first, last] = std::ranges::unique(cell_materials);
+    cell_materials.erase(first, last);
+
+    ranges.push_back({cells.instances.size(), grid[g].size(), cells.materials.size(), cell_materials.size()});
+    cells.instances.insert(cells.instances.end(), grid[g].begin(), grid[g].end());
+    cells.materials.insert(cells.materials.end(), cell_materials.begin(), cell_materials.end());
+    cells.cells.push_back({.bounds = grid_bounds[g], .instances = {}, .materials = {}});
+  }
+  for (std::size_t c = 0; c < cells.cells.size(); c++) {
+    cells.cells[c].instances = std::span(cells.instances).subspan(ranges[c].instances, ranges[c].instance_count);
+    cells.cells[c].materials = std::span(cells.materials).subspan(ranges[c].materials, ranges[c].material_count);
+  }
+
+  spdlog::info("Split the scene into {} cells of {:.1f}m by {:.1f}m", cells.cells.size(), cell_size, cell_size);
+  return cells;
+}
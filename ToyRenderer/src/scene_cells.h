@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "scene_data.h"
+
+namespace utils {
+class ThreadPool;
+}  // namespace utils
+
+namespace tr {
+
+// Splits a scene into cells to stream it in and out around the camera, done offline: .trscene files store them
+// Cells are the columns of a regular grid over the ground plane (xz) of the scene, an instance goes to the one its
+// center falls in. Instances of a mesh may end up in several cells, they then share it
+struct SceneCells {
+  static constexpr uint32_t cells_per_side = 16;
+
+  std::vector<SceneData::Cell> cells;
+  // What the spans of cells point into
+  std::vector<SceneData::CellInstance> instances;
+  std::vector<uint32_t> materials;
+
+  static auto build(utils::ThreadPool& pool, const SceneData& scene) -> SceneCells;
+};
+
+}  // namespace tr
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/ext/quaternion_float.hpp>
+#include <glm/vec3.hpp>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "renderer/mesh.h"
+
+namespace tr {
+
+// CPU side of a scene, in the exact layout the GPU wants it
+// The spans point either into decoded glTF data or into a mapped .trscene file, storage keeps them alive
+struct SceneData {
+  struct Image {
+    uint32_t width;
+    uint32_t height;
+    // Either R8G8B8A8 or block compressed, tightly packed
+    VkFormat format;
+    // The levels are stored one after the other in texels
+    uint32_t mip_levels;
+    std::span<const std::byte> texels;
+  };
+
+  // Indices into images
+  struct Material {
+    uint32_t albedo;
+    std::optional<uint32_t> metallic_roughness;
+    std::optional<uint32_t> normal;
+  };
+
+  struct Surface {
+    uint32_t start;
+    uint32_t count;
+    // Index into materials
+    uint32_t material;
+    renderer::AABB bounding_box;
+    // Average uv units per unit of mesh space, how the resolution of its textures maps to its size
+    float uv_density;
+    // Into meshlets of the mesh
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+    // Into lods of the mesh
+    uint32_t first_lod;
+    uint32_t lod_count;
+  };
+
+  // Local transform of a node, nodes are sorted depth by depth
+  struct Node {
+    // NodeHierarchy::no_parent for roots
+    uint32_t parent;
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+  };
+
+  struct Mesh {
+    std::string_view name;
+    // Into nodes, the mesh is drawn once per node that references it
+    std::span<const uint32_t> instances;
+    // The two vertex streams, as many of each
+    std::span<const renderer::VertexPosition> positions;
+    std::span<const renderer::PackedAttributes> attributes;
+    std::span<const uint32_t> indices;
+    std::span<const Surface> surfaces;
+    std::span<const renderer::Meshlet> meshlets;
+    std::span<const renderer::SurfaceLod> lods;
+  };
+
+  // Instance of meshes[mesh] at nodes[meshes[mesh].instances[instance]]
+  struct CellInstance {
+    uint32_t mesh;
+    uint32_t instance;
+  };
+
+  // Part of the scene streamed in and out as a whole, see SceneCells
+  struct Cell {
+    // World space, of everything in the cell
+    renderer::AABB bounds;
+    std::span<const CellInstance> instances;
+    // Into materials, those the surfaces of its meshes use
+    std::span<const uint32_t> materials;
+  };
+
+  std::vector<Image> images;
+  std::vector<Material> materials;
+  std::vector<Node> nodes;
+  std::vector<Mesh> meshes;
+  std::vector<Cell> cells;
+
+  std::shared_ptr<const void> storage;
+};
+
+}  // namespace tr
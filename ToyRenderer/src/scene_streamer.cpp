@@ -0,0 +1,483 @@
+#include "scene_streamer.h"
+
+#include <imgui.h>               // for Text, Begin, End
+#include <spdlog/spdlog.h>       // for info
+#include <utils/cast.h>          // for narrow_cast
+#include <utils/misc.h>          // for align
+#include <utils/thread_pool.h>   // for ThreadPool
+#include <utils/timer.h>         // for TIMED_INLINE_LAMBDA, Timer
+#include <vulkan/vulkan_core.h>  // for VkIndexType
+
+#include <algorithm>          // for min, max
+#include <chrono>             // for seconds
+#include <cmath>              // for tan
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint32_t, uint16_t
+#include <cstring>            // for memcpy
+#include <format>             // for format
+#include <future>             // for future_status, packaged_task
+#include <glm/common.hpp>     // for clamp
+#include <glm/geometric.hpp>  // for length
+#include <glm/vec3.hpp>       // for vec3
+#include <limits>             // for numeric_limits
+#include <optional>           // for optional, nullopt
+#include <span>               // for as_bytes, span
+#include <string>             // for string
+#include <thread>             // for jthread
+#include <utility>            // for move
+#include <vector>             // for vector
+
+#include "camera.h"                            // for Camera
+#include "gltf.h"                              // for Gltf
+#include "load_report.h"                       // for LoadReport
+#include "renderer/passes/frustrum_culling.h"  // for Frustum, FrustrumCulling, MeshletCulling
+#include "renderer/uploader.h"                 // for Transferer
+#include "renderer/vulkan_engine.h"            // for VulkanEngine
+
+namespace {
+// Uploaded per frame, the first mesh or image in line goes through whatever its size
+constexpr std::size_t bytes_per_frame = std::size_t{16} << 20;
+
+// Indices are relative to the mesh, 16 bits are enough for most of them
+auto index_type(const tr::SceneData::Mesh& mesh) -> VkIndexType {
+  return mesh.positions.size() <= std::numeric_limits<uint16_t>::max() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+auto index_size(VkIndexType type) -> std::size_t {
+  return type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+}  // namespace
+
+void tr::SceneStreamer::start(utils::ThreadPool& pool_, std::string path, bool bake, bool block_compression,
+                              std::size_t texture_memory, std::size_t geometry_memory, std::string report_path_) {
+  pool = &pool_;
+  texture_memory_limit = texture_memory;
+  geometry_memory_limit = geometry_memory;
+  scene_path = path;
+  report_path = std::move(report_path_);
+  timer.start();
+  // On its own thread rather than on a worker: it waits on parallel_for itself, the frames would wait behind it
+  std::packaged_task<SceneData()> load{[this, &pool_, path = std::move(path), bake, block_compression] {
+    return TIMED_INLINE_LAMBDA("Load scene") {
+      return Gltf::load_from_file(pool_, path, bake, block_compression, report);
+    };
+  }};
+  loading = load.get_future();
+  loader = std::jthread{std::move(load)};
+}
+
+tr::SceneStreamer::~SceneStreamer() {
+  if (loader.joinable()) {
+    loader.join();
+  }
+}
+
+auto tr::SceneStreamer::stream(renderer::VulkanEngine& engine, const Camera& camera, float viewport_height) -> bool {
+  if (!scene) {
+    if (!loading.valid() || loading.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+      return false;
+    }
+    scene = loading.get();
+    begin_upload(engine);
+  }
+  track_batches(engine);
+  release_geometry(engine);
+  // A frame that does not come, while the swapchain is rebuilt for instance, would have them pile up
+  if (engine.transfers_waiting_for_frame() != 0) {
+    return false;
+  }
+
+  // Cells that go make room for the ones that come, once the frames in flight are done with them
+  cells.plan(camera);
+  const auto unloaded = cells.unloads().size();
+  for (const auto cell : cells.unloads()) {
+    unload_cell(engine, cell);
+  }
+
+  // Once every image is there at least at a low resolution, texture levels come and go
+  const auto tails_done = textures.size() == scene->images.size();
+  if (tails_done) {
+    request_texture_levels(camera, viewport_height);
+  }
+  const auto texture_levels = tails_done && textures.plan(engine, bytes_per_frame);
+  if (cells.loads().empty() && tails_done && !texture_levels && unloaded == 0) {
+    return false;
+  }
+
+  // Always submitted when cells went: their geometry is released once it is done
+  const auto texture_count = textures.size();
+  std::size_t bytes = 0;
+  std::vector<uint32_t> loaded;
+  engine.transfer([&](renderer::Transferer& t) {
+    if (texture_levels) {
+      textures.apply(engine, t);
+    }
+    for (const auto cell : cells.loads()) {
+      if (bytes >= bytes_per_frame) {
+        break;
+      }
+      // Nearest first, the next ones wait for the room the unloaded ones leave
+      const auto cell_bytes = load_cell(t, cell);
+      if (!cell_bytes) {
+        break;
+      }
+      bytes += *cell_bytes;
+      loaded.push_back(cell);
+    }
+    while (bytes < bytes_per_frame && textures.size() < scene->images.size()) {
+      std::optional<LoadReport::Scope> scope;
+      if (!reported) {
+        scope.emplace(report, LoadReport::Phase::Staging, std::format("texture {}", textures.size()));
+      }
+      const auto texture_bytes = textures.add(engine, t);
+      if (scope) {
+        scope->bytes = texture_bytes;
+      }
+      bytes += texture_bytes;
+    }
+  });
+
+  const auto loaded_count = loaded.size();
+  if (loaded_count != 0 || textures.size() != texture_count) {
+    uploaded_bytes += bytes;
+    batches.push_back({
+        .transfer = engine.last_transfer(),
+        .timer = {},
+        .bytes = bytes,
+        .name = std::format("batch {} ({} cells, {} textures)", batch_count++, loaded_count,
+                            textures.size() - texture_count),
+        .cells = std::move(loaded),
+    });
+    batches.back().timer.start();
+  }
+
+  // Surfaces keep a copy of their material handles
+  if (textures.size() != texture_count) {
+    for (std::size_t m = 0; m < meshes.size(); m++) {
+      const auto surfaces = scene->meshes[m].surfaces;
+      for (std::size_t s = 0; s < surfaces.size(); s++) {
+        meshes[m].surfaces[s].material = material_handles(surfaces[s].material);
+      }
+    }
+  }
+
+  if (!finished && loaded_count == cells.loads().size() && textures.size() == scene->images.size()) {
+    finish();
+  }
+  return unloaded != 0 || loaded_count != 0 || textures.size() != texture_count;
+}
+
+void tr::SceneStreamer::release(renderer::Lifetime& lifetime) { textures.release(lifetime); }
+
+void tr::SceneStreamer::begin_upload(renderer::VulkanEngine& engine) {
+  copies_before = engine.copy_stats();
+  // Every mesh goes in the same pair of buffers, sized for the whole scene unless it has to fit in less
+  std::size_t vertex_count = 0;
+  std::size_t indices_bytes = 0;
+  std::size_t total_bytes = 0;
+  mesh_bytes.reserve(scene->meshes.size());
+  for (const auto& mesh : scene->meshes) {
+    const auto size = index_size(index_type(mesh));
+    vertex_count += mesh.positions.size();
+    indices_bytes = utils::align(indices_bytes, size) + mesh.indices.size() * size;
+    mesh_bytes.push_back(mesh.positions.size_bytes() + mesh.attributes.size_bytes() + mesh.indices.size() * size);
+    total_bytes += mesh_bytes.back();
+  }
+  cells.init(scene->cells, mesh_bytes, geometry_memory_limit);
+  if (geometry_memory_limit != 0 && geometry_memory_limit < total_bytes) {
+    // A quarter more than the limit for the holes unloaded meshes leave
+    const auto share =
+        std::min(1., 1.25 * static_cast<double>(geometry_memory_limit) / static_cast<double>(total_bytes));
+    vertex_count = static_cast<std::size_t>(share * static_cast<double>(vertex_count));
+    indices_bytes = static_cast<std::size_t>(share * static_cast<double>(indices_bytes));
+
+    // The nearest cell comes even over the limit, the largest one has to fit on its own
+    for (uint32_t c = 0; c < cells.size(); c++) {
+      std::size_t cell_vertices = 0;
+      std::size_t cell_indices = 0;
+      for (const auto m : cells.meshes(c)) {
+        const auto& mesh = scene->meshes[m];
+        const auto size = index_size(index_type(mesh));
+        cell_vertices += mesh.positions.size();
+        cell_indices = utils::align(cell_indices, size) + mesh.indices.size() * size;
+      }
+      vertex_count = std::max(vertex_count, cell_vertices);
+      indices_bytes = std::max(indices_bytes, cell_indices);
+    }
+  }
+  auto bb = engine.buffer_builder();
+  geometry = renderer::GeometryBuffer::init(engine.lifetime.global, bb, vertex_count, indices_bytes);
+
+  for (const auto& node : scene->nodes) {
+    nodes.add(node.parent, node.translation, node.rotation, node.scale);
+  }
+  nodes.update(*pool);
+
+  node_cells.assign(scene->nodes.size(), std::numeric_limits<uint32_t>::max());
+  for (std::size_t c = 0; c < scene->cells.size(); c++) {
+    for (const auto& instance : scene->cells[c].instances) {
+      node_cells[scene->meshes[instance.mesh].instances[instance.instance]] = utils::narrow_cast<uint32_t>(c);
+    }
+  }
+
+  // Everything but the geometry and the instances stays, meshes come and go with their cells
+  meshes.resize(scene->meshes.size());
+  mesh_nodes.resize(scene->meshes.size());
+  for (std::size_t m = 0; m < meshes.size(); m++) {
+    const auto& mesh = scene->meshes[m];
+    auto& asset_mesh = meshes[m];
+    asset_mesh.name = mesh.name;
+    asset_mesh.surfaces.reserve(mesh.surfaces.size());
+    for (const auto& surface : mesh.surfaces) {
+      asset_mesh.surfaces.push_back({
+          .start = surface.start,
+          .count = surface.count,
+          .material = material_handles(surface.material),
+          .bounding_box = surface.bounding_box,
+          .uv_density = surface.uv_density,
+          .first_meshlet = surface.first_meshlet,
+          .meshlet_count = surface.meshlet_count,
+          .first_lod = surface.first_lod,
+          .lod_count = surface.lod_count,
+      });
+    }
+    asset_mesh.meshlets.assign(mesh.meshlets.begin(), mesh.meshlets.end());
+    asset_mesh.lods.assign(mesh.lods.begin(), mesh.lods.end());
+    asset_mesh.summarize_surfaces();
+  }
+
+  textures.init(scene->images, texture_memory_limit);
+  auto loaded = timer;
+  loaded.stop();
+  spdlog::info("Scene loaded after {:.0f}ms, streaming {} cells in", loaded.elapsed, cells.size());
+}
+
+auto tr::SceneStreamer::load_cell(renderer::Transferer& t, uint32_t cell) -> std::optional<std::size_t> {
+  missing_meshes.clear();
+  cells.missing_meshes(cell, missing_meshes);
+
+  // All or nothing, a cell only shows up whole
+  std::vector<renderer::GeometryAllocation> allocations;
+  allocations.reserve(missing_meshes.size());
+  for (const auto m : missing_meshes) {
+    const auto& mesh = scene->meshes[m];
+    const auto allocation = geometry.try_allocate(mesh.positions.size(), mesh.indices.size(), index_type(mesh));
+    if (!allocation) {
+      for (const auto& a : allocations) {
+        geometry.free(a);
+      }
+      return std::nullopt;
+    }
+    allocations.push_back(*allocation);
+  }
+
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < missing_meshes.size(); i++) {
+    upload_mesh(t, missing_meshes[i], allocations[i]);
+    bytes += mesh_bytes[missing_meshes[i]];
+  }
+  for (const auto& instance : scene->cells[cell].instances) {
+    const auto node = scene->meshes[instance.mesh].instances[instance.instance];
+    mesh_nodes[instance.mesh].push_back(node);
+    meshes[instance.mesh].instances.push_back(nodes.world(node));
+  }
+  cells.load(cell);
+  return bytes;
+}
+
+void tr::SceneStreamer::unload_cell(renderer::VulkanEngine& engine, uint32_t cell) {
+  for (const auto m : cells.meshes(cell)) {
+    auto& instance_nodes = mesh_nodes[m];
+    auto& instances = meshes[m].instances;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < instance_nodes.size(); i++) {
+      if (node_cells[instance_nodes[i]] != cell) {
+        instance_nodes[kept] = instance_nodes[i];
+        instances[kept] = instances[i];
+        kept++;
+      }
+    }
+    instance_nodes.resize(kept);
+    instances.resize(kept);
+  }
+
+  released_meshes.clear();
+  cells.unload(cell, released_meshes);
+  for (const auto m : released_meshes) {
+    // The frames in flight may still draw it, the transfer stream() submits next runs after them
+    releases.push_back({.transfer = engine.last_transfer() + 1, .geometry = meshes[m].geometry});
+    meshes[m].geometry = {};
+  }
+}
+
+void tr::SceneStreamer::upload_mesh(renderer::Transferer& t, uint32_t m,
+                                    const renderer::GeometryAllocation& allocation) {
+  const auto& mesh = scene->meshes[m];
+  std::optional<LoadReport::Scope> scope;
+  if (!reported) {
+    scope.emplace(report, LoadReport::Phase::Staging, std::string{mesh.name}, mesh_bytes[m]);
+  }
+  auto& asset_mesh = meshes[m];
+  asset_mesh.geometry = allocation;
+
+  const auto positions_offset = asset_mesh.geometry.vertices.offset * sizeof(renderer::VertexPosition);
+  const auto attributes_offset = asset_mesh.geometry.vertices.offset * sizeof(renderer::PackedAttributes);
+  t.upload_buffer(geometry.positions, positions_offset, std::as_bytes(mesh.positions));
+  t.upload_buffer(geometry.attributes, attributes_offset, std::as_bytes(mesh.attributes));
+
+  const auto& indices = asset_mesh.geometry.indices;
+  if (asset_mesh.geometry.index_type == VK_INDEX_TYPE_UINT16) {
+    // Narrowed straight into the staging buffer, or into the index buffer when it is mapped
+    const auto narrow = [&](std::span<std::byte> chunk, std::size_t from) {
+      for (std::size_t i = 0; i < chunk.size() / sizeof(uint16_t); i++) {
+        const auto index = static_cast<uint16_t>(mesh.indices[from / sizeof(uint16_t) + i]);
+        std::memcpy(chunk.data() + i * sizeof(uint16_t), &index, sizeof(uint16_t));
+      }
+    };
+    t.uploader.upload_buffer_with(t.cmd.vk_cmd, geometry.indices, indices.offset, indices.size, sizeof(uint16_t),
+                                  narrow);
+  } else {
+    t.upload_buffer(geometry.indices, indices.offset, std::as_bytes(mesh.indices));
+  }
+
+  // What a mesh leaves behind when it goes is not needed anymore, the transfer queue writes over it without taking
+  // it back
+  t.hand_over(geometry.positions, positions_offset, mesh.positions.size_bytes(),
+              VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+  t.hand_over(geometry.attributes, attributes_offset, mesh.attributes.size_bytes(),
+              VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+  t.hand_over(geometry.indices, indices.offset, indices.size, VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+              VK_ACCESS_2_INDEX_READ_BIT);
+}
+
+void tr::SceneStreamer::release_geometry(const renderer::VulkanEngine& engine) {
+  while (!releases.empty() && engine.transfer_done(releases.front().transfer)) {
+    geometry.free(releases.front().geometry);
+    releases.pop_front();
+  }
+}
+
+void tr::SceneStreamer::request_texture_levels(const Camera& camera, float viewport_height) {
+  const auto frustum = renderer::Frustum::from_camera(camera);
+  const auto view_matrix = camera.cameraInfo().viewMatrix;
+  const auto pixels_per_unit = viewport_height / (2.F * std::tan(camera.fovy / 2.F));
+  for (std::size_t m = 0; m < meshes.size(); m++) {
+    for (const auto& instance : meshes[m].instances) {
+      const auto view =
+          renderer::MeshletCulling::View::from(frustum, {0, 0, 0, 1}, view_matrix * instance, pixels_per_unit);
+      const auto eye = glm::vec3(view.eye) / view.eye.w;
+      const auto surfaces = scene->meshes[m].surfaces;
+      for (std::size_t s = 0; s < surfaces.size(); s++) {
+        const auto& surface = meshes[m].surfaces[s];
+        // Without any uv extent every level looks the same
+        if (surface.uv_density == 0.F || !renderer::FrustrumCulling::filter_one(view.frustum, surface.bounding_box)) {
+          continue;
+        }
+        // At the closest point of the surface, where it needs the finest level
+        const auto distance = glm::length(glm::clamp(eye, surface.bounding_box.min, surface.bounding_box.max) - eye);
+        const auto uv_per_pixel = surface.uv_density * distance / view.pixels_per_unit;
+
+        const auto& material = scene->materials[surfaces[s].material];
+        textures.need(material.albedo, uv_per_pixel);
+        if (material.normal) {
+          textures.need(*material.normal, uv_per_pixel);
+        }
+        if (material.metallic_roughness) {
+          textures.need(*material.metallic_roughness, uv_per_pixel);
+        }
+      }
+    }
+  }
+}
+
+auto tr::SceneStreamer::material_handles(uint32_t material) const -> renderer::MaterialHandles {
+  const auto& m = scene->materials[material];
+  const auto texture = [&](std::optional<uint32_t> image) -> std::optional<renderer::image_ressource_handle> {
+    if (image && *image < textures.size()) {
+      return textures.handle(*image);
+    }
+    return std::nullopt;
+  };
+  return {
+      .albedo_handle = texture(m.albedo),
+      .normal_handle = texture(m.normal),
+      .metallic_roughness_handle = texture(m.metallic_roughness),
+  };
+}
+
+void tr::SceneStreamer::finish() {
+  timer.stop();
+  std::size_t surface_count = 0;
+  for (const auto& mesh : meshes) {
+    surface_count += mesh.surfaces.size();
+  }
+  spdlog::info("Streamed {} images and {} cells ({:.1f} MiB) in {:.0f}ms", textures.size(),
+               cells.stats().resident_cells, static_cast<double>(uploaded_bytes) / (1 << 20), timer.elapsed);
+  spdlog::info("There are {} meshes and {} surfaces ", meshes.size(), surface_count);
+  spdlog::info("There are {} nodes over {} levels", nodes.size(), nodes.depth_count());
+
+  // Kept, cells and texture levels are streamed from it from now on
+  finished = true;
+}
+
+void tr::SceneStreamer::track_batches(const renderer::VulkanEngine& engine) {
+  while (!batches.empty() && engine.transfer_done(batches.front().transfer)) {
+    auto& batch = batches.front();
+    batch.timer.stop();
+    for (const auto cell : batch.cells) {
+      cells.arrived(cell);
+    }
+    if (!reported) {
+      report.record(LoadReport::Phase::Transfer, std::move(batch.name), batch.timer.elapsed, batch.bytes);
+    }
+    batches.pop_front();
+  }
+  if (!finished || !batches.empty() || reported) {
+    return;
+  }
+
+  const auto& copies = engine.copy_stats();
+  report.record_copies(copies.requested - copies_before.requested, copies.commands - copies_before.commands,
+                       copies.regions - copies_before.regions);
+  auto total = timer;
+  total.stop();
+  report.log_summary(total.elapsed);
+  if (!report_path.empty()) {
+    report.write_json(report_path, scene_path, total.elapsed);
+  }
+  reported = true;
+}
+
+void tr::SceneStreamer::imgui() const {
+  if (!scene) {
+    return;
+  }
+  if (!ImGui::Begin("Streaming")) {
+    ImGui::End();
+    return;
+  }
+
+  const auto mib = [](std::size_t bytes) { return static_cast<double>(bytes) / (1 << 20); };
+  const auto& stats = cells.stats();
+  ImGui::Text("%s", std::format("{} / {} cells resident, {} loads, {} unloads", stats.resident_cells, cells.size(),
+                                stats.loads, stats.unloads)
+                        .c_str());
+  if (cells.limit() == 0) {
+    ImGui::Text("%s", std::format("Geometry: {:.1f} MiB", mib(stats.resident_bytes)).c_str());
+  } else {
+    ImGui::Text("%s",
+                std::format("Geometry: {:.1f} / {:.1f} MiB", mib(stats.resident_bytes), mib(cells.limit())).c_str());
+  }
+  // Includes what waits for the frames in flight
+  constexpr auto vertex_size = sizeof(renderer::VertexPosition) + sizeof(renderer::PackedAttributes);
+  const auto used = geometry.vertex_usage() * vertex_size + geometry.index_usage();
+  const auto capacity = std::size_t{geometry.positions.size} + geometry.attributes.size + geometry.indices.size;
+  ImGui::Text("%s", std::format("Geometry buffers: {:.1f} / {:.1f} MiB used, {} meshes waiting to be freed", mib(used),
+                                mib(capacity), releases.size())
+                        .c_str());
+  if (stats.arrivals != 0) {
+    ImGui::Text("%s", std::format("Cell latency: last {:.0f}ms, average {:.0f}ms, max {:.0f}ms", stats.last_latency_ms,
+                                  stats.total_latency_ms / static_cast<float>(stats.arrivals), stats.max_latency_ms)
+                          .c_str());
+  }
+  ImGui::End();
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <utils/timer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cell_streamer.h"
+#include "load_report.h"
+#include "node_hierarchy.h"
+#include "renderer/geometry_buffer.h"
+#include "renderer/mesh.h"
+#include "renderer/uploader.h"
+#include "scene_data.h"
+#include "texture_streamer.h"
+
+namespace utils {
+class ThreadPool;
+}  // namespace utils
+
+namespace tr {
+struct Camera;
+namespace renderer {
+class VulkanEngine;
+struct Lifetime;
+struct Transferer;
+}  // namespace renderer
+
+// Loads a scene on its own thread, helped by the thread pool, then uploads it a bit every frame, frames keep coming in
+// the meantime
+// Meshes come with the cells around the camera and go with them, see CellStreamer. They are drawn with the default
+// textures until the tails of their own ones are uploaded. Finer texture levels are then streamed in and out
+// depending on what the camera sees
+class SceneStreamer {
+ public:
+  SceneStreamer() = default;
+  // Waits for the loading thread, it uses the pool
+  ~SceneStreamer();
+
+  SceneStreamer(const SceneStreamer&) = delete;
+  SceneStreamer(SceneStreamer&&) = delete;
+  auto operator=(const SceneStreamer&) -> SceneStreamer& = delete;
+  auto operator=(SceneStreamer&&) -> SceneStreamer& = delete;
+
+  // path, bake and block_compression are as for Gltf::load_from_file, texture_memory is the limit of TextureStreamer
+  // and geometry_memory the one of CellStreamer
+  // Where the time went is logged once everything around the camera is on the GPU, and written as JSON to
+  // report_path if not empty
+  void start(utils::ThreadPool& pool, std::string path, bool bake, bool block_compression, std::size_t texture_memory,
+             std::size_t geometry_memory, std::string report_path);
+
+  // To be called before each frame, with what it will be seen from. Returns whether meshes came, went or their
+  // materials changed
+  auto stream(renderer::VulkanEngine& engine, const Camera& camera, float viewport_height) -> bool;
+
+  // Ties the textures to lifetime, for when the engine goes away
+  void release(renderer::Lifetime& lifetime);
+
+  [[nodiscard]] auto done() const -> bool { return finished; }
+
+  // Cell and geometry metrics
+  void imgui() const;
+
+  // One mesh per mesh of the scene, those of no resident cell have no instance and no geometry
+  // meshes[i].instances[j] is the world matrix of nodes[mesh_nodes[i][j]]
+  renderer::GeometryBuffer geometry;
+  NodeHierarchy nodes;
+  std::vector<renderer::Mesh> meshes;
+  std::vector<std::vector<uint32_t>> mesh_nodes;
+
+ private:
+  void begin_upload(renderer::VulkanEngine& engine);
+  // Returns the bytes uploaded, nullopt when its meshes don't fit in the geometry buffer for now
+  auto load_cell(renderer::Transferer& t, uint32_t cell) -> std::optional<std::size_t>;
+  // Its meshes no other cell uses go once the transfer about to be submitted is done
+  void unload_cell(renderer::VulkanEngine& engine, uint32_t cell);
+  void upload_mesh(renderer::Transferer& t, uint32_t mesh, const renderer::GeometryAllocation& allocation);
+  // Frees the geometry of unloaded meshes the frames in flight are done with
+  void release_geometry(const renderer::VulkanEngine& engine);
+  // Tells textures what the visible surfaces need
+  void request_texture_levels(const Camera& camera, float viewport_height);
+  // Materials whose textures are not uploaded yet use the default ones
+  [[nodiscard]] auto material_handles(uint32_t material) const -> renderer::MaterialHandles;
+  void finish();
+  // Records the batches the GPU is done with, then writes the report once they all are
+  void track_batches(const renderer::VulkanEngine& engine);
+
+  utils::ThreadPool* pool = nullptr;
+  std::future<SceneData> loading;
+  std::jthread loader;
+  // Kept once uploaded, texture levels come from it
+  std::optional<SceneData> scene;
+  // Images are uploaded in order, texture i is scene->images[i]
+  TextureStreamer textures;
+  std::size_t texture_memory_limit = 0;
+  CellStreamer cells;
+  std::size_t geometry_memory_limit = 0;
+  std::vector<std::size_t> mesh_bytes;
+  // Cell of each node with a mesh
+  std::vector<uint32_t> node_cells;
+  std::vector<uint32_t> missing_meshes;
+  std::vector<uint32_t> released_meshes;
+  // Geometry of unloaded meshes, freed once transfer is done: the frames that may draw it are then done too
+  struct Release {
+    std::uint64_t transfer;
+    renderer::GeometryAllocation geometry;
+  };
+  std::deque<Release> releases;
+  std::size_t uploaded_bytes = 0;
+  bool finished = false;
+  utils::Timer timer;
+
+  // Transfers of uploads, until they are done
+  struct Batch {
+    std::uint64_t transfer;
+    utils::Timer timer;
+    std::size_t bytes;
+    std::string name;
+    std::vector<uint32_t> cells;
+  };
+  std::deque<Batch> batches;
+  std::size_t batch_count = 0;
+  LoadReport report;
+  // Those of the transfers before the scene, left out of the report
+  renderer::CopyStats copies_before;
+  std::string scene_path;
+  std::string report_path;
+  bool reported = false;
+};
+
+}  // namespace tr
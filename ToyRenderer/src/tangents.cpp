@@ -0,0 +1,122 @@
+#include "tangents.h"
+
+#include <algorithm>          // for min, clamp
+#include <array>              // for array
+#include <cmath>              // for acos, abs
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint32_t
+#include <glm/geometric.hpp>  // for dot, cross, length
+#include <glm/vec3.hpp>       // for vec3
+#include <glm/vec4.hpp>       // for vec4
+#include <span>               // for span
+#include <vector>             // for vector
+
+#include "renderer/mesh.h"  // for Vertex
+
+namespace {
+using tr::renderer::Vertex;
+
+// Triangles are gathered this many at a time into flat arrays, the math in between then vectorizes
+constexpr std::size_t batch_size = 64;
+
+struct Batch {
+  using Lane = std::array<float, batch_size>;
+  // Edges from the first corner, in space and in uv
+  Lane e1x, e1y, e1z, e2x, e2y, e2z;
+  Lane s1x, s1y, s2x, s2y;
+  // Tangent and bitangent of each triangle, scaled by the uv area
+  Lane tx, ty, tz, bx, by, bz;
+
+  void gather(std::span<const uint32_t> triangles, std::span<const Vertex> vertices) {
+    for (std::size_t k = 0; k < triangles.size() / 3; k++) {
+      const auto& v0 = vertices[triangles[3 * k]];
+      const auto& v1 = vertices[triangles[3 * k + 1]];
+      const auto& v2 = vertices[triangles[3 * k + 2]];
+      e1x[k] = v1.pos.x - v0.pos.x;
+      e1y[k] = v1.pos.y - v0.pos.y;
+      e1z[k] = v1.pos.z - v0.pos.z;
+      e2x[k] = v2.pos.x - v0.pos.x;
+      e2y[k] = v2.pos.y - v0.pos.y;
+      e2z[k] = v2.pos.z - v0.pos.z;
+      s1x[k] = v1.uv1.x - v0.uv1.x;
+      s1y[k] = v1.uv1.y - v0.uv1.y;
+      s2x[k] = v2.uv1.x - v0.uv1.x;
+      s2y[k] = v2.uv1.y - v0.uv1.y;
+    }
+  }
+
+  // Solves [e1 e2] = [t b] [s1 s2] for each triangle
+  void solve(std::size_t count) {
+    for (std::size_t k = 0; k < count; k++) {
+      const float det = s1x[k] * s2y[k] - s2x[k] * s1y[k];
+      // Degenerate uvs give no direction at all
+      const float r = det != 0.F ? 1.F / det : 0.F;
+      tx[k] = (e1x[k] * s2y[k] - e2x[k] * s1y[k]) * r;
+      ty[k] = (e1y[k] * s2y[k] - e2y[k] * s1y[k]) * r;
+      tz[k] = (e1z[k] * s2y[k] - e2z[k] * s1y[k]) * r;
+      bx[k] = (e2x[k] * s1x[k] - e1x[k] * s2x[k]) * r;
+      by[k] = (e2y[k] * s1x[k] - e1y[k] * s2x[k]) * r;
+      bz[k] = (e2z[k] * s1x[k] - e1z[k] * s2x[k]) * r;
+    }
+  }
+};
+
+// Unit length part of v orthogonal to the unit vector n, 0 if there is none
+auto orthogonal(glm::vec3 v, glm::vec3 n) -> glm::vec3 {
+  const auto o = v - n * glm::dot(n, v);
+  const auto length = glm::length(o);
+  return length > 0.F ? o / length : glm::vec3{0.F};
+}
+
+auto corner_angle(glm::vec3 corner, glm::vec3 a, glm::vec3 b) -> float {
+  const auto la = glm::length(a - corner);
+  const auto lb = glm::length(b - corner);
+  if (la == 0.F || lb == 0.F) {
+    return 0.F;
+  }
+  return std::acos(std::clamp(glm::dot(a - corner, b - corner) / (la * lb), -1.F, 1.F));
+}
+}  // namespace
+
+void tr::tangents::generate(std::span<const uint32_t> indices, std::span<renderer::Vertex> vertices) {
+  std::vector<glm::vec3> tangents(vertices.size(), glm::vec3{0.F});
+  std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3{0.F});
+
+  Batch batch{};
+  for (std::size_t first = 0; first + 2 < indices.size(); first += 3 * batch_size) {
+    const auto triangles = indices.subspan(first, std::min(3 * batch_size, indices.size() - first) / 3 * 3);
+    const auto count = triangles.size() / 3;
+    batch.gather(triangles, vertices);
+    batch.solve(count);
+
+    for (std::size_t k = 0; k < count; k++) {
+      const glm::vec3 t{batch.tx[k], batch.ty[k], batch.tz[k]};
+      const glm::vec3 b{batch.bx[k], batch.by[k], batch.bz[k]};
+      for (std::size_t c = 0; c < 3; c++) {
+        const auto v = triangles[3 * k + c];
+        const auto& n = vertices[v].normal;
+        const auto angle = corner_angle(vertices[v].pos, vertices[triangles[3 * k + (c + 1) % 3]].pos,
+                                        vertices[triangles[3 * k + (c + 2) % 3]].pos);
+        tangents[v] += angle * orthogonal(t, n);
+        bitangents[v] += angle * orthogonal(b, n);
+      }
+    }
+  }
+
+  for (std::size_t v = 0; v < vertices.size(); v++) {
+    auto& vertex = vertices[v];
+    const auto n = vertex.normal;
+    if (glm::length(n) == 0.F) {
+      vertex.tangent = {1.F, 0.F, 0.F, 1.F};
+      continue;
+    }
+
+    auto t = orthogonal(tangents[v], n);
+    if (glm::length(t) == 0.F) {
+      // No usable uv around, any tangent will do
+      t = orthogonal(std::abs(n.x) < 0.9F ? glm::vec3{1.F, 0.F, 0.F} : glm::vec3{0.F, 1.F, 0.F}, n);
+    }
+    const auto handedness = glm::dot(glm::cross(n, t), bitangents[v]) < 0.F ? -1.F : 1.F;
+    vertex.tangent = glm::vec4{t, handedness};
+  }
+}
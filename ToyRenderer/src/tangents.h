@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "renderer/mesh.h"
+
+// Tangent space for meshes that come without one, in the spirit of MikkTSpace
+namespace tr::tangents {
+
+// Tangents of every triangle are accumulated on their corners weighted by the corner angle, then orthonormalized
+// against the vertex normal. The handedness of the uv mapping ends up in tangent.w
+// indices are relative to vertices, vertices no triangle uses get an arbitrary tangent
+void generate(std::span<const uint32_t> indices, std::span<renderer::Vertex> vertices);
+
+}  // namespace tr::tangents
@@ -0,0 +1,243 @@
+#include "texture_streamer.h"
+
+#include <spdlog/spdlog.h>       // for trace
+#include <utils/assert.h>        // for TR_ASSERT
+#include <vk_mem_alloc.h>        // for vmaGetHeapBudgets, VmaBudget
+#include <vulkan/vulkan_core.h>  // for VkExtent2D, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT
+
+#include <algorithm>  // for min, max, sort, fill
+#include <array>      // for array
+#include <cmath>      // for log2, floor
+#include <cstddef>    // for size_t
+#include <cstdint>    // for uint32_t
+#include <format>     // for format
+#include <numeric>    // for accumulate
+#include <span>       // for span
+#include <utility>    // for pair
+#include <vector>     // for vector
+
+#include "renderer/deletion_stack.h"     // for Lifetime
+#include "renderer/ressource_manager.h"  // for RessourceManager
+#include "renderer/ressources.h"         // for ImageBuilder, ImageRessource, mip_extent
+#include "renderer/synchronisation.h"    // for ImageMemoryBarrier, SyncFrag...
+#include "renderer/uploader.h"           // for Transferer
+#include "renderer/vkformat.h"           // IWYU pragma: keep
+#include "renderer/vulkan_engine.h"      // for VulkanEngine
+
+namespace {
+// Usage and budget summed over the device local heaps, everything on an UMA
+auto device_local_memory(const tr::renderer::VulkanEngine& engine) -> std::pair<std::size_t, std::size_t> {
+  std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+  vmaGetHeapBudgets(engine.allocator, budgets.data());
+  const auto& properties = engine.ctx.physical_device.memory_properties;
+  std::size_t usage = 0;
+  std::size_t budget = 0;
+  for (std::size_t i = 0; i < properties.memoryHeapCount; i++) {
+    if ((properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0) {
+      usage += budgets[i].usage;
+      budget += budgets[i].budget;
+    }
+  }
+  return {usage, budget};
+}
+}  // namespace
+
+void tr::TextureStreamer::init(std::span<const SceneData::Image> images_, std::size_t limit_) {
+  images = images_;
+  limit = limit_;
+  textures.reserve(images.size());
+}
+
+auto tr::TextureStreamer::add(renderer::VulkanEngine& engine, renderer::Transferer& t) -> std::size_t {
+  const auto i = textures.size();
+  const auto& image = images[i];
+  TR_ASSERT(image.mip_levels <= max_levels, "texture {} has {} levels, too many", i, image.mip_levels);
+
+  uint32_t tail = 0;
+  while (tail + 1 < image.mip_levels) {
+    const auto extent = renderer::mip_extent({image.width, image.height}, tail);
+    if (std::max(extent.width, extent.height) <= tail_size) {
+      break;
+    }
+    tail++;
+  }
+  textures.push_back({
+      .handle = {},
+      .image = {},
+      .resident = tail,
+      .tail = tail,
+      .needed = tail,
+      .last_needed = {},
+  });
+  reallocate(engine, t, i, tail);
+  return chain_bytes(i, tail);
+}
+
+void tr::TextureStreamer::need(uint32_t image, float uv_per_pixel) {
+  if (image >= textures.size()) {
+    return;
+  }
+  auto& texture = textures[image];
+  const auto texels_per_pixel = uv_per_pixel * static_cast<float>(std::max(images[image].width, images[image].height));
+  // Each level halves the texels, the one right below one texel per pixel is what the sampler picks
+  const auto level = texels_per_pixel > 1.F ? static_cast<uint32_t>(std::floor(std::log2(texels_per_pixel))) : 0;
+  if (level >= texture.tail) {
+    return;
+  }
+  texture.needed = std::min(texture.needed, level);
+  std::fill(texture.last_needed.begin() + level, texture.last_needed.begin() + texture.tail, frame);
+}
+
+auto tr::TextureStreamer::plan(renderer::VulkanEngine& engine, std::size_t budget) -> bool {
+  changes.clear();
+
+  auto [usage, high] = device_local_memory(engine);
+  if (limit != 0) {
+    high = std::min(high, limit);
+  }
+  // Some room is left for everything else, freeing takes a few frames anyway
+  high = high / 10 * 9;
+  // Replaced images still count until the frames in flight let them go
+  usage -= std::min(usage, std::accumulate(released.begin(), released.end(), std::size_t{0}));
+
+  // Most levels missing first, least recently needed first
+  std::vector<std::size_t> wanted;
+  std::vector<std::size_t> evictable;
+  for (std::size_t i = 0; i < textures.size(); i++) {
+    const auto& texture = textures[i];
+    if (texture.needed < texture.resident) {
+      wanted.push_back(i);
+    } else if (texture.resident < texture.tail && texture.last_needed[texture.resident] != frame) {
+      evictable.push_back(i);
+    }
+  }
+  std::ranges::sort(wanted, [&](std::size_t a, std::size_t b) {
+    return textures[a].resident - textures[a].needed > textures[b].resident - textures[b].needed;
+  });
+  std::ranges::sort(evictable, [&](std::size_t a, std::size_t b) {
+    return textures[a].last_needed[textures[a].resident] < textures[b].last_needed[textures[b].resident];
+  });
+
+  auto& released_now = released[frame % released.size()];
+  std::size_t bytes = 0;
+  auto next_evicted = evictable.begin();
+  const auto evict = [&] {
+    const auto i = *next_evicted++;
+    const auto resident = textures[i].resident;
+    changes.emplace_back(i, resident + 1);
+    usage -= std::min(usage, level_bytes(i, resident));
+    released_now += chain_bytes(i, resident);
+    bytes += chain_bytes(i, resident + 1);
+  };
+  while (usage > high && next_evicted != evictable.end()) {
+    evict();
+  }
+  for (const auto i : wanted) {
+    if (bytes >= budget) {
+      break;
+    }
+    const auto level = textures[i].resident - 1;
+    const auto size = level_bytes(i, level);
+    while (usage + size > high && next_evicted != evictable.end()) {
+      evict();
+    }
+    if (usage + size > high) {
+      spdlog::trace("Texture memory is full, {} textures are missing levels", wanted.size());
+      break;
+    }
+    changes.emplace_back(i, level);
+    usage += size;
+    released_now += chain_bytes(i, level + 1);
+    bytes += chain_bytes(i, level);
+  }
+
+  for (auto& texture : textures) {
+    texture.needed = texture.tail;
+  }
+  frame++;
+  released[frame % released.size()] = 0;
+  return !changes.empty();
+}
+
+auto tr::TextureStreamer::apply(renderer::VulkanEngine& engine, renderer::Transferer& t) -> std::size_t {
+  std::size_t bytes = 0;
+  for (const auto [i, level] : changes) {
+    reallocate(engine, t, i, level);
+    bytes += chain_bytes(i, level);
+  }
+  changes.clear();
+  return bytes;
+}
+
+void tr::TextureStreamer::release(renderer::Lifetime& lifetime) {
+  for (const auto& texture : textures) {
+    texture.image.tie(lifetime);
+  }
+  textures.clear();
+}
+
+void tr::TextureStreamer::reallocate(renderer::VulkanEngine& engine, renderer::Transferer& t, std::size_t i,
+                                     uint32_t level) {
+  auto& texture = textures[i];
+  const auto& image = images[i];
+  const VkExtent2D extent{image.width, image.height};
+  const auto resident_extent = renderer::mip_extent(extent, level);
+  // An uncompressed image that comes with its base level only gets its chain blitted, all of it is then the tail
+  const bool generate_mipmaps = image.mip_levels == 1 && !renderer::FormatBlock::of(image.format).is_compressed();
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  if (generate_mipmaps) {
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
+
+  const auto debug_name = std::format("texture {} from level {}", i, level);
+  auto ib = engine.image_builder();
+  auto image_ressource = ib.build_image(renderer::ImageDefinition{
+      .flags = 0,
+      .usage = usage,
+      .size = {renderer::StaticExtent{resident_extent.width, resident_extent.height}},
+      .format = {renderer::StaticFormat{image.format}},
+      .mip_levels = generate_mipmaps ? renderer::mip_level_count(extent) : image.mip_levels - level,
+      .debug_name = debug_name,
+  });
+
+  // Every level is uploaded again, the current image is still sampled by the frames in flight
+  renderer::ImageMemoryBarrier::submit<1>(
+      t.cmd.vk_cmd, {{image_ressource.invalidate().prepare_barrier(renderer::SyncImageTransfer)}});
+  const auto block = renderer::FormatBlock::of(image.format);
+  std::size_t offset = block.size_bytes(extent, level);
+  for (uint32_t l = level; l < image.mip_levels; l++) {
+    const auto level_extent = renderer::mip_extent(extent, l);
+    const auto size = block.size_bytes(level_extent);
+    t.upload_image(image_ressource, {{0, 0}, level_extent}, image.texels.subspan(offset, size), 0, l - level);
+    offset += size;
+  }
+  // Blits need a graphics queue
+  if (generate_mipmaps) {
+    t.hand_over(image_ressource, renderer::SyncImageTransfer);
+    image_ressource.generate_mipmaps(t.graphics_cmd.vk_cmd);
+    renderer::ImageMemoryBarrier::submit<1>(
+        t.graphics_cmd.vk_cmd, {{image_ressource.prepare_barrier(renderer::SyncFragmentShaderReadOnly)}});
+  } else {
+    t.hand_over(image_ressource, renderer::SyncFragmentShaderReadOnly);
+  }
+
+  if (texture.image.image == VK_NULL_HANDLE) {
+    texture.handle = engine.rm.register_storage_image(image_ressource);
+  } else {
+    texture.image.tie(t.replaced);
+    engine.rm.replace_storage_image(texture.handle, image_ressource);
+  }
+  texture.image = image_ressource;
+  texture.resident = level;
+}
+
+auto tr::TextureStreamer::level_bytes(std::size_t i, uint32_t level) const -> std::size_t {
+  const auto& image = images[i];
+  return renderer::FormatBlock::of(image.format).size_bytes(renderer::mip_extent({image.width, image.height}, level));
+}
+
+auto tr::TextureStreamer::chain_bytes(std::size_t i, uint32_t level) const -> std::size_t {
+  const auto& image = images[i];
+  return image.texels.size_bytes() -
+         renderer::FormatBlock::of(image.format).size_bytes({image.width, image.height}, level);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "renderer/constants.h"
+#include "renderer/ressources.h"
+#include "scene_data.h"
+
+namespace tr {
+namespace renderer {
+class VulkanEngine;
+struct Lifetime;
+struct Transferer;
+enum class image_ressource_handle : uint32_t;
+}  // namespace renderer
+
+// Keeps on the GPU the mips of the scene images that what is visible needs, under a memory limit
+// Images start with their tail, the levels no larger than tail_size, which never leave. Finer levels come in one at a
+// time while something visible needs them, and the least recently needed ones go first when memory gets short
+// Without sparse residency levels can't come and go in place, the image is reallocated for every change
+class TextureStreamer {
+ public:
+  static constexpr uint32_t tail_size = 128;
+  static constexpr uint32_t max_levels = 16;
+
+  // limit is in bytes of device local memory, 0 to go up to the budget VMA reports
+  void init(std::span<const SceneData::Image> images, std::size_t limit);
+
+  // Uploads the tail of the next image, returns how many bytes it took
+  auto add(renderer::VulkanEngine& engine, renderer::Transferer& t) -> std::size_t;
+  [[nodiscard]] auto size() const -> std::size_t { return textures.size(); }
+  [[nodiscard]] auto handle(std::size_t image) const -> renderer::image_ressource_handle {
+    return textures[image].handle;
+  }
+
+  // Something visible samples image with uv_per_pixel uv units between neighbouring pixels
+  void need(uint32_t image, float uv_per_pixel);
+
+  // Picks what to stream in and what to evict from what has been needed since the last call, up to about budget bytes
+  // of uploads. Returns false when there is nothing to do
+  auto plan(renderer::VulkanEngine& engine, std::size_t budget) -> bool;
+  // Reallocates the images plan() picked, returns the bytes uploaded
+  auto apply(renderer::VulkanEngine& engine, renderer::Transferer& t) -> std::size_t;
+
+  // The images are not tied to any lifetime while they can still be replaced
+  void release(renderer::Lifetime& lifetime);
+
+ private:
+  struct Texture {
+    renderer::image_ressource_handle handle;
+    renderer::ImageRessource image;
+    // All in levels of the whole image: the finest one resident, the first one of the tail and the finest one needed
+    // since the last plan
+    uint32_t resident;
+    uint32_t tail;
+    uint32_t needed;
+    // Frame each level was last needed at
+    std::array<uint32_t, max_levels> last_needed;
+  };
+
+  void reallocate(renderer::VulkanEngine& engine, renderer::Transferer& t, std::size_t i, uint32_t level);
+  [[nodiscard]] auto level_bytes(std::size_t i, uint32_t level) const -> std::size_t;
+  // Of the levels from level to the last one
+  [[nodiscard]] auto chain_bytes(std::size_t i, uint32_t level) const -> std::size_t;
+
+  std::span<const SceneData::Image> images;
+  std::vector<Texture> textures;
+  std::size_t limit = 0;
+  uint32_t frame = 1;
+  // Image and the level it is reallocated from, the next apply() does them
+  std::vector<std::pair<std::size_t, uint32_t>> changes;
+  // Bytes of the images replaced in the last frames, they are freed once the frames in flight are done with them
+  std::array<std::size_t, renderer::MAX_FRAMES_IN_FLIGHT + 2> released{};
+};
+
+}  // namespace tr
@@ -0,0 +1,516 @@
+#include "trscene.h"
+
+#include <json/reader.h>         // for CharReaderBuilder, parseFromStream
+#include <json/value.h>          // for Value
+#include <spdlog/spdlog.h>       // for info, warn, error
+#include <utils/assert.h>        // for TR_ASSERT
+#include <utils/cast.h>          // for narrow_cast
+#include <utils/mapped_file.h>   // for MappedFile
+#include <utils/misc.h>          // for align
+#include <vulkan/vulkan_core.h>  // for VkFormat
+
+#include <array>         // for array
+#include <charconv>      // for from_chars
+#include <cstddef>       // for byte, size_t
+#include <cstdint>       // for uint32_t, uint64_t
+#include <cstring>       // for memcpy
+#include <filesystem>    // for path, last_write_time, rename
+#include <fstream>       // for ofstream, ifstream
+#include <iterator>      // for istreambuf_iterator
+#include <limits>        // for numeric_limits
+#include <memory>        // for make_shared
+#include <optional>      // for optional, nullopt
+#include <span>          // for span, as_bytes
+#include <sstream>       // for istringstream
+#include <string>        // for string
+#include <string_view>   // for string_view
+#include <system_error>  // for error_code
+#include <type_traits>   // for is_trivially_copyable_v
+#include <utility>       // for move
+#include <vector>        // for vector
+
+#include "renderer/mesh.h"        // for VertexPosition, PackedAttributes, Meshlet, SurfaceLod, AABB
+#include "renderer/ressources.h"  // for FormatBlock, mip_level_count
+#include "scene_data.h"           // for SceneData
+
+// Layout of a .trscene file, everything is in native endianness:
+// - Header
+// - ImageEntry[image_count], MaterialEntry[material_count], MeshEntry[mesh_count], SceneData::Node[node_count],
+//   CellEntry[cell_count]
+// - payloads (texels, names, instances, positions, attributes, indices, surfaces, meshlets, lods, cell instances, cell
+//   materials), each aligned on payload_alignment
+namespace {
+constexpr std::array<char, 8> magic{'T', 'R', 'S', 'C', 'E', 'N', 'E', '\0'};
+// Bump it when the layout of the file, of VertexPosition, of PackedAttributes, of Node, of Surface, of Meshlet, of
+// SurfaceLod or of CellInstance changes
+constexpr uint32_t version = 12;
+constexpr uint32_t no_image = std::numeric_limits<uint32_t>::max();
+// NodeHierarchy::no_parent
+constexpr uint32_t no_parent = std::numeric_limits<uint32_t>::max();
+constexpr std::size_t payload_alignment = 16;
+// Of both streams, catches vertices changing size without a version bump
+constexpr uint32_t vertex_size = sizeof(tr::renderer::VertexPosition) + sizeof(tr::renderer::PackedAttributes);
+
+struct Header {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t vertex_size;
+  uint32_t image_count;
+  uint32_t material_count;
+  uint32_t mesh_count;
+  uint32_t node_count;
+  uint32_t cell_count;
+};
+
+struct Range {
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct ImageEntry {
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;
+  uint32_t mip_levels;
+  Range texels;
+};
+
+struct MaterialEntry {
+  uint32_t albedo;
+  uint32_t metallic_roughness;
+  uint32_t normal;
+};
+
+struct MeshEntry {
+  Range name;
+  Range instances;
+  Range positions;
+  Range attributes;
+  Range indices;
+  Range surfaces;
+  Range meshlets;
+  Range lods;
+};
+
+struct CellEntry {
+  tr::renderer::AABB bounds;
+  Range instances;
+  Range materials;
+};
+
+static_assert(std::is_trivially_copyable_v<tr::renderer::VertexPosition>);
+static_assert(std::is_trivially_copyable_v<tr::renderer::PackedAttributes>);
+static_assert(std::is_trivially_copyable_v<tr::SceneData::Node>);
+static_assert(std::is_trivially_copyable_v<tr::SceneData::Surface>);
+static_assert(std::is_trivially_copyable_v<tr::renderer::Meshlet>);
+static_assert(std::is_trivially_copyable_v<tr::renderer::SurfaceLod>);
+static_assert(std::is_trivially_copyable_v<tr::SceneData::CellInstance>);
+static_assert(std::is_trivially_copyable_v<CellEntry>);
+
+// Empty and sets corrupt when range does not fit in bytes, counts are checked so that garbage ones can't overflow
+template <class T>
+auto view(std::span<const std::byte> bytes, Range range, bool& corrupt) -> std::span<const T> {
+  if (range.offset % alignof(T) != 0 || range.offset > bytes.size() ||
+      range.count > (bytes.size() - range.offset) / sizeof(T)) {
+    corrupt = true;
+    return {};
+  }
+  return {reinterpret_cast<const T*>(bytes.data() + range.offset), range.count};
+}
+
+// Of a URI of a glTF
+auto percent_decoded(std::string_view uri) -> std::string {
+  std::string decoded;
+  decoded.reserve(uri.size());
+  for (std::size_t i = 0; i < uri.size(); i++) {
+    unsigned value = 0;
+    if (uri[i] == '%' && i + 2 < uri.size() &&
+        std::from_chars(uri.data() + i + 1, uri.data() + i + 3, value, 16).ptr == uri.data() + i + 3) {
+      decoded.push_back(static_cast<char>(value));
+      i += 2;
+    } else {
+      decoded.push_back(uri[i]);
+    }
+  }
+  return decoded;
+}
+
+// Buffers and images a .gltf or a .glb refers to, they are part of the source of a baked scene. nullopt when its JSON
+// can't be read
+auto external_files(const std::filesystem::path& gltf) -> std::optional<std::vector<std::filesystem::path>> {
+  std::ifstream in{gltf, std::ios::binary};
+  if (!in) {
+    return std::nullopt;
+  }
+
+  // Only the JSON chunk of a .glb is read, it comes right after its header
+  constexpr uint32_t glb_magic = 0x46546C67;
+  std::array<uint32_t, 5> glb{};  // magic, version, length, JSON chunk length, JSON chunk type
+  std::string json;
+  if (in.read(reinterpret_cast<char*>(glb.data()), sizeof(glb)) && glb[0] == glb_magic) {
+    std::error_code ec;
+    if (glb[3] > std::filesystem::file_size(gltf, ec) || ec) {
+      return std::nullopt;
+    }
+    json.resize(glb[3]);
+    in.read(json.data(), utils::narrow_cast<std::streamsize>(json.size()));
+  } else {
+    in.clear();
+    in.seekg(0);
+    json.assign(std::istreambuf_iterator<char>{in}, {});
+  }
+
+  Json::Value root;
+  std::istringstream stream{json};
+  if (!in || !Json::parseFromStream(Json::CharReaderBuilder{}, stream, &root, nullptr) || !root.isObject()) {
+    return std::nullopt;
+  }
+
+  std::vector<std::filesystem::path> files;
+  for (const auto* key : {"buffers", "images"}) {
+    for (const auto& entry : root[key]) {
+      if (!entry.isObject() || !entry["uri"].isString()) {
+        continue;
+      }
+      const auto uri = entry["uri"].asString();
+      if (!uri.starts_with("data:")) {
+        files.push_back(gltf.parent_path() / percent_decoded(uri));
+      }
+    }
+  }
+  return files;
+}
+
+auto optional_image(uint32_t image) -> std::optional<uint32_t> {
+  if (image == no_image) {
+    return std::nullopt;
+  }
+  return image;
+}
+
+// Whether [start, start + count) fits in size, without overflowing
+auto fits(uint64_t start, uint64_t count, std::size_t size) -> bool { return start <= size && count <= size - start; }
+
+// Whether every index the renderer follows stays inside its table, so that a corrupted file can't be read out of
+// bounds once it has been mapped
+auto is_consistent(const tr::SceneData& scene) -> bool {
+  for (const auto& image : scene.images) {
+    const auto block = tr::renderer::FormatBlock::find(image.format);
+    const VkExtent2D extent{image.width, image.height};
+    if (!block || image.width == 0 || image.height == 0 || image.mip_levels == 0 ||
+        image.mip_levels > tr::renderer::mip_level_count(extent) ||
+        image.texels.size() != block->size_bytes(extent, image.mip_levels)) {
+      return false;
+    }
+  }
+
+  const auto bad_image = [&](std::optional<uint32_t> image) { return image && *image >= scene.images.size(); };
+  for (const auto& material : scene.materials) {
+    if (bad_image(material.albedo) || bad_image(material.metallic_roughness) || bad_image(material.normal)) {
+      return false;
+    }
+  }
+
+  // Depth sorted, parents come before their children
+  for (std::size_t i = 0; i < scene.nodes.size(); i++) {
+    if (scene.nodes[i].parent != no_parent && scene.nodes[i].parent >= i) {
+      return false;
+    }
+  }
+
+  for (const auto& mesh : scene.meshes) {
+    const auto vertex_count = mesh.positions.size();
+    const auto index_count = mesh.indices.size();
+    if (mesh.attributes.size() != vertex_count) {
+      return false;
+    }
+    for (const auto index : mesh.indices) {
+      if (index >= vertex_count) {
+        return false;
+      }
+    }
+    for (const auto node : mesh.instances) {
+      if (node >= scene.nodes.size()) {
+        return false;
+      }
+    }
+    for (const auto& surface : mesh.surfaces) {
+      if (!fits(surface.start, surface.count, index_count) || surface.material >= scene.materials.size() ||
+          !fits(surface.first_meshlet, surface.meshlet_count, mesh.meshlets.size()) ||
+          !fits(surface.first_lod, surface.lod_count, mesh.lods.size())) {
+        return false;
+      }
+    }
+    // Like surfaces, both are ranges of the indices of the mesh
+    for (const auto& meshlet : mesh.meshlets) {
+      if (!fits(meshlet.start, meshlet.count, index_count)) {
+        return false;
+      }
+    }
+    for (const auto& lod : mesh.lods) {
+      if (!fits(lod.start, lod.count, index_count)) {
+        return false;
+      }
+    }
+  }
+
+  for (const auto& cell : scene.cells) {
+    for (const auto& instance : cell.instances) {
+      if (instance.mesh >= scene.meshes.size() || instance.instance >= scene.meshes[instance.mesh].instances.size()) {
+        return false;
+      }
+    }
+    for (const auto material : cell.materials) {
+      if (material >= scene.materials.size()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
+
+auto tr::TrScene::load(const std::filesystem::path& path) -> std::optional<SceneData> {
+  auto file = utils::MappedFile::open(path.string());
+  if (!file) {
+    return std::nullopt;
+  }
+  const auto bytes = file->bytes();
+
+  Header header{};
+  if (bytes.size() < sizeof(header)) {
+    spdlog::warn("{} is truncated, ignoring it", path.string());
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != magic || header.version != version || header.vertex_size != vertex_size) {
+    spdlog::warn("{} has been baked by another version, ignoring it", path.string());
+    return std::nullopt;
+  }
+
+  const auto corrupted = [&] {
+    spdlog::warn("{} is corrupted, ignoring it", path.string());
+    return std::nullopt;
+  };
+
+  // The mapping is page aligned so the tables can be read in place
+  bool corrupt = false;
+  std::size_t offset = utils::align(sizeof(Header), alignof(ImageEntry));
+  const auto images = view<ImageEntry>(bytes, {offset, header.image_count}, corrupt);
+  offset += images.size_bytes();
+  const auto materials = view<MaterialEntry>(bytes, {offset, header.material_count}, corrupt);
+  offset = utils::align(offset + materials.size_bytes(), alignof(MeshEntry));
+  const auto meshes = view<MeshEntry>(bytes, {offset, header.mesh_count}, corrupt);
+  offset = utils::align(offset + meshes.size_bytes(), alignof(SceneData::Node));
+  const auto nodes = view<SceneData::Node>(bytes, {offset, header.node_count}, corrupt);
+  offset = utils::align(offset + nodes.size_bytes(), alignof(CellEntry));
+  const auto cells = view<CellEntry>(bytes, {offset, header.cell_count}, corrupt);
+  if (corrupt) {
+    return corrupted();
+  }
+
+  SceneData scene;
+  scene.images.reserve(images.size());
+  for (const auto& image : images) {
+    scene.images.push_back({
+        .width = image.width,
+        .height = image.height,
+        .format = static_cast<VkFormat>(image.format),
+        .mip_levels = image.mip_levels,
+        .texels = view<std::byte>(bytes, image.texels, corrupt),
+    });
+  }
+
+  scene.materials.reserve(materials.size());
+  for (const auto& material : materials) {
+    scene.materials.push_back({
+        .albedo = material.albedo,
+        .metallic_roughness = optional_image(material.metallic_roughness),
+        .normal = optional_image(material.normal),
+    });
+  }
+
+  scene.nodes.assign(nodes.begin(), nodes.end());
+
+  scene.meshes.reserve(meshes.size());
+  for (const auto& mesh : meshes) {
+    const auto name = view<char>(bytes, mesh.name, corrupt);
+    scene.meshes.push_back({
+        .name = {name.data(), name.size()},
+        .instances = view<uint32_t>(bytes, mesh.instances, corrupt),
+        .positions = view<renderer::VertexPosition>(bytes, mesh.positions, corrupt),
+        .attributes = view<renderer::PackedAttributes>(bytes, mesh.attributes, corrupt),
+        .indices = view<uint32_t>(bytes, mesh.indices, corrupt),
+        .surfaces = view<SceneData::Surface>(bytes, mesh.surfaces, corrupt),
+        .meshlets = view<renderer::Meshlet>(bytes, mesh.meshlets, corrupt),
+        .lods = view<renderer::SurfaceLod>(bytes, mesh.lods, corrupt),
+    });
+  }
+
+  scene.cells.reserve(cells.size());
+  for (const auto& cell : cells) {
+    scene.cells.push_back({
+        .bounds = cell.bounds,
+        .instances = view<SceneData::CellInstance>(bytes, cell.instances, corrupt),
+        .materials = view<uint32_t>(bytes, cell.materials, corrupt),
+    });
+  }
+
+  if (corrupt || !is_consistent(scene)) {
+    return corrupted();
+  }
+
+  // Moving the mapping does not move the mapped memory, the spans above stay valid
+  scene.storage = std::make_shared<utils::MappedFile>(std::move(*file));
+  return scene;
+}
+
+void tr::TrScene::bake(const std::filesystem::path& path, const SceneData& scene) {
+  // Place every payload first so that the tables can be written in one go
+  std::vector<std::span<const std::byte>> payloads;
+  std::size_t offset = utils::align(sizeof(Header), alignof(ImageEntry)) + scene.images.size() * sizeof(ImageEntry);
+  offset = utils::align(offset + scene.materials.size() * sizeof(MaterialEntry), alignof(MeshEntry));
+  offset = utils::align(offset + scene.meshes.size() * sizeof(MeshEntry), alignof(SceneData::Node));
+  offset = utils::align(offset + scene.nodes.size() * sizeof(SceneData::Node), alignof(CellEntry));
+  offset += scene.cells.size() * sizeof(CellEntry);
+
+  const auto place = [&]<class T>(std::span<const T> payload) -> Range {
+    offset = utils::align(offset, payload_alignment);
+    const Range range{offset, payload.size()};
+    offset += payload.size_bytes();
+    payloads.push_back(std::as_bytes(payload));
+    return range;
+  };
+
+  std::vector<ImageEntry> images;
+  images.reserve(scene.images.size());
+  for (const auto& image : scene.images) {
+    images.push_back({
+        .width = image.width,
+        .height = image.height,
+        .format = static_cast<uint32_t>(image.format),
+        .mip_levels = image.mip_levels,
+        .texels = place(image.texels),
+    });
+  }
+
+  std::vector<MaterialEntry> materials;
+  materials.reserve(scene.materials.size());
+  for (const auto& material : scene.materials) {
+    materials.push_back({
+        material.albedo,
+        material.metallic_roughness.value_or(no_image),
+        material.normal.value_or(no_image),
+    });
+  }
+
+  std::vector<MeshEntry> meshes;
+  meshes.reserve(scene.meshes.size());
+  for (const auto& mesh : scene.meshes) {
+    meshes.push_back({
+        .name = place(std::span(mesh.name)),
+        .instances = place(mesh.instances),
+        .positions = place(mesh.positions),
+        .attributes = place(mesh.attributes),
+        .indices = place(mesh.indices),
+        .surfaces = place(mesh.surfaces),
+        .meshlets = place(mesh.meshlets),
+        .lods = place(mesh.lods),
+    });
+  }
+
+  std::vector<CellEntry> cells;
+  cells.reserve(scene.cells.size());
+  for (const auto& cell : scene.cells) {
+    cells.push_back({
+        .bounds = cell.bounds,
+        .instances = place(cell.instances),
+        .materials = place(cell.materials),
+    });
+  }
+
+  const Header header{
+      .magic = magic,
+      .version = version,
+      .vertex_size = vertex_size,
+      .image_count = utils::narrow_cast<uint32_t>(images.size()),
+      .material_count = utils::narrow_cast<uint32_t>(materials.size()),
+      .mesh_count = utils::narrow_cast<uint32_t>(meshes.size()),
+      .node_count = utils::narrow_cast<uint32_t>(scene.nodes.size()),
+      .cell_count = utils::narrow_cast<uint32_t>(cells.size()),
+  };
+
+  // Renamed once complete, an interrupted bake can't leave a truncated scene that looks up to date
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+  if (!out) {
+    spdlog::error("Can't open {} for writing, the scene is not baked", tmp_path.string());
+    return;
+  }
+
+  std::size_t written = 0;
+  const auto write = [&](std::span<const std::byte> data) {
+    out.write(reinterpret_cast<const char*>(data.data()), utils::narrow_cast<std::streamsize>(data.size()));
+    written += data.size();
+  };
+  const auto pad_to = [&](std::size_t alignment) {
+    static constexpr std::array<std::byte, payload_alignment> zeroes{};
+    write(std::span(zeroes).first(utils::align(written, alignment) - written));
+  };
+
+  write(std::as_bytes(std::span(&header, 1)));
+  pad_to(alignof(ImageEntry));
+  write(std::as_bytes(std::span(images)));
+  write(std::as_bytes(std::span(materials)));
+  pad_to(alignof(MeshEntry));
+  write(std::as_bytes(std::span(meshes)));
+  pad_to(alignof(SceneData::Node));
+  write(std::as_bytes(std::span(scene.nodes)));
+  pad_to(alignof(CellEntry));
+  write(std::as_bytes(std::span(cells)));
+  for (const auto payload : payloads) {
+    pad_to(payload_alignment);
+    write(payload);
+  }
+
+  TR_ASSERT(written == offset, "scene layout mismatch, {} bytes written instead of {}", written, offset);
+  out.close();
+  std::error_code ec;
+  if (!out) {
+    spdlog::error("Failed to write {}, the scene is not baked", tmp_path.string());
+    std::filesystem::remove(tmp_path, ec);
+    return;
+  }
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    spdlog::error("Can't move {} to {}: {}, the scene is not baked", tmp_path.string(), path.string(), ec.message());
+    std::filesystem::remove(tmp_path, ec);
+    return;
+  }
+  spdlog::info("Baked {} ({:.1f} MiB)", path.string(), static_cast<double>(written) / (1 << 20));
+}
+
+auto tr::TrScene::is_up_to_date(const std::filesystem::path& baked, const std::filesystem::path& source) -> bool {
+  std::error_code ec;
+  const auto baked_time = std::filesystem::last_write_time(baked, ec);
+  if (ec) {
+    return false;
+  }
+  // Loading the glTF then says what is wrong with it
+  auto sources = external_files(source);
+  if (!sources) {
+    spdlog::warn("Can't read {}, ignoring {}", source.string(), baked.string());
+    return false;
+  }
+  sources->push_back(source);
+
+  for (const auto& file : *sources) {
+    const auto source_time = std::filesystem::last_write_time(file, ec);
+    if (ec || baked_time < source_time) {
+      spdlog::info("{} is older than {}, loading from glTF", baked.string(), file.string());
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "scene_data.h"
+
+namespace tr {
+
+// Baked scenes: a SceneData dumped as is, so loading one is mapping the file and copying it to the GPU
+struct TrScene {
+  static constexpr std::string_view extension = ".trscene";
+
+  // nullopt if the file is missing, truncated, corrupted or has been baked by another version
+  static auto load(const std::filesystem::path& path) -> std::optional<SceneData>;
+  // Logs an error and leaves path as it was when it can't be written
+  static void bake(const std::filesystem::path& path, const SceneData& scene);
+
+  // A baked scene is stale as soon as its source, or a buffer or an image the source refers to, has been touched
+  // after it. Also when the source can't be read
+  static auto is_up_to_date(const std::filesystem::path& baked, const std::filesystem::path& source) -> bool;
+};
+
+}  // namespace tr
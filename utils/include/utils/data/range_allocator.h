@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <optional>
+
+#include "utils/assert.h"
+#include "utils/misc.h"
+
+namespace utils::data {
+
+// Hands out ranges of [0, capacity), it does not own any memory: offsets index into whatever the user manages
+// Free ranges are kept sorted and merged with their neighbours, allocation is first fit
+class range_allocator {
+ public:
+  struct range {
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  explicit range_allocator(std::size_t capacity = 0) { grow(capacity); }
+
+  [[nodiscard]] auto capacity() const -> std::size_t { return capacity_; }
+  [[nodiscard]] auto used() const -> std::size_t { return used_; }
+
+  // alignment must be a power of 2
+  auto allocate(std::size_t size, std::size_t alignment = 1) -> std::optional<range> {
+    TR_ASSERT(size > 0, "empty ranges can't be allocated");
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); it++) {
+      const auto [free_offset, free_size] = *it;
+      const auto offset = utils::align(free_offset, alignment);
+      if (offset + size > free_offset + free_size) {
+        continue;
+      }
+
+      free_ranges.erase(it);
+      if (offset > free_offset) {
+        free_ranges.emplace(free_offset, offset - free_offset);
+      }
+      if (offset + size < free_offset + free_size) {
+        free_ranges.emplace(offset + size, free_offset + free_size - offset - size);
+      }
+
+      allocations.emplace(offset, size);
+      used_ += size;
+      return range{offset, size};
+    }
+    return std::nullopt;
+  }
+
+  void free(range r) {
+    const auto it = allocations.find(r.offset);
+    TR_ASSERT(it != allocations.end() && it->second == r.size, "range {} +{} was not allocated", r.offset,
+              r.size);
+    allocations.erase(it);
+    used_ -= r.size;
+    release(r.offset, r.size);
+  }
+
+  // Makes [capacity, new_capacity) available
+  void grow(std::size_t new_capacity) {
+    TR_ASSERT(new_capacity >= capacity_, "a range_allocator can't shrink");
+    if (new_capacity > capacity_) {
+      release(capacity_, new_capacity - capacity_);
+    }
+    capacity_ = new_capacity;
+  }
+
+ private:
+  void release(std::size_t offset, std::size_t size) {
+    auto next = free_ranges.lower_bound(offset);
+    if (next != free_ranges.end() && next->first == offset + size) {
+      size += next->second;
+      next = free_ranges.erase(next);
+    }
+    if (next != free_ranges.begin()) {
+      const auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        offset = prev->first;
+        size += prev->second;
+        free_ranges.erase(prev);
+      }
+    }
+    free_ranges.emplace(offset, size);
+  }
+
+  std::size_t capacity_ = 0;
+  std::size_t used_ = 0;
+  // offset -> size
+  std::map<std::size_t, std::size_t> free_ranges;
+  // offset -> size
+  std::map<std::size_t, std::size_t> allocations;
+};
+
+}  // namespace utils::data
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+namespace utils {
+
+// Read only mapping of a whole file, pages are only read from disk when touched
+class MappedFile {
+ public:
+  // nullopt if the file can't be opened or is empty
+  static auto open(const std::string& path) -> std::optional<MappedFile>;
+
+  MappedFile(MappedFile&& other) noexcept
+      : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+  auto operator=(MappedFile&& other) noexcept -> MappedFile& {
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    return *this;
+  }
+  MappedFile(const MappedFile&) = delete;
+  auto operator=(const MappedFile&) -> MappedFile& = delete;
+  ~MappedFile();
+
+  [[nodiscard]] auto bytes() const -> std::span<const std::byte> { return {data, size}; }
+
+ private:
+  MappedFile(const std::byte* data_, std::size_t size_) : data(data_), size(size_) {}
+
+  const std::byte* data = nullptr;
+  std::size_t size = 0;
+};
+
+}  // namespace utils
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// A fixed set of workers consuming a FIFO of tasks
+// Tasks are run in submission order, but may complete in any order
+class ThreadPool {
+ public:
+  // thread_count == 0 means one worker per hardware thread
+  explicit ThreadPool(std::size_t thread_count = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+  auto operator=(ThreadPool&&) -> ThreadPool& = delete;
+
+  template <class Fn>
+  auto submit(Fn&& f) -> std::future<std::invoke_result_t<std::decay_t<Fn>>> {
+    using R = std::invoke_result_t<std::decay_t<Fn>>;
+
+    // std::function needs a copyable callable, packaged_task is move only
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<Fn>(f));
+    auto future = task->get_future();
+    push([task] { (*task)(); });
+    return future;
+  }
+
+  // Calls f(i) for each i in [0, count) and blocks until all calls are done
+  // The calling thread takes part in the work and only waits for calls already running. Helpers that start once every
+  // i is taken return right away, so this can be nested inside a task even when every worker is busy
+  template <class Fn>
+  void parallel_for(std::size_t count, Fn&& f) {
+    if (count == 0) {
+      return;
+    }
+
+    // Helpers may start after the call returned, they keep the state alive and only touch f for an i they took
+    auto state = std::make_shared<ParallelFor>();
+    auto run = [state, count, &f] {
+      for (std::size_t i = state->next++; i < count; i = state->next++) {
+        f(i);
+        if (++state->done == count) {
+          const std::lock_guard lock{state->mutex};
+          state->cv.notify_all();
+        }
+      }
+    };
+
+    const std::size_t helper_count = std::min(count, size() + 1) - 1;
+    for (std::size_t i = 0; i < helper_count; i++) {
+      push(run);
+    }
+
+    run();
+    std::unique_lock lock{state->mutex};
+    state->cv.wait(lock, [&] { return state->done == count; });
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t { return workers.size(); }
+
+ private:
+  void push(std::function<void()> task);
+  void worker_loop(const std::stop_token& stop_token);
+
+  struct ParallelFor {
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+
+  std::mutex mutex;
+  std::condition_variable_any cv;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::jthread> workers;
+};
+
+}  // namespace utils
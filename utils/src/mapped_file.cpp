@@ -0,0 +1,78 @@
+#include "utils/mapped_file.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+auto utils::MappedFile::open(const std::string& path) -> std::optional<MappedFile> {
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return std::nullopt;
+  }
+
+  LARGE_INTEGER file_size{};
+  if (GetFileSizeEx(file, &file_size) == 0 || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return std::nullopt;
+  }
+
+  // The view keeps the file and the mapping alive, the handles are not needed anymore
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    return std::nullopt;
+  }
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr) {
+    return std::nullopt;
+  }
+
+  return MappedFile{static_cast<const std::byte*>(view), static_cast<std::size_t>(file_size.QuadPart)};
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  const auto size = static_cast<std::size_t>(file_stat.st_size);
+  void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED) {
+    return std::nullopt;
+  }
+  madvise(view, size, MADV_SEQUENTIAL);
+
+  return MappedFile{static_cast<const std::byte*>(view), size};
+#endif
+}
+
+utils::MappedFile::~MappedFile() {
+  if (data == nullptr) {
+    return;
+  }
+
+#if defined(_WIN32)
+  UnmapViewOfFile(data);
+#else
+  munmap(const_cast<std::byte*>(data), size);
+#endif
+}
@@ -0,0 +1,51 @@
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+utils::ThreadPool::ThreadPool(std::size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  workers.reserve(thread_count);
+  for (std::size_t i = 0; i < thread_count; i++) {
+    workers.emplace_back([this](const std::stop_token& stop_token) { worker_loop(stop_token); });
+  }
+}
+
+utils::ThreadPool::~ThreadPool() {
+  for (auto& worker : workers) {
+    worker.request_stop();
+  }
+  // jthreads are joined on destruction, remaining tasks are drained before the workers exit
+  workers.clear();
+}
+
+void utils::ThreadPool::push(std::function<void()> task) {
+  {
+    const std::lock_guard lock{mutex};
+    tasks.push_back(std::move(task));
+  }
+  cv.notify_one();
+}
+
+void utils::ThreadPool::worker_loop(const std::stop_token& stop_token) {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock{mutex};
+      if (!cv.wait(lock, stop_token, [this] { return !tasks.empty(); })) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}